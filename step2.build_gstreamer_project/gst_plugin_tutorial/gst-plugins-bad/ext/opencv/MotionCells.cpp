@@ -72,6 +72,7 @@ MotionCells::MotionCells ()
   m_cellheight = 0;
   m_sensitivity = 0;
   m_changed_datafile = false;
+  m_curgrey = 0;
 
   memset (&m_header, 0, sizeof (MotionCellHeader));
   m_header.headersize = GINT32_TO_BE (MC_HEADER);
@@ -94,11 +95,14 @@ MotionCells::~MotionCells ()
   if (m_motioncellsidxcstr)
     delete[]m_motioncellsidxcstr;
 
-  m_pcurFrame.release ();
-  m_pprevFrame.release ();
+  m_pdownImage.release ();
+  m_pgreyImage[0].release ();
+  m_pgreyImage[1].release ();
   transparencyimg.release ();
   m_pdifferenceImage.release ();
   m_pbwImage.release ();
+  m_pmotionImage.release ();
+  m_pintegralImage.release ();
 }
 
 int
@@ -141,18 +145,9 @@ MotionCells::performDetectionMotionCells (cv::Mat p_frame,
     setMotionCells (frameSize.width, frameSize.height);
     m_sensitivity = 1 - p_sensitivity;
     m_isVisible = p_isVisible;
-    m_pcurFrame = p_frame.clone ();
-    cv::Mat m_pcurgreyImage = cv::Mat (frameSize, CV_8UC1);
-    cv::Mat m_pprevgreyImage = cv::Mat (frameSize, CV_8UC1);
-    cv::Mat m_pgreyImage = cv::Mat (frameSize, CV_8UC1);
-    cv::Mat m_pcurDown = cv::Mat (frameSize, m_pcurFrame.type ());
-    cv::Mat m_pprevDown = cv::Mat (frameSize, m_pprevFrame.type ());
-    m_pbwImage.create (frameSize, CV_8UC1);
-    pyrDown (m_pprevFrame, m_pprevDown);
-    cvtColor (m_pprevDown, m_pprevgreyImage, cv::COLOR_RGB2GRAY);
-    pyrDown (m_pcurFrame, m_pcurDown);
-    cvtColor (m_pcurDown, m_pcurgreyImage, cv::COLOR_RGB2GRAY);
-    m_pdifferenceImage = m_pcurgreyImage.clone ();
+    cv::Mat & m_pcurgreyImage = m_pgreyImage[m_curgrey];
+    cv::Mat & m_pprevgreyImage = m_pgreyImage[1 - m_curgrey];
+    setGreyImage (p_frame, m_pcurgreyImage);
     //cvSmooth(m_pcurgreyImage, m_pcurgreyImage, CV_GAUSSIAN, 3, 0);//TODO camera noise reduce,something smoothing, and rethink runningavg weights
 
     //Minus the current gray frame from the 8U moving average.
@@ -171,7 +166,13 @@ MotionCells::performDetectionMotionCells (cv::Mat p_frame,
       performMotionMaskCoords (motionmaskcoords, motionmaskcoord_count);
     if (motionmaskcells_count > 0)
       performMotionMask (motionmaskcellsidx, motionmaskcells_count);
-    if (getIsNonZero (m_pbwImage)) {    //detect Motion
+
+    //count the motion pixels once, for all the cells
+    cv::threshold (m_pbwImage, m_pmotionImage, 0, 1, cv::THRESH_BINARY);
+    cv::integral (m_pmotionImage, m_pintegralImage, CV_32S);
+
+    if (m_pintegralImage.at < int >(m_pintegralImage.rows - 1,
+            m_pintegralImage.cols - 1) > 0) {   //detect Motion
       if (m_MotionCells.size () > 0)    //it contains previous motioncells what we used when frames dropped
         m_MotionCells.clear ();
       (motioncells_count > 0) ?
@@ -179,7 +180,8 @@ MotionCells::performDetectionMotionCells (cv::Mat p_frame,
           motioncells_count)
           : calculateMotionPercentInMotionCells (motionmaskcellsidx, 0);
 
-      transparencyimg = cv::Mat::zeros (p_frame.size (), p_frame.type ());
+      transparencyimg.create (p_frame.size (), p_frame.type ());
+      transparencyimg.setTo (cv::Scalar::all (0));
       if (m_motioncellsidxcstr)
         delete[]m_motioncellsidxcstr;
       m_motioncells_idx_count = m_MotionCells.size () * MSGLEN; //one motion cell idx: (lin idx : col idx,) it's up to 6 character except last motion cell idx
@@ -239,7 +241,7 @@ MotionCells::performDetectionMotionCells (cv::Mat p_frame,
         m_MotionCells.clear ();
     }
 
-    m_pprevFrame = m_pcurFrame.clone ();
+    m_curgrey = 1 - m_curgrey;
     m_framecnt = 0;
     if (m_pCells) {
       for (int i = 0; i < m_gridy; ++i) {
@@ -386,13 +388,12 @@ MotionCells::saveMotionCells (gint64 timestamp_millisec)
   return 0;
 }
 
+//The motion percent of the whole cell, from the integral image of the
+//motion mask
 double
 MotionCells::calculateMotionPercentInCell (int p_row, int p_col,
     double *p_cellarea, double *p_motionarea)
 {
-  double cntpixelsnum = 0;
-  double cntmotionpixelnum = 0;
-
   int ybegin = floor ((double) p_row * m_cellheight);
   int yend = floor ((double) (p_row + 1) * m_cellheight);
   int xbegin = floor ((double) (p_col) * m_cellwidth);
@@ -401,27 +402,19 @@ MotionCells::calculateMotionPercentInCell (int p_row, int p_col,
   int cellh = yend - ybegin;
   int cellarea = cellw * cellh;
   *p_cellarea = cellarea;
-  int thresholdmotionpixelnum = floor ((double) cellarea * m_sensitivity);
-
-  for (int i = ybegin; i < yend; i++) {
-    for (int j = xbegin; j < xend; j++) {
-      cntpixelsnum++;
-      if ((((uchar *) (m_pbwImage.data + m_pbwImage.step[0] * i))[j]) > 0) {
-        cntmotionpixelnum++;
-        if (cntmotionpixelnum >= thresholdmotionpixelnum) {     //we don't need to calculate anymore
-          *p_motionarea = cntmotionpixelnum;
-          return (cntmotionpixelnum / cntpixelsnum);
-        }
-      }
-      int remainingpixelsnum = cellarea - cntpixelsnum;
-      if ((cntmotionpixelnum + remainingpixelsnum) < thresholdmotionpixelnum) { //moving pixels number will be less than threshold
-        *p_motionarea = 0;
-        return 0;
-      }
-    }
+
+  if (cellarea <= 0) {
+    *p_motionarea = 0;
+    return 0;
   }
 
-  return (cntmotionpixelnum / cntpixelsnum);
+  const int *top = m_pintegralImage.ptr < int >(ybegin);
+  const int *bottom = m_pintegralImage.ptr < int >(yend);
+  int cntmotionpixelnum =
+      bottom[xend] - bottom[xbegin] - top[xend] + top[xbegin];
+  *p_motionarea = cntmotionpixelnum;
+
+  return ((double) cntmotionpixelnum / cellarea);
 }
 
 void
@@ -515,6 +508,13 @@ MotionCells::performMotionMask (motioncellidx * p_motionmaskcellsidx,
   }
 }
 
+void
+MotionCells::setGreyImage (cv::Mat p_frame, cv::Mat & p_grey)
+{
+  pyrDown (p_frame, m_pdownImage);
+  cvtColor (m_pdownImage, p_grey, cv::COLOR_RGB2GRAY);
+}
+
 ///BGR if we use only OpenCV
 //RGB if we use gst+OpenCV
 void
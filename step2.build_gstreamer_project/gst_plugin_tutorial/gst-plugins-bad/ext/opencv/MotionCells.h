@@ -135,7 +135,7 @@ public:
 
   void setPrevFrame (cv::Mat p_prevframe)
   {
-    m_pprevFrame = p_prevframe.clone();
+    setGreyImage (p_prevframe, m_pgreyImage[1 - m_curgrey]);
   }
   char *getMotionCellsIdx ()
   {
@@ -195,6 +195,7 @@ private:
   int initDataFile (char *p_datafile, gint64 starttime);
   void blendImages (cv::Mat p_actFrame, cv::Mat p_cellsFrame,
       float p_alpha, float p_beta);
+  void setGreyImage (cv::Mat p_frame, cv::Mat & p_grey);
 
   void setData (cv::Mat img, int lin, int col, uchar valor)
   {
@@ -206,18 +207,6 @@ private:
     return ((uchar *) (img.data + img.step[0] * lin))[col];
   }
 
-  bool getIsNonZero (cv::Mat img)
-  {
-    int lin, col;
-
-    for (lin = 0; lin < img.size().height; lin++)
-      for (col = 0; col < img.size().width; col++) {
-        if ((((uchar *) (img.data + img.step[0] * lin))[col]) > 0)
-          return true;
-      }
-    return false;
-  }
-
   void setMotionCells (int p_frameWidth, int p_frameHeight)
   {
     int i, j;
@@ -238,8 +227,12 @@ private:
       }
   }
 
-  cv::Mat m_pprevFrame, m_pdifferenceImage, m_pbwImage, m_pcurFrame,
-    transparencyimg;
+  //the grey images of the current and previous frame swap places on every
+  //frame, and the integral image of the motion mask gives the motion
+  //pixels of any cell with four lookups
+  cv::Mat m_pdownImage, m_pgreyImage[2], m_pdifferenceImage, m_pbwImage,
+    m_pmotionImage, m_pintegralImage, transparencyimg;
+  int m_curgrey;
   bool m_isVisible, m_changed_datafile, m_useAlpha, m_saveInDatafile;
   Cell **m_pCells;
   vector < MotionCellsIdx > m_MotionCells;
@@ -128,6 +128,8 @@ gst_cv_dilate_erode_class_init (GstCvDilateErodeClass * klass)
   gobject_class->set_property = gst_cv_dilate_erode_set_property;
   gobject_class->get_property = gst_cv_dilate_erode_get_property;
 
+  ((GstOpencvVideoFilterClass *) klass)->stateless = TRUE;
+
   g_object_class_install_property (gobject_class, PROP_ITERATIONS,
       g_param_spec_int ("iterations", "iterations",
           "Number of iterations to run the algorithm", 1, G_MAXINT,
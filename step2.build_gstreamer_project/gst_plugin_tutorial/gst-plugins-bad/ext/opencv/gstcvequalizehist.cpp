@@ -45,7 +45,8 @@
  * SECTION:element-cvequalizehist
  *
  * Equalizes the histogram of a grayscale image with the cvEqualizeHist OpenCV
- * function.
+ * function.  NV12 and I420 frames have their luma plane equalized and their
+ * chroma planes copied, so camera output needs no conversion to gray.
  *
  * ## Example launch line
  *
@@ -68,18 +69,19 @@ GST_DEBUG_CATEGORY_STATIC (gst_cv_equalize_hist_debug);
 static GstStaticPadTemplate sink_factory = GST_STATIC_PAD_TEMPLATE ("sink",
     GST_PAD_SINK,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("GRAY8")));
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY8, NV12, I420 }")));
 
 static GstStaticPadTemplate src_factory = GST_STATIC_PAD_TEMPLATE ("src",
     GST_PAD_SRC,
     GST_PAD_ALWAYS,
-    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("GRAY8")));
+    GST_STATIC_CAPS (GST_VIDEO_CAPS_MAKE ("{ GRAY8, NV12, I420 }")));
 
 G_DEFINE_TYPE (GstCvEqualizeHist, gst_cv_equalize_hist,
     GST_TYPE_OPENCV_VIDEO_FILTER);
 
 static GstFlowReturn gst_cv_equalize_hist_transform (GstOpencvVideoFilter *
-    filter, GstBuffer * buf, cv::Mat img, GstBuffer * outbuf, cv::Mat outimg);
+    filter, GstBuffer * buf, cv::Mat * planes, guint n_planes,
+    GstBuffer * outbuf, cv::Mat * outplanes, guint n_outplanes);
 
 
 static void
@@ -89,7 +91,8 @@ gst_cv_equalize_hist_class_init (GstCvEqualizeHistClass * klass)
   GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
   gstopencvbasefilter_class = (GstOpencvVideoFilterClass *) klass;
 
-  gstopencvbasefilter_class->cv_trans_func = gst_cv_equalize_hist_transform;
+  gstopencvbasefilter_class->cv_trans_planes_func =
+      gst_cv_equalize_hist_transform;
 
   gst_element_class_add_static_pad_template (element_class, &src_factory);
   gst_element_class_add_static_pad_template (element_class, &sink_factory);
@@ -110,9 +113,12 @@ gst_cv_equalize_hist_init (GstCvEqualizeHist * filter)
 
 static GstFlowReturn
 gst_cv_equalize_hist_transform (GstOpencvVideoFilter * base,
-    GstBuffer * buf, cv::Mat img, GstBuffer * outbuf, cv::Mat outimg)
+    GstBuffer * buf, cv::Mat * planes, guint n_planes, GstBuffer * outbuf,
+    cv::Mat * outplanes, guint n_outplanes)
 {
-  cv::equalizeHist (img, outimg);
+  cv::equalizeHist (planes[0], outplanes[0]);
+  for (guint i = 1; i < n_planes; i++)
+    planes[i].copyTo (outplanes[i]);
   return GST_FLOW_OK;
 }
 
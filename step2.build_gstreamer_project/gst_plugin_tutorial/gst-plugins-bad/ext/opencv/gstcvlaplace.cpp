@@ -106,23 +106,6 @@ static void gst_cv_laplace_get_property (GObject * object, guint prop_id,
 static GstFlowReturn gst_cv_laplace_transform (GstOpencvVideoFilter * filter,
     GstBuffer * buf, cv::Mat img, GstBuffer * outbuf, cv::Mat outimg);
 
-static gboolean gst_cv_laplace_cv_set_caps (GstOpencvVideoFilter * trans,
-    gint in_width, gint in_height, int in_cv_type,
-    gint out_width, gint out_height, int out_cv_type);
-
-/* Clean up */
-static void
-gst_cv_laplace_finalize (GObject * obj)
-{
-  GstCvLaplace *filter = GST_CV_LAPLACE (obj);
-
-  filter->intermediary_img.release ();
-  filter->cvGray.release ();
-  filter->Laplace.release ();
-
-  G_OBJECT_CLASS (gst_cv_laplace_parent_class)->finalize (obj);
-}
-
 /* initialize the cvlaplace's class */
 static void
 gst_cv_laplace_class_init (GstCvLaplaceClass * klass)
@@ -134,12 +117,11 @@ gst_cv_laplace_class_init (GstCvLaplaceClass * klass)
   gobject_class = (GObjectClass *) klass;
   gstopencvbasefilter_class = (GstOpencvVideoFilterClass *) klass;
 
-  gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_cv_laplace_finalize);
   gobject_class->set_property = gst_cv_laplace_set_property;
   gobject_class->get_property = gst_cv_laplace_get_property;
 
   gstopencvbasefilter_class->cv_trans_func = gst_cv_laplace_transform;
-  gstopencvbasefilter_class->cv_set_caps = gst_cv_laplace_cv_set_caps;
+  gstopencvbasefilter_class->stateless = TRUE;
 
   g_object_class_install_property (gobject_class, PROP_APERTURE_SIZE,
       g_param_spec_int ("aperture-size", "aperture size",
@@ -183,20 +165,6 @@ gst_cv_laplace_init (GstCvLaplace * filter)
       FALSE);
 }
 
-static gboolean
-gst_cv_laplace_cv_set_caps (GstOpencvVideoFilter * trans, gint in_width,
-    gint in_height, int in_cv_type, gint out_width,
-    gint out_height, int out_cv_type)
-{
-  GstCvLaplace *filter = GST_CV_LAPLACE (trans);
-
-  filter->intermediary_img.create (cv::Size (out_width, out_height), CV_16SC1);
-  filter->cvGray.create (cv::Size (in_width, in_height), CV_8UC1);
-  filter->Laplace.create (cv::Size (in_width, in_height), CV_8UC1);
-
-  return TRUE;
-}
-
 static void
 gst_cv_laplace_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -258,18 +226,19 @@ gst_cv_laplace_transform (GstOpencvVideoFilter * base, GstBuffer * buf,
     cv::Mat img, GstBuffer * outbuf, cv::Mat outimg)
 {
   GstCvLaplace *filter = GST_CV_LAPLACE (base);
+  cv::Mat & gray = *gst_opencv_video_filter_scratch (base, 0);
+  cv::Mat & intermediary = *gst_opencv_video_filter_scratch (base, 1);
+  cv::Mat & laplace = *gst_opencv_video_filter_scratch (base, 2);
 
-  cv::cvtColor (img, filter->cvGray, cv::COLOR_RGB2GRAY);
-  cv::Laplacian (filter->cvGray, filter->intermediary_img,
-      filter->intermediary_img.depth (), filter->aperture_size);
-  filter->intermediary_img.convertTo (filter->Laplace, filter->Laplace.type (),
-      filter->scale, filter->shift);
+  cv::cvtColor (img, gray, cv::COLOR_RGB2GRAY);
+  cv::Laplacian (gray, intermediary, CV_16S, filter->aperture_size);
+  intermediary.convertTo (laplace, CV_8U, filter->scale, filter->shift);
 
   outimg.setTo (cv::Scalar::all (0));
   if (filter->mask) {
-    img.copyTo (outimg, filter->Laplace);
+    img.copyTo (outimg, laplace);
   } else {
-    cv::cvtColor (filter->Laplace, outimg, cv::COLOR_GRAY2RGB);
+    cv::cvtColor (laplace, outimg, cv::COLOR_GRAY2RGB);
   }
 
   return GST_FLOW_OK;
@@ -71,10 +71,6 @@ struct _GstCvLaplace
   gdouble scale;
   gdouble shift;
   gboolean mask;
-
-  cv::Mat intermediary_img;
-  cv::Mat cvGray;
-  cv::Mat Laplace;
 };
 
 struct _GstCvLaplaceClass
@@ -162,6 +162,7 @@ gst_cv_smooth_class_init (GstCvSmoothClass * klass)
   gobject_class->get_property = gst_cv_smooth_get_property;
 
   gstopencvbasefilter_class->cv_trans_ip_func = gst_cv_smooth_transform_ip;
+  gstopencvbasefilter_class->stateless = TRUE;
 
   g_object_class_install_property (gobject_class, PROP_SMOOTH_TYPE,
       g_param_spec_enum ("type",
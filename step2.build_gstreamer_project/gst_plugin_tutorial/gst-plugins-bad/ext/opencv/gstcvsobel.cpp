@@ -104,21 +104,6 @@ static void gst_cv_sobel_get_property (GObject * object, guint prop_id,
 
 static GstFlowReturn gst_cv_sobel_transform (GstOpencvVideoFilter * filter,
     GstBuffer * buf, cv::Mat img, GstBuffer * outbuf, cv::Mat outimg);
-static gboolean gst_cv_sobel_set_caps (GstOpencvVideoFilter * transform,
-    gint in_width, gint in_height, int in_cv_type,
-    gint out_width, gint out_height, int out_cv_type);
-
-/* Clean up */
-static void
-gst_cv_sobel_finalize (GObject * obj)
-{
-  GstCvSobel *filter = GST_CV_SOBEL (obj);
-
-  filter->cvGray.release ();
-  filter->cvSobel.release ();
-
-  G_OBJECT_CLASS (gst_cv_sobel_parent_class)->finalize (obj);
-}
 
 /* initialize the cvsobel's class */
 static void
@@ -131,12 +116,11 @@ gst_cv_sobel_class_init (GstCvSobelClass * klass)
   gobject_class = (GObjectClass *) klass;
   gstopencvbasefilter_class = (GstOpencvVideoFilterClass *) klass;
 
-  gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_cv_sobel_finalize);
   gobject_class->set_property = gst_cv_sobel_set_property;
   gobject_class->get_property = gst_cv_sobel_get_property;
 
   gstopencvbasefilter_class->cv_trans_func = gst_cv_sobel_transform;
-  gstopencvbasefilter_class->cv_set_caps = gst_cv_sobel_set_caps;
+  gstopencvbasefilter_class->stateless = TRUE;
 
   g_object_class_install_property (gobject_class, PROP_X_ORDER,
       g_param_spec_int ("x-order", "x order",
@@ -180,20 +164,6 @@ gst_cv_sobel_init (GstCvSobel * filter)
       FALSE);
 }
 
-/* this function handles the link with other elements */
-static gboolean
-gst_cv_sobel_set_caps (GstOpencvVideoFilter * transform,
-    gint in_width, gint in_height, int in_cv_type,
-    gint out_width, gint out_height, int out_cv_type)
-{
-  GstCvSobel *filter = GST_CV_SOBEL (transform);
-
-  filter->cvGray.create (cv::Size (in_width, in_height), CV_8UC1);
-  filter->cvSobel.create (cv::Size (out_width, out_height), CV_8UC1);
-
-  return TRUE;
-}
-
 static void
 gst_cv_sobel_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
@@ -255,16 +225,18 @@ gst_cv_sobel_transform (GstOpencvVideoFilter * base, GstBuffer * buf,
     cv::Mat img, GstBuffer * outbuf, cv::Mat outimg)
 {
   GstCvSobel *filter = GST_CV_SOBEL (base);
+  cv::Mat & gray = *gst_opencv_video_filter_scratch (base, 0);
+  cv::Mat & sobel = *gst_opencv_video_filter_scratch (base, 1);
 
-  cv::cvtColor (img, filter->cvGray, cv::COLOR_RGB2GRAY);
-  cv::Sobel (filter->cvGray, filter->cvSobel, filter->cvGray.depth (),
-      filter->x_order, filter->y_order, filter->aperture_size);
+  cv::cvtColor (img, gray, cv::COLOR_RGB2GRAY);
+  cv::Sobel (gray, sobel, gray.depth (), filter->x_order, filter->y_order,
+      filter->aperture_size);
 
   outimg.setTo (cv::Scalar::all (0));
   if (filter->mask) {
-    img.copyTo (outimg, filter->cvSobel);
+    img.copyTo (outimg, sobel);
   } else {
-    cv::cvtColor (filter->cvSobel, outimg, cv::COLOR_GRAY2RGB);
+    cv::cvtColor (sobel, outimg, cv::COLOR_GRAY2RGB);
   }
 
   return GST_FLOW_OK;
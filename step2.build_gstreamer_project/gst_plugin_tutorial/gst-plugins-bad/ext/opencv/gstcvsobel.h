@@ -71,9 +71,6 @@ struct _GstCvSobel
   gint y_order;
   gint aperture_size;
   gboolean mask;
-
-  cv::Mat cvGray;
-  cv::Mat cvSobel;
 };
 
 struct _GstCvSobelClass
@@ -106,21 +106,6 @@ static void gst_edge_detect_get_property (GObject * object, guint prop_id,
 
 static GstFlowReturn gst_edge_detect_transform (GstOpencvVideoFilter * filter,
     GstBuffer * buf, cv::Mat img, GstBuffer * outbuf, cv::Mat outimg);
-static gboolean gst_edge_detect_set_caps (GstOpencvVideoFilter * transform,
-    gint in_width, gint in_height, int in_cv_type,
-    gint out_width, gint out_height, int out_cv_type);
-
-/* Clean up */
-static void
-gst_edge_detect_finalize (GObject * obj)
-{
-  GstEdgeDetect *filter = GST_EDGE_DETECT (obj);
-
-  filter->cvGray.release ();
-  filter->cvEdge.release ();
-
-  G_OBJECT_CLASS (gst_edge_detect_parent_class)->finalize (obj);
-}
 
 /* initialize the edgedetect's class */
 static void
@@ -133,12 +118,11 @@ gst_edge_detect_class_init (GstEdgeDetectClass * klass)
   gobject_class = (GObjectClass *) klass;
   gstopencvbasefilter_class = (GstOpencvVideoFilterClass *) klass;
 
-  gobject_class->finalize = GST_DEBUG_FUNCPTR (gst_edge_detect_finalize);
   gobject_class->set_property = gst_edge_detect_set_property;
   gobject_class->get_property = gst_edge_detect_get_property;
 
   gstopencvbasefilter_class->cv_trans_func = gst_edge_detect_transform;
-  gstopencvbasefilter_class->cv_set_caps = gst_edge_detect_set_caps;
+  gstopencvbasefilter_class->stateless = TRUE;
 
   g_object_class_install_property (gobject_class, PROP_MASK,
       g_param_spec_boolean ("mask", "Mask",
@@ -234,37 +218,23 @@ gst_edge_detect_get_property (GObject * object, guint prop_id,
   }
 }
 
-/* GstElement vmethod implementations */
-
-/* this function handles the link with other elements */
-static gboolean
-gst_edge_detect_set_caps (GstOpencvVideoFilter * transform,
-    gint in_width, gint in_height, int in_cv_type,
-    gint out_width, gint out_height, int out_cv_type)
-{
-  GstEdgeDetect *filter = GST_EDGE_DETECT (transform);
-
-  filter->cvGray.create (cv::Size (in_width, in_height), CV_8UC1);
-  filter->cvEdge.create (cv::Size (in_width, in_height), CV_8UC1);
-
-  return TRUE;
-}
-
 static GstFlowReturn
 gst_edge_detect_transform (GstOpencvVideoFilter * base, GstBuffer * buf,
     cv::Mat img, GstBuffer * outbuf, cv::Mat outimg)
 {
   GstEdgeDetect *filter = GST_EDGE_DETECT (base);
+  cv::Mat & gray = *gst_opencv_video_filter_scratch (base, 0);
+  cv::Mat & edge = *gst_opencv_video_filter_scratch (base, 1);
 
-  cv::cvtColor (img, filter->cvGray, cv::COLOR_RGB2GRAY);
-  cv::Canny (filter->cvGray, filter->cvEdge, filter->threshold1,
-      filter->threshold2, filter->aperture);
+  cv::cvtColor (img, gray, cv::COLOR_RGB2GRAY);
+  cv::Canny (gray, edge, filter->threshold1, filter->threshold2,
+      filter->aperture);
 
   outimg.setTo (cv::Scalar::all (0));
   if (filter->mask) {
-    img.copyTo (outimg, filter->cvEdge);
+    img.copyTo (outimg, edge);
   } else {
-    cv::cvtColor (filter->cvEdge, outimg, cv::COLOR_GRAY2RGB);
+    cv::cvtColor (edge, outimg, cv::COLOR_GRAY2RGB);
   }
 
   return GST_FLOW_OK;
@@ -56,6 +56,12 @@
  * until the size is &lt;= GstFaceDetect::min-size-width or
  * GstFaceDetect::min-size-height.
  *
+ * To save CPU, GstFaceDetect::detect-scale detects faces on a smaller copy of
+ * the image, and GstFaceDetect::redetect-interval only runs the detector every
+ * few frames, following the faces found by template matching in between.
+ * The nose, mouth and eyes are still looked for at full resolution, with the
+ * three cascades running in parallel.
+ *
  * ## Example launch line
  *
  * |[
@@ -64,6 +70,9 @@
  * |[
  * gst-launch-1.0 autovideosrc ! video/x-raw,width=320,height=240 ! videoconvert ! facedetect min-size-width=60 min-size-height=60 ! colorspace ! xvimagesink
  * ]| Detect large faces on a smaller image
+ * |[
+ * gst-launch-1.0 autovideosrc ! videoconvert ! facedetect detect-scale=0.5 redetect-interval=5 ! videoconvert ! xvimagesink
+ * ]| Detect faces on a half size image every 5 frames, and track them in between
  *
  */
 
@@ -103,6 +112,11 @@ GST_DEBUG_CATEGORY_STATIC (gst_face_detect_debug);
 #define DEFAULT_MIN_SIZE_WIDTH 30
 #define DEFAULT_MIN_SIZE_HEIGHT 30
 #define DEFAULT_MIN_STDDEV 0
+#define DEFAULT_DETECT_SCALE 1.0
+#define DEFAULT_REDETECT_INTERVAL 1
+
+/* Lowest normalized correlation at which a tracked face is still found */
+#define TRACK_MIN_SCORE 0.6
 
 using namespace cv;
 /* Filter signals and args */
@@ -126,7 +140,18 @@ enum
   PROP_MIN_SIZE_WIDTH,
   PROP_MIN_SIZE_HEIGHT,
   PROP_UPDATES,
-  PROP_MIN_STDDEV
+  PROP_MIN_STDDEV,
+  PROP_DETECT_SCALE,
+  PROP_REDETECT_INTERVAL
+};
+
+/* Face features, each with its own cascade */
+enum
+{
+  FEATURE_NOSE,
+  FEATURE_MOUTH,
+  FEATURE_EYES,
+  N_FEATURES
 };
 
 
@@ -248,6 +273,9 @@ gst_face_detect_finalize (GObject * obj)
   GstFaceDetect *filter = GST_FACE_DETECT (obj);
 
   filter->cvGray.release ();
+  filter->cvSmall.release ();
+  delete filter->tracked;
+  delete filter->templates;
 
   g_free (filter->face_profile);
   g_free (filter->nose_profile);
@@ -347,6 +375,20 @@ gst_face_detect_class_init (GstFaceDetectClass * klass)
           "false positives not performing face detection on images with "
           "little changes", 0, 255, DEFAULT_MIN_STDDEV,
           (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_DETECT_SCALE,
+      g_param_spec_double ("detect-scale", "Detect scale",
+          "Scale of the image faces are detected on, relative to the input. "
+          "Smaller is faster, but misses faces smaller than min-size-width "
+          "and min-size-height times this scale", 0.1, 1.0,
+          DEFAULT_DETECT_SCALE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_REDETECT_INTERVAL,
+      g_param_spec_uint ("redetect-interval", "Redetect interval",
+          "Run the face detector every this many frames, following the faces "
+          "found by template matching on the frames in between, or until "
+          "they are lost; 1 detects on every frame", 1, G_MAXUINT,
+          DEFAULT_REDETECT_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS)));
 
   gst_element_class_set_static_metadata (element_class,
       "facedetect",
@@ -379,6 +421,12 @@ gst_face_detect_init (GstFaceDetect * filter)
   filter->min_size_width = DEFAULT_MIN_SIZE_WIDTH;
   filter->min_size_height = DEFAULT_MIN_SIZE_HEIGHT;
   filter->min_stddev = DEFAULT_MIN_STDDEV;
+  filter->detect_scale = DEFAULT_DETECT_SCALE;
+  filter->redetect_interval = DEFAULT_REDETECT_INTERVAL;
+  filter->tracked = new vector < Rect > ();
+  filter->templates = new vector < Mat > ();
+  filter->tracked_scale = DEFAULT_DETECT_SCALE;
+  filter->frames_tracked = 0;
   filter->cvFaceDetect =
       gst_face_detect_load_profile (filter, filter->face_profile);
   filter->cvNoseDetect =
@@ -456,6 +504,12 @@ gst_face_detect_set_property (GObject * object, guint prop_id,
     case PROP_UPDATES:
       filter->updates = g_value_get_enum (value);
       break;
+    case PROP_DETECT_SCALE:
+      filter->detect_scale = g_value_get_double (value);
+      break;
+    case PROP_REDETECT_INTERVAL:
+      filter->redetect_interval = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -505,6 +559,12 @@ gst_face_detect_get_property (GObject * object, guint prop_id,
     case PROP_UPDATES:
       g_value_set_enum (value, filter->updates);
       break;
+    case PROP_DETECT_SCALE:
+      g_value_set_double (value, filter->detect_scale);
+      break;
+    case PROP_REDETECT_INTERVAL:
+      g_value_set_uint (value, filter->redetect_interval);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -524,6 +584,7 @@ gst_face_detect_set_caps (GstOpencvVideoFilter * transform, gint in_width,
   filter = GST_FACE_DETECT (transform);
 
   filter->cvGray.create (Size (in_width, in_height), CV_8UC1);
+  filter->tracked->clear ();
 
   return TRUE;
 }
@@ -551,24 +612,156 @@ gst_face_detect_message_new (GstFaceDetect * filter, GstBuffer * buf)
 
 static void
 gst_face_detect_run_detector (GstFaceDetect * filter,
-    CascadeClassifier * detector, gint min_size_width,
+    CascadeClassifier * detector, const Mat & gray, gint min_size_width,
     gint min_size_height, Rect r, vector < Rect > &faces)
 {
+  Mat roi (gray, r);
+  detector->detectMultiScale (roi, faces, filter->scale_factor,
+      filter->min_neighbors, filter->flags, Size (min_size_width,
+          min_size_height), Size (0, 0));
+}
+
+/* The part of face r a feature is looked for in */
+static Rect
+gst_face_detect_feature_roi (const Rect & r, gint feature)
+{
+  switch (feature) {
+    case FEATURE_NOSE:
+      return Rect (r.x + r.width / 4, r.y + r.height / 4, r.width / 2,
+          r.height / 2);
+    case FEATURE_MOUTH:
+      return Rect (r.x, r.y + r.height / 2, r.width, r.height / 2);
+    default:
+      return Rect (r.x, r.y, r.width, r.height / 2);
+  }
+}
+
+/* Looks for the features of all the faces, each feature on its own
+ * thread, as a CascadeClassifier can only run once at a time */
+class GstFaceDetectFeatures:public ParallelLoopBody
+{
+public:
+  GstFaceDetectFeatures (GstFaceDetect * filter, const vector < Rect > &faces,
+      vector < vector < Rect > >*features)
+  : filter (filter), faces (faces), features (features)
+  {
+  }
+
+  virtual void operator () (const Range & range) const
+  {
+    for (int f = range.start; f < range.end; f++) {
+      CascadeClassifier *detector = f == FEATURE_NOSE ? filter->cvNoseDetect :
+          f == FEATURE_MOUTH ? filter->cvMouthDetect : filter->cvEyesDetect;
+
+      if (!detector)
+        continue;
+
+      for (size_t i = 0; i < faces.size (); i++)
+        gst_face_detect_run_detector (filter, detector, filter->cvGray,
+            filter->min_size_width / 8, filter->min_size_height / 8,
+            gst_face_detect_feature_roi (faces[i], f), features[f][i]);
+    }
+  }
+
+private:
+  GstFaceDetect *filter;
+  const vector < Rect > &faces;
+  vector < vector < Rect > >*features;
+};
+
+/* Follows the faces of the previous frame on gray, by matching what they
+ * looked like around where they were, and drops those that are lost */
+static void
+gst_face_detect_track (GstFaceDetect * filter, const Mat & gray)
+{
+  vector < Rect > &tracked = *filter->tracked;
+  vector < Mat > &templates = *filter->templates;
+  Rect bounds (0, 0, gray.cols, gray.rows);
+  size_t n = 0;
+
+  for (size_t i = 0; i < tracked.size () && i < templates.size (); i++) {
+    Rect r = tracked[i];
+    Rect window = Rect (r.x - r.width / 2, r.y - r.height / 2, r.width * 2,
+        r.height * 2) & bounds;
+    Mat score;
+    double best;
+    Point loc;
+
+    if (window.width < templates[i].cols || window.height < templates[i].rows)
+      continue;
+
+    matchTemplate (gray (window), templates[i], score, TM_CCOEFF_NORMED);
+    minMaxLoc (score, NULL, &best, NULL, &loc);
+    if (best < TRACK_MIN_SCORE) {
+      GST_LOG_OBJECT (filter, "lost face %" G_GSIZE_FORMAT ", score %f", i,
+          best);
+      continue;
+    }
+
+    tracked[n++] = Rect (window.x + loc.x, window.y + loc.y, r.width,
+        r.height);
+  }
+  tracked.resize (n);
+}
+
+/* Finds the faces on this frame, in full resolution coordinates, either
+ * with the detector or by tracking those of the previous frame */
+static void
+gst_face_detect_find_faces (GstFaceDetect * filter, vector < Rect > &faces)
+{
+  vector < Rect > &tracked = *filter->tracked;
+  gdouble scale = filter->detect_scale;
+  Rect bounds (0, 0, filter->cvGray.cols, filter->cvGray.rows);
   double img_stddev = 0;
+
+  faces.clear ();
+
   if (filter->min_stddev > 0) {
     Scalar mean, stddev;
     meanStdDev (filter->cvGray, mean, stddev);
     img_stddev = stddev.val[0];
   }
-  if (img_stddev >= filter->min_stddev) {
-    Mat roi (filter->cvGray, r);
-    detector->detectMultiScale (roi, faces, filter->scale_factor,
-        filter->min_neighbors, filter->flags, Size (min_size_width,
-            min_size_height), Size (0, 0));
-  } else {
+  if (img_stddev < filter->min_stddev) {
     GST_LOG_OBJECT (filter,
         "Calculated stddev %f lesser than min_stddev %d, detection not performed",
         img_stddev, filter->min_stddev);
+    tracked.clear ();
+    return;
+  }
+
+  if (scale < 1.0)
+    resize (filter->cvGray, filter->cvSmall, Size (), scale, scale,
+        INTER_AREA);
+  else
+    filter->cvSmall = filter->cvGray;
+
+  if (scale != filter->tracked_scale) {
+    tracked.clear ();
+    filter->tracked_scale = scale;
+  }
+
+  if (tracked.empty ()
+      || ++filter->frames_tracked >= filter->redetect_interval) {
+    gst_face_detect_run_detector (filter, filter->cvFaceDetect,
+        filter->cvSmall, cvRound (filter->min_size_width * scale),
+        cvRound (filter->min_size_height * scale),
+        Rect (0, 0, filter->cvSmall.cols, filter->cvSmall.rows), tracked);
+    filter->frames_tracked = 0;
+  } else {
+    gst_face_detect_track (filter, filter->cvSmall);
+  }
+
+  if (filter->redetect_interval > 1) {
+    filter->templates->resize (tracked.size ());
+    for (size_t i = 0; i < tracked.size (); i++)
+      filter->cvSmall (tracked[i]).copyTo ((*filter->templates)[i]);
+  }
+
+  for (size_t i = 0; i < tracked.size (); i++) {
+    Rect r = tracked[i];
+
+    faces.push_back (Rect (cvRound (r.x / scale), cvRound (r.y / scale),
+            cvRound (r.width / scale), cvRound (r.height / scale)) & bounds);
   }
 }
 
@@ -587,18 +780,19 @@ gst_face_detect_transform_ip (GstOpencvVideoFilter * base, GstBuffer * buf,
     GValue facelist = { 0 };
     GValue facedata = { 0 };
     vector < Rect > faces;
-    vector < Rect > mouth;
-    vector < Rect > nose;
-    vector < Rect > eyes;
+    vector < vector < Rect > >features[N_FEATURES];
     gboolean post_msg = FALSE;
 
     cvtColor (img, filter->cvGray, COLOR_RGB2GRAY);
 
-    gst_face_detect_run_detector (filter, filter->cvFaceDetect,
-        filter->min_size_width, filter->min_size_height,
-        Rect (0, 0,
-            filter->cvGray.size ().width, filter->cvGray.size ().height),
-        faces);
+    gst_face_detect_find_faces (filter, faces);
+
+    /* detect face features */
+    for (int f = 0; f < N_FEATURES; f++)
+      features[f].resize (faces.size ());
+    if (!faces.empty ())
+      parallel_for_ (Range (0, N_FEATURES), GstFaceDetectFeatures (filter,
+              faces, features), N_FEATURES);
 
     switch (filter->updates) {
       case GST_FACEDETECT_UPDATES_EVERY_FRAME:
@@ -638,51 +832,18 @@ gst_face_detect_transform_ip (GstOpencvVideoFilter * base, GstBuffer * buf,
 
     for (unsigned int i = 0; i < faces.size (); ++i) {
       Rect r = faces[i];
-      guint mw = filter->min_size_width / 8;
-      guint mh = filter->min_size_height / 8;
-      guint rnx = 0, rny = 0, rnw, rnh;
-      guint rmx = 0, rmy = 0, rmw, rmh;
-      guint rex = 0, rey = 0, rew, reh;
-      guint rhh = r.height / 2;
-      gboolean have_nose, have_mouth, have_eyes;
-
-      /* detect face features */
-
-      if (filter->cvNoseDetect) {
-        rnx = r.x + r.width / 4;
-        rny = r.y + r.height / 4;
-        rnw = r.width / 2;
-        rnh = rhh;
-        gst_face_detect_run_detector (filter, filter->cvNoseDetect, mw, mh,
-            Rect (rnx, rny, rnw, rnh), nose);
-        have_nose = !nose.empty ();
-      } else {
-        have_nose = FALSE;
-      }
-
-      if (filter->cvMouthDetect) {
-        rmx = r.x;
-        rmy = r.y + r.height / 2;
-        rmw = r.width;
-        rmh = rhh;
-        gst_face_detect_run_detector (filter, filter->cvMouthDetect, mw,
-            mh, Rect (rmx, rmy, rmw, rmh), mouth);
-        have_mouth = !mouth.empty ();
-      } else {
-        have_mouth = FALSE;
-      }
-
-      if (filter->cvEyesDetect) {
-        rex = r.x;
-        rey = r.y;
-        rew = r.width;
-        reh = rhh;
-        gst_face_detect_run_detector (filter, filter->cvEyesDetect, mw, mh,
-            Rect (rex, rey, rew, reh), eyes);
-        have_eyes = !eyes.empty ();
-      } else {
-        have_eyes = FALSE;
-      }
+      vector < Rect > &nose = features[FEATURE_NOSE][i];
+      vector < Rect > &mouth = features[FEATURE_MOUTH][i];
+      vector < Rect > &eyes = features[FEATURE_EYES][i];
+      Rect rn = gst_face_detect_feature_roi (r, FEATURE_NOSE);
+      Rect rm = gst_face_detect_feature_roi (r, FEATURE_MOUTH);
+      Rect re = gst_face_detect_feature_roi (r, FEATURE_EYES);
+      guint rnx = rn.x, rny = rn.y;
+      guint rmx = rm.x, rmy = rm.y;
+      guint rex = re.x, rey = re.y;
+      gboolean have_nose = !nose.empty ();
+      gboolean have_mouth = !mouth.empty ();
+      gboolean have_eyes = !eyes.empty ();
 
       GST_LOG_OBJECT (filter,
           "%2d/%2" G_GSIZE_FORMAT
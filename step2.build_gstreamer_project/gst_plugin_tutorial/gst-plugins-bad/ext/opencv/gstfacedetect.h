@@ -102,8 +102,19 @@ struct _GstFaceDetect
   gint min_size_height;
   gint min_stddev;
   gint updates;
+  gdouble detect_scale;
+  guint redetect_interval;
 
   cv::Mat cvGray;
+  cv::Mat cvSmall;
+
+  /* faces followed between detections, in cvSmall coordinates at
+   * tracked_scale, and what they looked like on the last frame */
+  std::vector < cv::Rect > *tracked;
+  std::vector < cv::Mat > *templates;
+  gdouble tracked_scale;
+  guint frames_tracked;
+
   cv::CascadeClassifier *cvFaceDetect;
   cv::CascadeClassifier *cvNoseDetect;
   cv::CascadeClassifier *cvMouthDetect;
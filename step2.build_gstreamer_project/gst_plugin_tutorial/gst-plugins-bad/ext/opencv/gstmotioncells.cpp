@@ -65,7 +65,7 @@ GST_DEBUG_CATEGORY_STATIC (gst_motion_cells_debug);
 
 #define GRID_DEF 10
 #define GRID_MIN 8
-#define GRID_MAX 32
+#define GRID_MAX 64
 #define SENSITIVITY_DEFAULT 0.5
 #define SENSITIVITY_MIN 0
 #define SENSITIVITY_MAX 1
@@ -91,6 +91,7 @@
 
 #include "gstsegmentation.h"
 #include <opencv2/imgproc.hpp>
+#include <opencv2/core/hal/intrin.hpp>
 
 GST_DEBUG_CATEGORY_STATIC (gst_segmentation_debug);
 #define GST_CAT_DEFAULT gst_segmentation_debug
@@ -168,11 +169,11 @@ static gboolean gst_segmentation_set_caps (GstOpencvVideoFilter * filter,
     gint out_height, int out_cv_type);
 
 /* Codebook algorithm + connected components functions*/
-static int update_codebook (unsigned char *p, codeBook * c,
-    unsigned *cbBounds, int numChannels);
-static int clear_stale_entries (codeBook * c);
-static unsigned char background_diff (unsigned char *p, codeBook * c,
-    int numChannels, int *minMod, int *maxMod);
+static void init_codebook (codeBooks * c, int width, int height);
+static void update_codebook (const Mat & yuv, codeBooks * c,
+    const unsigned *cbBounds);
+static void background_diff (const Mat & yuv, codeBooks * c, Mat & fg,
+    const unsigned *minMod, const unsigned *maxMod);
 static void find_connected_components (Mat mask, int poly1_hull0,
     float perimScale);
 
@@ -310,13 +311,7 @@ gst_segmentation_set_caps (GstOpencvVideoFilter * filter, gint in_width,
   segmentation->ch3.create (size, CV_8UC1);
 
   /* Codebook method */
-  segmentation->TcodeBook = (codeBook *)
-      g_malloc (sizeof (codeBook) *
-      (segmentation->width * segmentation->height + 1));
-  for (int j = 0; j < segmentation->width * segmentation->height; j++) {
-    segmentation->TcodeBook[j].numEntries = 0;
-    segmentation->TcodeBook[j].t = 0;
-  }
+  init_codebook (&segmentation->codebook, in_width, in_height);
   segmentation->learning_interval = (int) (1.0 / segmentation->learning_rate);
 
   /* Mixture-of-Gaussians (mog) methods */
@@ -340,7 +335,8 @@ gst_segmentation_finalize (GObject * object)
   filter->ch3.release ();
   filter->mog.release ();
   filter->mog2.release ();
-  g_free (filter->TcodeBook);
+  filter->codebook.entries.release ();
+  filter->codebook.num_entries.release ();
 
   G_OBJECT_CLASS (gst_segmentation_parent_class)->finalize (object);
 }
@@ -350,7 +346,6 @@ gst_segmentation_transform_ip (GstOpencvVideoFilter * cvfilter,
     GstBuffer * buffer, Mat img)
 {
   GstSegmentation *filter = GST_SEGMENTATION (cvfilter);
-  int j;
 
   filter->framecount++;
 
@@ -367,38 +362,20 @@ gst_segmentation_transform_ip (GstOpencvVideoFilter * cvfilter,
    * Real-time Imaging, Volume 11, Issue 3, Pages 167-256, June 2005. */
   if (METHOD_BOOK == filter->method) {
     unsigned cbBounds[3] = { 10, 5, 5 };
-    int minMod[3] = { 20, 20, 20 }, maxMod[3] = {
+    unsigned minMod[3] = { 20, 20, 20 }, maxMod[3] = {
       20, 20, 20
     };
 
     if (filter->framecount < 30) {
       /* Learning background phase: update_codebook on every frame */
-      for (j = 0; j < filter->width * filter->height; j++) {
-        update_codebook (filter->cvYUV.data + j * 3,
-            (codeBook *) & (filter->TcodeBook[j]), cbBounds, 3);
-      }
+      update_codebook (filter->cvYUV, &filter->codebook, cbBounds);
     } else {
       /*  this updating is responsible for FG becoming BG again */
-      if (filter->framecount % filter->learning_interval == 0) {
-        for (j = 0; j < filter->width * filter->height; j++) {
-          update_codebook (filter->cvYUV.data + j * 3,
-              (codeBook *) & (filter->TcodeBook[j]), cbBounds, 3);
-        }
-      }
-      if (filter->framecount % 60 == 0) {
-        for (j = 0; j < filter->width * filter->height; j++)
-          clear_stale_entries ((codeBook *) & (filter->TcodeBook[j]));
-      }
+      if (filter->framecount % filter->learning_interval == 0)
+        update_codebook (filter->cvYUV, &filter->codebook, cbBounds);
 
-      for (j = 0; j < filter->width * filter->height; j++) {
-        if (background_diff
-            (filter->cvYUV.data + j * 3,
-                (codeBook *) & (filter->TcodeBook[j]), 3, minMod, maxMod)) {
-          filter->cvFG.data[j] = (char) 255;
-        } else {
-          filter->cvFG.data[j] = 0;
-        }
-      }
+      background_diff (filter->cvYUV, &filter->codebook, filter->cvFG,
+          minMod, maxMod);
     }
 
     /* 3rd param is the smallest area to show: (w+h)/param , in pixels */
@@ -468,204 +445,351 @@ gst_segmentation_plugin_init (GstPlugin * plugin)
 
 #ifdef CODE_FROM_OREILLY_BOOK   /* See license at the beginning of the page */
 /*
-  int update_codebook(uchar *p, codeBook &c, unsigned cbBounds)
-  Updates the codebook entry with a new data point
+  The codebook functions of the book, on the structure of arrays of
+  codeBooks.  Each works on a row of pixels at a time, 16 pixels at once
+  with SIMD and the remainder one by one.
+
+  The book grows the codebook of a pixel without bound.  Here every pixel
+  has room for CODEBOOK_CAPACITY codewords; once they are all in use, a
+  value that fits none of them replaces the newest one, so the codewords
+  learned first, the background, stay.  Until a pixel is full the result
+  is the book's, bit for bit.
+
+  The book tracks how stale each codeword gets from a count of accesses
+  c.t that the caller is expected to advance, and this element never did,
+  so clear_stale_entries() never cleared a codeword.  The codebooks here
+  do not track staleness at all.
+*/
+
+/* Codewords every pixel has room for */
+#define CODEBOOK_CAPACITY 8
+/* Rows of pixels in a tile processed by one thread */
+#define CODEBOOK_TILE_ROWS 16
+
+/*
+  void update_codebook_pixel(uchar *p, uchar *n, uchar *e, size_t plane,
+  int capacity, unsigned *cbBounds)
+  Updates the codebook of a pixel with a new data point
 
   p Pointer to a YUV or HSI pixel
-  c Codebook for this pixel
+  n Number of codewords of the pixel
+  e First plane of the first codeword of the pixel
+  plane Distance between two planes
+  capacity Codewords the pixel has room for
   cbBounds Learning bounds for codebook (Rule of thumb: 10)
-  numChannels Number of color channels we¡¯re learning
-
-  NOTES:
-  cvBounds must be of length equal to numChannels
-
-  RETURN
-  codebook index
 */
-int
-update_codebook (unsigned char *p, codeBook * c, unsigned *cbBounds,
-    int numChannels)
+static inline void
+update_codebook_pixel (const unsigned char *p, unsigned char *n,
+    unsigned char *e, size_t plane, int capacity, const unsigned *cbBounds)
 {
-/* c->t+=1; */
-  unsigned int high[3], low[3];
-  int n, i;
-  int matchChannel;
-
-  for (n = 0; n < numChannels; n++) {
-    high[n] = p[n] + cbBounds[n];
-    if (high[n] > 255)
-      high[n] = 255;
-
-    if (p[n] > cbBounds[n])
-      low[n] = p[n] - cbBounds[n];
-    else
-      low[n] = 0;
+  unsigned char high[CHANNELS], low[CHANNELS];
+  unsigned char *cw;
+  int i, c;
+
+  for (c = 0; c < CHANNELS; c++) {
+    high[c] = MIN (p[c] + cbBounds[c], 255);
+    low[c] = p[c] > cbBounds[c] ? p[c] - cbBounds[c] : 0;
   }
 
 /*  SEE IF THIS FITS AN EXISTING CODEWORD */
-  for (i = 0; i < c->numEntries; i++) {
-    matchChannel = 0;
-    for (n = 0; n < numChannels; n++) {
-      if ((c->cb[i]->learnLow[n] <= *(p + n)) &&
-/* Found an entry for this channel */
-          (*(p + n) <= c->cb[i]->learnHigh[n])) {
-        matchChannel++;
-      }
+  for (i = 0; i < *n; i++) {
+    cw = e + i * CB_N_PLANES * plane;
+    for (c = 0; c < CHANNELS; c++) {
+      if (p[c] < cw[(CB_LEARN_LOW + c) * plane] ||
+          p[c] > cw[(CB_LEARN_HIGH + c) * plane])
+        break;
     }
-    if (matchChannel == numChannels) {  /* If an entry was found */
-      c->cb[i]->t_last_update = c->t;
-/* adjust this codeword for the first channel */
-      for (n = 0; n < numChannels; n++) {
-        if (c->cb[i]->max[n] < *(p + n)) {
-          c->cb[i]->max[n] = *(p + n);
-        } else if (c->cb[i]->min[n] > *(p + n)) {
-          c->cb[i]->min[n] = *(p + n);
-        }
-      }
+    if (c == CHANNELS)
       break;
-    }
   }
-/*  OVERHEAD TO TRACK POTENTIAL STALE ENTRIES */
-  for (int s = 0; s < c->numEntries; s++) {
-/*  Track which codebook entries are going stale: */
-    int negRun = c->t - c->cb[s]->t_last_update;
-    if (c->cb[s]->stale < negRun)
-      c->cb[s]->stale = negRun;
-  }
-/*  ENTER A NEW CODEWORD IF NEEDED */
-  if (i == c->numEntries) {     /* if no existing codeword found, make one */
-    code_element **foo =
-        (code_element **) g_malloc (sizeof (code_element *) *
-        (c->numEntries + 1));
-    for (int ii = 0; ii < c->numEntries; ii++) {
-      foo[ii] = c->cb[ii];      /* copy all pointers */
+
+  cw = e + i * CB_N_PLANES * plane;
+  if (i < *n) {
+/* adjust this codeword; min <= max, so this is the book's if/else if */
+    for (c = 0; c < CHANNELS; c++) {
+      cw[(CB_MAX + c) * plane] = MAX (cw[(CB_MAX + c) * plane], p[c]);
+      cw[(CB_MIN + c) * plane] = MIN (cw[(CB_MIN + c) * plane], p[c]);
     }
-    foo[c->numEntries] = (code_element *) g_malloc (sizeof (code_element));
-    if (c->numEntries)
-      g_free (c->cb);
-    c->cb = foo;
-    for (n = 0; n < numChannels; n++) {
-      c->cb[c->numEntries]->learnHigh[n] = high[n];
-      c->cb[c->numEntries]->learnLow[n] = low[n];
-      c->cb[c->numEntries]->max[n] = *(p + n);
-      c->cb[c->numEntries]->min[n] = *(p + n);
+  } else {
+/*  ENTER A NEW CODEWORD, in place of the newest one when full */
+    if (i >= capacity)
+      cw = e + --i * CB_N_PLANES * plane;
+    for (c = 0; c < CHANNELS; c++) {
+      cw[(CB_LEARN_HIGH + c) * plane] = high[c];
+      cw[(CB_LEARN_LOW + c) * plane] = low[c];
+      cw[(CB_MAX + c) * plane] = p[c];
+      cw[(CB_MIN + c) * plane] = p[c];
     }
-    c->cb[c->numEntries]->t_last_update = c->t;
-    c->cb[c->numEntries]->stale = 0;
-    c->numEntries += 1;
+    *n = i + 1;
+    return;
   }
+
 /*  SLOWLY ADJUST LEARNING BOUNDS */
-  for (n = 0; n < numChannels; n++) {
-    if (c->cb[i]->learnHigh[n] < high[n])
-      c->cb[i]->learnHigh[n] += 1;
-    if (c->cb[i]->learnLow[n] > low[n])
-      c->cb[i]->learnLow[n] -= 1;
+  for (c = 0; c < CHANNELS; c++) {
+    if (cw[(CB_LEARN_HIGH + c) * plane] < high[c])
+      cw[(CB_LEARN_HIGH + c) * plane] += 1;
+    if (cw[(CB_LEARN_LOW + c) * plane] > low[c])
+      cw[(CB_LEARN_LOW + c) * plane] -= 1;
   }
-  return (i);
 }
 
-
-
-
-
 /*
- int clear_stale_entries(codeBook &c)
-  During learning, after you've learned for some period of time,
-  periodically call this to clear out stale codebook entries
-
-  c Codebook to clean up
-
-  Return
-  number of entries cleared
+  Updates the codebooks of a row of len pixels, see update_codebook_pixel.
+  Every pixel must have room for one more codeword.
 */
-int
-clear_stale_entries (codeBook * c)
+static void
+update_codebook_row (const unsigned char *p, unsigned char *n,
+    unsigned char *e, size_t plane, int len, int capacity,
+    const unsigned *cbBounds)
 {
-  int staleThresh = c->t >> 1;
-  int *keep = (int *) g_malloc (sizeof (int) * (c->numEntries));
-  int keepCnt = 0;
-  code_element **foo;
-  int k;
-  int numCleared;
-/*  SEE WHICH CODEBOOK ENTRIES ARE TOO STALE */
-  for (int i = 0; i < c->numEntries; i++) {
-    if (c->cb[i]->stale > staleThresh)
-      keep[i] = 0;              /* Mark for destruction */
-    else {
-      keep[i] = 1;              /* Mark to keep */
-      keepCnt += 1;
+  int x = 0;
+
+#if CV_SIMD128
+  const v_uint8x16 one = v_setall_u8 (1);
+  v_uint8x16 bounds[CHANNELS];
+  int c;
+
+  for (c = 0; c < CHANNELS; c++)
+    bounds[c] = v_setall_u8 ((uchar) MIN (cbBounds[c], 255));
+
+  for (; x <= len - 16; x += 16) {
+    v_uint8x16 v[CHANNELS], high[CHANNELS], low[CHANNELS];
+    v_uint8x16 vn = v_load (n + x);
+    v_uint8x16 found = v_setzero_u8 ();
+    uchar lanes[16];
+    int kmax = 0;
+
+    v_load_deinterleave (p + x * CHANNELS, v[0], v[1], v[2]);
+    for (c = 0; c < CHANNELS; c++) {
+      /* saturating, like the clamping of the book */
+      high[c] = v[c] + bounds[c];
+      low[c] = v[c] - bounds[c];
     }
-  }
-  /*  KEEP ONLY THE GOOD */
-  c->t = 0;                     /* Full reset on stale tracking */
-  foo = (code_element **) g_malloc (sizeof (code_element *) * keepCnt);
-  k = 0;
-  for (int ii = 0; ii < c->numEntries; ii++) {
-    if (keep[ii]) {
-      foo[k] = c->cb[ii];
-      /* We have to refresh these entries for next clearStale */
-      foo[k]->t_last_update = 0;
-      k++;
+
+    for (int j = 0; j < 16; j++)
+      kmax = MAX (kmax, n[x + j]);
+
+    /* the first codeword that fits each pixel gets adjusted */
+    for (int k = 0; k < kmax; k++) {
+      unsigned char *cw = e + k * CB_N_PLANES * plane + x;
+      v_uint8x16 m = (v_setall_u8 ((uchar) k) < vn) & ~found;
+
+      for (c = 0; c < CHANNELS; c++)
+        m = m & (v_load (cw + (CB_LEARN_LOW + c) * plane) <= v[c]) &
+            (v[c] <= v_load (cw + (CB_LEARN_HIGH + c) * plane));
+      if (!v_check_any (m))
+        continue;
+
+      for (c = 0; c < CHANNELS; c++) {
+        unsigned char *lh = cw + (CB_LEARN_HIGH + c) * plane;
+        unsigned char *ll = cw + (CB_LEARN_LOW + c) * plane;
+        unsigned char *mx = cw + (CB_MAX + c) * plane;
+        unsigned char *mn = cw + (CB_MIN + c) * plane;
+        v_uint8x16 vlh = v_load (lh), vll = v_load (ll);
+        v_uint8x16 vmx = v_load (mx), vmn = v_load (mn);
+
+        v_store (mx, v_select (m, v_max (vmx, v[c]), vmx));
+        v_store (mn, v_select (m, v_min (vmn, v[c]), vmn));
+        v_store (lh, v_select (m & (vlh < high[c]), vlh + one, vlh));
+        v_store (ll, v_select (m & (vll > low[c]), vll - one, vll));
+      }
+      found = found | m;
     }
-  }
-  /*  CLEAN UP */
-  g_free (keep);
-  g_free (c->cb);
-  c->cb = foo;
-  numCleared = c->numEntries - keepCnt;
-  c->numEntries = keepCnt;
-  return (numCleared);
-}
 
+    if (v_check_all (found))
+      continue;
 
+    /* the others get a new codeword, at a different index each */
+    v_store (lanes, found);
+    for (int j = 0; j < 16; j++) {
+      if (!lanes[j])
+        update_codebook_pixel (p + (x + j) * CHANNELS, n + x + j, e + x + j,
+            plane, capacity, cbBounds);
+    }
+  }
+#endif
+
+  for (; x < len; x++)
+    update_codebook_pixel (p + x * CHANNELS, n + x, e + x, plane, capacity,
+        cbBounds);
+}
 
 /*
-  uchar background_diff( uchar *p, codeBook &c,
-  int minMod, int maxMod)
-  Given a pixel and a codebook, determine if the pixel is
+  uchar background_diff_pixel(uchar *p, uchar n, uchar *e, size_t plane,
+  unsigned *minMod, unsigned *maxMod)
+  Given a pixel and its codebook, determine if the pixel is
   covered by the codebook
 
   p Pixel pointer (YUV interleaved)
-  c Codebook reference
-  numChannels Number of channels we are testing
-  maxMod Add this (possibly negative) number onto
+  n Number of codewords of the pixel
+  e First plane of the first codeword of the pixel
+  plane Distance between two planes
+  maxMod Add this number onto
 
   max level when determining if new pixel is foreground
-  minMod Subtract this (possibly negative) number from
+  minMod Subtract this number from
   min level when determining if new pixel is foreground
 
   NOTES:
-  minMod and maxMod must have length numChannels,
+  minMod and maxMod must have length CHANNELS,
   e.g. 3 channels => minMod[3], maxMod[3]. There is one min and
   one max threshold per channel.
 
   Return
   0 => background, 255 => foreground
 */
-unsigned char
-background_diff (unsigned char *p, codeBook * c, int numChannels,
-    int *minMod, int *maxMod)
+static inline unsigned char
+background_diff_pixel (const unsigned char *p, unsigned char n,
+    const unsigned char *e, size_t plane, const unsigned *minMod,
+    const unsigned *maxMod)
 {
-  int matchChannel;
+  int i, c;
+
 /*  SEE IF THIS FITS AN EXISTING CODEWORD */
-  int i;
-  for (i = 0; i < c->numEntries; i++) {
-    matchChannel = 0;
-    for (int n = 0; n < numChannels; n++) {
-      if ((c->cb[i]->min[n] - minMod[n] <= *(p + n)) &&
-          (*(p + n) <= c->cb[i]->max[n] + maxMod[n])) {
-        matchChannel++;         /* Found an entry for this channel */
-      } else {
+  for (i = 0; i < n; i++) {
+    const unsigned char *cw = e + i * CB_N_PLANES * plane;
+
+    for (c = 0; c < CHANNELS; c++) {
+      if ((int) cw[(CB_MIN + c) * plane] - (int) minMod[c] > p[c] ||
+          p[c] > (int) cw[(CB_MAX + c) * plane] + (int) maxMod[c])
         break;
-      }
     }
-    if (matchChannel == numChannels) {
-      break;                    /* Found an entry that matched all channels */
+    if (c == CHANNELS)
+      return 0;                 /* Found an entry that matched all channels */
+  }
+
+  return 255;
+}
+
+/*
+  Writes the foreground mask of a row of len pixels, see
+  background_diff_pixel
+*/
+static void
+background_diff_row (const unsigned char *p, const unsigned char *n,
+    const unsigned char *e, size_t plane, int len, unsigned char *fg,
+    const unsigned *minMod, const unsigned *maxMod)
+{
+  int x = 0;
+
+#if CV_SIMD128
+  v_uint8x16 vmin[CHANNELS], vmax[CHANNELS];
+  int c;
+
+  for (c = 0; c < CHANNELS; c++) {
+    vmin[c] = v_setall_u8 ((uchar) MIN (minMod[c], 255));
+    vmax[c] = v_setall_u8 ((uchar) MIN (maxMod[c], 255));
+  }
+
+  for (; x <= len - 16; x += 16) {
+    v_uint8x16 v[CHANNELS];
+    v_uint8x16 vn = v_load (n + x);
+    v_uint8x16 bg = v_setzero_u8 ();
+    int kmax = 0;
+
+    v_load_deinterleave (p + x * CHANNELS, v[0], v[1], v[2]);
+
+    for (int j = 0; j < 16; j++)
+      kmax = MAX (kmax, n[x + j]);
+
+    for (int k = 0; k < kmax && !v_check_all (bg); k++) {
+      const unsigned char *cw = e + k * CB_N_PLANES * plane + x;
+      v_uint8x16 m = v_setall_u8 ((uchar) k) < vn;
+
+      /* saturating, which compares the same as the ints of the book */
+      for (c = 0; c < CHANNELS; c++)
+        m = m & (v_load (cw + (CB_MIN + c) * plane) - vmin[c] <= v[c]) &
+            (v[c] <= v_load (cw + (CB_MAX + c) * plane) + vmax[c]);
+      bg = bg | m;
     }
+
+    v_store (fg + x, ~bg);
   }
-  if (i >= c->numEntries)
-    return (255);
-  return (0);
+#endif
+
+  for (; x < len; x++)
+    fg[x] = background_diff_pixel (p + x * CHANNELS, n[x], e + x, plane,
+        minMod, maxMod);
+}
+
+/* Runs the codebook functions over tiles of rows of the image, in
+ * parallel */
+class CodebookInvoker:public ParallelLoopBody
+{
+public:
+  CodebookInvoker (const Mat & yuv, codeBooks * c, const unsigned *bounds,
+      const unsigned *minMod, const unsigned *maxMod, Mat * fg)
+  : yuv (yuv), c (c), bounds (bounds), minMod (minMod), maxMod (maxMod),
+      fg (fg)
+  {
+  }
+
+  virtual void operator () (const Range & range) const
+  {
+    size_t plane = c->entries.step;
+
+    for (int y = range.start; y < range.end; y++) {
+      const unsigned char *p = yuv.ptr < unsigned char >(y);
+      unsigned char *n = c->num_entries.ptr < unsigned char >(y);
+      unsigned char *e = c->entries.data + (size_t) y * yuv.cols;
+
+      if (fg)
+        background_diff_row (p, n, e, plane, yuv.cols,
+            fg->ptr < unsigned char >(y), minMod, maxMod);
+      else
+        update_codebook_row (p, n, e, plane, yuv.cols, CODEBOOK_CAPACITY,
+            bounds);
+    }
+  }
+
+private:
+  const Mat & yuv;
+  codeBooks *c;
+  const unsigned *bounds, *minMod, *maxMod;
+  Mat *fg;
+};
+
+static void
+init_codebook (codeBooks * c, int width, int height)
+{
+  c->entries.create (CODEBOOK_CAPACITY * CB_N_PLANES, width * height,
+      CV_8UC1);
+  c->num_entries = Mat::zeros (height, width, CV_8UC1);
+}
+
+/*
+  void update_codebook(Mat yuv, codeBooks *c, unsigned *cbBounds)
+  Updates the codebooks with a new frame
+
+  yuv A YUV or HSI image
+  c Codebooks of every pixel of the image
+  cbBounds Learning bounds for codebook (Rule of thumb: 10)
+
+  NOTES:
+  cvBounds must be of length CHANNELS
+*/
+static void
+update_codebook (const Mat & yuv, codeBooks * c, const unsigned *cbBounds)
+{
+  parallel_for_ (Range (0, yuv.rows), CodebookInvoker (yuv, c, cbBounds,
+          NULL, NULL, NULL), (double) yuv.rows / CODEBOOK_TILE_ROWS);
+}
+
+/*
+  void background_diff(Mat yuv, codeBooks *c, Mat fg, unsigned *minMod,
+  unsigned *maxMod)
+  Writes the foreground mask of a frame, 255 where the codebook of the
+  pixel does not cover it, 0 elsewhere
+
+  NOTES:
+  see background_diff_pixel for minMod and maxMod
+*/
+static void
+background_diff (const Mat & yuv, codeBooks * c, Mat & fg,
+    const unsigned *minMod, const unsigned *maxMod)
+{
+  parallel_for_ (Range (0, yuv.rows), CodebookInvoker (yuv, c, NULL, minMod,
+          maxMod, &fg), (double) yuv.rows / CODEBOOK_TILE_ROWS);
 }
 
 
@@ -67,23 +67,26 @@ typedef struct _GstSegmentation GstSegmentation;
 typedef struct _GstSegmentationClass GstSegmentationClass;
 
 #define CHANNELS 3
-typedef struct ce
-{
-  unsigned char learnHigh[CHANNELS];    /* High side threshold for learning */
-  unsigned char learnLow[CHANNELS];     /* Low side threshold for learning */
-  unsigned char max[CHANNELS];  /* High side of box boundary */
-  unsigned char min[CHANNELS];  /* Low side of box boundary */
-  int t_last_update;            /* Allow us to kill stale entries */
-  int stale;                    /* max negative run (longest period of inactivity) */
-} code_element;
 
+/* Fields of a codeword, each with one plane per channel */
+enum
+{
+  CB_LEARN_HIGH = 0,            /* High side threshold for learning */
+  CB_LEARN_LOW = CHANNELS,      /* Low side threshold for learning */
+  CB_MAX = 2 * CHANNELS,        /* High side of box boundary */
+  CB_MIN = 3 * CHANNELS,        /* Low side of box boundary */
+  CB_N_PLANES = 4 * CHANNELS
+};
 
-typedef struct code_book
+/* The codebooks of all pixels, as a structure of arrays: plane f of
+ * codeword k of every pixel is row k * CB_N_PLANES + f of entries, so
+ * consecutive pixels are next to each other for SIMD.  Every pixel has
+ * room for a fixed number of codewords, of which num_entries are in use. */
+typedef struct code_books
 {
-  code_element **cb;
-  int numEntries;
-  int t;                        /*count every access */
-} codeBook;
+  cv::Mat entries;
+  cv::Mat num_entries;
+} codeBooks;
 
 struct _GstSegmentation
 {
@@ -101,7 +104,7 @@ struct _GstSegmentation
   int framecount;
 
   /* for codebook approach */
-  codeBook *TcodeBook;
+  codeBooks codebook;
   int learning_interval;
   
   /* for MOG methods */
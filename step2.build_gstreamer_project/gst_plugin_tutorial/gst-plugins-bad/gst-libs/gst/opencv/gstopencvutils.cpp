@@ -150,6 +150,49 @@ gst_opencv_cv_image_type_from_video_format (GstVideoFormat format,
   return TRUE;
 }
 
+/* The cv::Mat layout of one plane of a video format: a plane holds pixels
+ * of 8 or 16 bit channels, as many as fit in its pixel stride.  This
+ * covers the packed formats above as well as the planes of planar and
+ * semi-planar YUV, e.g. NV12 is a CV_8UC1 luma plane followed by a
+ * CV_8UC2 chroma plane of half the width and height. */
+gboolean gst_opencv_cv_mat_params_from_video_plane
+    (GstVideoInfo * info, guint plane, gint * width, gint * height,
+    int *cv_type, GError ** err)
+{
+  const GstVideoFormatInfo *finfo = info->finfo;
+  gint comp, depth, bytes, pstride;
+
+  for (comp = 0; comp < (gint) GST_VIDEO_INFO_N_COMPONENTS (info); comp++)
+    if (GST_VIDEO_FORMAT_INFO_PLANE (finfo, comp) == plane)
+      break;
+
+  if (plane >= GST_VIDEO_INFO_N_PLANES (info)
+      || comp == (gint) GST_VIDEO_INFO_N_COMPONENTS (info)) {
+    g_set_error (err, GST_CORE_ERROR, GST_CORE_ERROR_NEGOTIATION,
+        "No plane %u in video format %s", plane,
+        GST_VIDEO_INFO_NAME (info));
+    return FALSE;
+  }
+
+  depth = GST_VIDEO_FORMAT_INFO_DEPTH (finfo, comp);
+  bytes = depth == 16 ? 2 : 1;
+  pstride = GST_VIDEO_FORMAT_INFO_PSTRIDE (finfo, comp);
+
+  if ((depth != 8 && depth != 16) || pstride <= 0 || pstride % bytes
+      || pstride / bytes > 4 || GST_VIDEO_FORMAT_INFO_IS_COMPLEX (finfo)
+      || GST_VIDEO_FORMAT_INFO_IS_TILED (finfo)) {
+    g_set_error (err, GST_CORE_ERROR, GST_CORE_ERROR_NEGOTIATION,
+        "Unsupported video format %s", GST_VIDEO_INFO_NAME (info));
+    return FALSE;
+  }
+
+  *width = GST_VIDEO_INFO_COMP_WIDTH (info, comp);
+  *height = GST_VIDEO_INFO_COMP_HEIGHT (info, comp);
+  *cv_type = CV_MAKETYPE (bytes == 2 ? CV_16U : CV_8U, pstride / bytes);
+
+  return TRUE;
+}
+
 GstCaps *
 gst_opencv_caps_from_cv_image_type (int cv_type)
 {
@@ -44,6 +44,24 @@
 
 /* TODO opencv can do scaling for some cases */
 
+/*
+ * Every frame is handed to the subclass as cv::Mat headers on the mapped
+ * video frame, with the stride and plane offsets of the frame itself, so
+ * buffers with padded rows, like those of hardware and DMA pools, are
+ * processed in place without a copy.  Subclasses implementing the planes
+ * functions get one cv::Mat per plane and may take planar YUV such as
+ * NV12 and I420; cv_set_caps then describes the first plane.
+ *
+ * Subclasses that set the stateless class flag may be run on several
+ * frames at once with the max-parallel-frames property.  Frames are then
+ * handed to a pool of worker threads as they arrive, and pushed in the
+ * order they arrived as soon as the oldest is done, so the element delays
+ * its output by up to max-parallel-frames frames.  Each frame in flight
+ * has its own set of scratch cv::Mat, reached through
+ * gst_opencv_video_filter_scratch(), which are kept from one frame to the
+ * next and so only allocated once.
+ */
+
 #ifdef HAVE_CONFIG_H
 #  include <config.h>
 #endif
@@ -64,9 +82,46 @@ enum
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_MAX_PARALLEL_FRAMES
+};
+
+#define DEFAULT_MAX_PARALLEL_FRAMES 1
+
+/* A frame in flight in the worker pool.  Jobs live in a ring, in the
+ * order the frames arrived; outbuf is NULL for frames passed through. */
+typedef struct
+{
+  GstBuffer *inbuf;
+  GstBuffer *outbuf;
+  GstFlowReturn ret;
+  gboolean done;
+
+  cv::Mat scratch[GST_OPENCV_VIDEO_FILTER_N_SCRATCH];
+} GstOpencvVideoFilterJob;
+
+struct _GstOpencvVideoFilterPrivate
+{
+  /* protected by the object lock */
+  guint max_parallel_frames;
+
+  /* the worker pool, only present between start and stop when running
+   * frames in parallel */
+  GThreadPool *pool;
+  GMutex lock;
+  GCond cond;
+  GstOpencvVideoFilterJob *jobs;
+  guint n_jobs;
+  guint head;
+  guint count;
+
+  /* scratch of the streaming thread, when running frames one by one */
+  cv::Mat scratch[GST_OPENCV_VIDEO_FILTER_N_SCRATCH];
 };
 
+/* scratch of the job run by the current worker thread */
+static GPrivate worker_scratch;
+
 #define parent_class gst_opencv_video_filter_parent_class
 G_DEFINE_ABSTRACT_TYPE (GstOpencvVideoFilter, gst_opencv_video_filter,
     GST_TYPE_VIDEO_FILTER);
@@ -85,6 +140,17 @@ static gboolean gst_opencv_video_filter_set_info (GstVideoFilter * trans,
     GstCaps * incaps, GstVideoInfo * in_info, GstCaps * outcaps,
     GstVideoInfo * out_info);
 
+static gboolean gst_opencv_video_filter_start (GstBaseTransform * trans);
+static gboolean gst_opencv_video_filter_stop (GstBaseTransform * trans);
+static gboolean gst_opencv_video_filter_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_opencv_video_filter_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query);
+static GstFlowReturn gst_opencv_video_filter_submit_input_buffer
+    (GstBaseTransform * trans, gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_opencv_video_filter_generate_output
+    (GstBaseTransform * trans, GstBuffer ** outbuf);
+
 /* Clean up */
 static void
 gst_opencv_video_filter_finalize (GObject * obj)
@@ -94,6 +160,10 @@ gst_opencv_video_filter_finalize (GObject * obj)
   transform->cvImage.release ();
   transform->out_cvImage.release ();
 
+  g_mutex_clear (&transform->priv->lock);
+  g_cond_clear (&transform->priv->cond);
+  delete transform->priv;
+
   G_OBJECT_CLASS (parent_class)->finalize (obj);
 }
 
@@ -101,9 +171,11 @@ static void
 gst_opencv_video_filter_class_init (GstOpencvVideoFilterClass * klass)
 {
   GObjectClass *gobject_class;
+  GstBaseTransformClass *trans_class;
   GstVideoFilterClass *vfilter_class;
 
   gobject_class = (GObjectClass *) klass;
+  trans_class = (GstBaseTransformClass *) klass;
   vfilter_class = (GstVideoFilterClass *) klass;
 
   GST_DEBUG_CATEGORY_INIT (gst_opencv_video_filter_debug,
@@ -114,6 +186,25 @@ gst_opencv_video_filter_class_init (GstOpencvVideoFilterClass * klass)
   gobject_class->set_property = gst_opencv_video_filter_set_property;
   gobject_class->get_property = gst_opencv_video_filter_get_property;
 
+  g_object_class_install_property (gobject_class, PROP_MAX_PARALLEL_FRAMES,
+      g_param_spec_uint ("max-parallel-frames", "Max parallel frames",
+          "Number of frames processed at once on worker threads, for "
+          "elements that keep no state between frames; 1 processes every "
+          "frame on the streaming thread", 1, 16,
+          DEFAULT_MAX_PARALLEL_FRAMES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  trans_class->start = GST_DEBUG_FUNCPTR (gst_opencv_video_filter_start);
+  trans_class->stop = GST_DEBUG_FUNCPTR (gst_opencv_video_filter_stop);
+  trans_class->sink_event =
+      GST_DEBUG_FUNCPTR (gst_opencv_video_filter_sink_event);
+  trans_class->query = GST_DEBUG_FUNCPTR (gst_opencv_video_filter_query);
+  trans_class->submit_input_buffer =
+      GST_DEBUG_FUNCPTR (gst_opencv_video_filter_submit_input_buffer);
+  trans_class->generate_output =
+      GST_DEBUG_FUNCPTR (gst_opencv_video_filter_generate_output);
+
   vfilter_class->transform_frame = gst_opencv_video_filter_transform_frame;
   vfilter_class->transform_frame_ip =
       gst_opencv_video_filter_transform_frame_ip;
@@ -123,6 +214,30 @@ gst_opencv_video_filter_class_init (GstOpencvVideoFilterClass * klass)
 static void
 gst_opencv_video_filter_init (GstOpencvVideoFilter * transform)
 {
+  transform->priv = new GstOpencvVideoFilterPrivate ();
+  transform->priv->max_parallel_frames = DEFAULT_MAX_PARALLEL_FRAMES;
+  g_mutex_init (&transform->priv->lock);
+  g_cond_init (&transform->priv->cond);
+}
+
+/* Wrap the planes of a mapped frame in cv::Mat headers, without copying.
+ * The format was checked in set_info. */
+static guint
+gst_opencv_video_filter_wrap_frame (GstVideoFrame * frame, cv::Mat * planes)
+{
+  guint n_planes = GST_VIDEO_FRAME_N_PLANES (frame);
+  gint width, height;
+  int cv_type;
+
+  for (guint i = 0; i < n_planes; i++) {
+    gst_opencv_cv_mat_params_from_video_plane (&frame->info, i, &width,
+        &height, &cv_type, NULL);
+    planes[i] = cv::Mat (height, width, cv_type,
+        GST_VIDEO_FRAME_PLANE_DATA (frame, i),
+        GST_VIDEO_FRAME_PLANE_STRIDE (frame, i));
+  }
+
+  return n_planes;
 }
 
 static GstFlowReturn
@@ -131,17 +246,26 @@ gst_opencv_video_filter_transform_frame (GstVideoFilter * trans,
 {
   GstOpencvVideoFilter *transform;
   GstOpencvVideoFilterClass *fclass;
+  cv::Mat planes[GST_VIDEO_MAX_PLANES];
+  cv::Mat outplanes[GST_VIDEO_MAX_PLANES];
+  guint n_planes, n_outplanes;
   GstFlowReturn ret;
 
   transform = GST_OPENCV_VIDEO_FILTER (trans);
   fclass = GST_OPENCV_VIDEO_FILTER_GET_CLASS (transform);
 
-  g_return_val_if_fail (fclass->cv_trans_func != NULL, GST_FLOW_ERROR);
+  g_return_val_if_fail (fclass->cv_trans_func != NULL
+      || fclass->cv_trans_planes_func != NULL, GST_FLOW_ERROR);
+
+  n_planes = gst_opencv_video_filter_wrap_frame (inframe, planes);
+  n_outplanes = gst_opencv_video_filter_wrap_frame (outframe, outplanes);
+
+  if (fclass->cv_trans_planes_func)
+    return fclass->cv_trans_planes_func (transform, inframe->buffer, planes,
+        n_planes, outframe->buffer, outplanes, n_outplanes);
 
-  transform->cvImage.data = (unsigned char *) inframe->data[0];
-  transform->cvImage.datastart = (unsigned char *) inframe->data[0];
-  transform->out_cvImage.data = (unsigned char *) outframe->data[0];
-  transform->out_cvImage.datastart = (unsigned char *) outframe->data[0];
+  transform->cvImage = planes[0];
+  transform->out_cvImage = outplanes[0];
   ret = fclass->cv_trans_func (transform, inframe->buffer, transform->cvImage,
       outframe->buffer, transform->out_cvImage);
 
@@ -154,21 +278,387 @@ gst_opencv_video_filter_transform_frame_ip (GstVideoFilter * trans,
 {
   GstOpencvVideoFilter *transform;
   GstOpencvVideoFilterClass *fclass;
+  cv::Mat planes[GST_VIDEO_MAX_PLANES];
+  guint n_planes;
   GstFlowReturn ret;
 
   transform = GST_OPENCV_VIDEO_FILTER (trans);
   fclass = GST_OPENCV_VIDEO_FILTER_GET_CLASS (transform);
 
-  g_return_val_if_fail (fclass->cv_trans_ip_func != NULL, GST_FLOW_ERROR);
+  g_return_val_if_fail (fclass->cv_trans_ip_func != NULL
+      || fclass->cv_trans_planes_ip_func != NULL, GST_FLOW_ERROR);
 
-  transform->cvImage.data = (unsigned char *) frame->data[0];
-  transform->cvImage.datastart = (unsigned char *) frame->data[0];
+  n_planes = gst_opencv_video_filter_wrap_frame (frame, planes);
 
+  if (fclass->cv_trans_planes_ip_func)
+    return fclass->cv_trans_planes_ip_func (transform, frame->buffer, planes,
+        n_planes);
+
+  transform->cvImage = planes[0];
   ret = fclass->cv_trans_ip_func (transform, frame->buffer, transform->cvImage);
 
   return ret;
 }
 
+/* Run the subclass on one frame, on a worker thread.  Unlike the
+ * transform_frame functions above, this leaves cvImage and out_cvImage
+ * alone, as other workers run at the same time. */
+static GstFlowReturn
+gst_opencv_video_filter_process (GstOpencvVideoFilter * transform,
+    GstBuffer * inbuf, GstBuffer * outbuf)
+{
+  GstVideoFilter *vfilter = GST_VIDEO_FILTER (transform);
+  GstOpencvVideoFilterClass *fclass =
+      GST_OPENCV_VIDEO_FILTER_GET_CLASS (transform);
+  GstVideoFrame inframe, outframe;
+  cv::Mat planes[GST_VIDEO_MAX_PLANES];
+  cv::Mat outplanes[GST_VIDEO_MAX_PLANES];
+  guint n_planes, n_outplanes;
+  GstFlowReturn ret;
+
+  if (inbuf == outbuf) {
+    if (!gst_video_frame_map (&inframe, &vfilter->in_info, inbuf,
+            GST_MAP_READWRITE))
+      goto map_failed;
+
+    n_planes = gst_opencv_video_filter_wrap_frame (&inframe, planes);
+    if (fclass->cv_trans_planes_ip_func)
+      ret = fclass->cv_trans_planes_ip_func (transform, inbuf, planes,
+          n_planes);
+    else
+      ret = fclass->cv_trans_ip_func (transform, inbuf, planes[0]);
+
+    gst_video_frame_unmap (&inframe);
+    return ret;
+  }
+
+  if (!gst_video_frame_map (&inframe, &vfilter->in_info, inbuf, GST_MAP_READ))
+    goto map_failed;
+  if (!gst_video_frame_map (&outframe, &vfilter->out_info, outbuf,
+          GST_MAP_WRITE)) {
+    gst_video_frame_unmap (&inframe);
+    goto map_failed;
+  }
+
+  n_planes = gst_opencv_video_filter_wrap_frame (&inframe, planes);
+  n_outplanes = gst_opencv_video_filter_wrap_frame (&outframe, outplanes);
+  if (fclass->cv_trans_planes_func)
+    ret = fclass->cv_trans_planes_func (transform, inbuf, planes, n_planes,
+        outbuf, outplanes, n_outplanes);
+  else
+    ret = fclass->cv_trans_func (transform, inbuf, planes[0], outbuf,
+        outplanes[0]);
+
+  gst_video_frame_unmap (&outframe);
+  gst_video_frame_unmap (&inframe);
+  return ret;
+
+map_failed:
+  GST_ELEMENT_ERROR (transform, CORE, NOT_IMPLEMENTED, (NULL),
+      ("Failed to map buffer"));
+  return GST_FLOW_ERROR;
+}
+
+static void
+gst_opencv_video_filter_worker (gpointer data, gpointer user_data)
+{
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (user_data);
+  GstOpencvVideoFilterPrivate *priv = transform->priv;
+  GstOpencvVideoFilterJob *job = (GstOpencvVideoFilterJob *) data;
+  GstFlowReturn ret;
+
+  g_private_set (&worker_scratch, job->scratch);
+  ret = gst_opencv_video_filter_process (transform, job->inbuf, job->outbuf);
+  g_private_set (&worker_scratch, NULL);
+
+  g_mutex_lock (&priv->lock);
+  job->ret = ret;
+  job->done = TRUE;
+  g_cond_broadcast (&priv->cond);
+  g_mutex_unlock (&priv->lock);
+}
+
+/* Take the oldest job off the ring, waiting for it to be done if @wait,
+ * and return its buffer to push, if any.  Returns FALSE when there is no
+ * such job. */
+static gboolean
+gst_opencv_video_filter_pop_job (GstOpencvVideoFilter * transform,
+    gboolean wait, GstBuffer ** outbuf, GstFlowReturn * ret)
+{
+  GstOpencvVideoFilterPrivate *priv = transform->priv;
+  GstOpencvVideoFilterJob *job;
+  GstBuffer *buf;
+
+  g_mutex_lock (&priv->lock);
+  while (wait && priv->count > 0 && !priv->jobs[priv->head].done)
+    g_cond_wait (&priv->cond, &priv->lock);
+
+  if (priv->count == 0 || !priv->jobs[priv->head].done) {
+    g_mutex_unlock (&priv->lock);
+    return FALSE;
+  }
+
+  job = &priv->jobs[priv->head];
+  priv->head = (priv->head + 1) % priv->n_jobs;
+  priv->count--;
+  g_mutex_unlock (&priv->lock);
+
+  /* the job slot is not reused before the next submit, on this thread */
+  buf = job->outbuf ? job->outbuf : job->inbuf;
+  if (job->outbuf && job->outbuf != job->inbuf)
+    gst_buffer_unref (job->inbuf);
+  job->inbuf = job->outbuf = NULL;
+
+  *ret = job->ret;
+  if (*ret != GST_FLOW_OK) {
+    gst_buffer_unref (buf);
+    buf = NULL;
+    if (*ret == GST_BASE_TRANSFORM_FLOW_DROPPED)
+      *ret = GST_FLOW_OK;
+  }
+
+  *outbuf = buf;
+  return TRUE;
+}
+
+/* Wait for every frame in flight, pushing them if @push, before a
+ * serialized event or a flush */
+static void
+gst_opencv_video_filter_drain (GstOpencvVideoFilter * transform,
+    gboolean push)
+{
+  GstBuffer *outbuf;
+  GstFlowReturn ret;
+
+  while (gst_opencv_video_filter_pop_job (transform, TRUE, &outbuf, &ret)) {
+    if (outbuf == NULL)
+      continue;
+
+    if (push)
+      gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (transform), outbuf);
+    else
+      gst_buffer_unref (outbuf);
+  }
+}
+
+static gboolean
+gst_opencv_video_filter_start (GstBaseTransform * trans)
+{
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (trans);
+  GstOpencvVideoFilterClass *klass =
+      GST_OPENCV_VIDEO_FILTER_GET_CLASS (transform);
+  GstOpencvVideoFilterPrivate *priv = transform->priv;
+  guint max_parallel_frames;
+  GError *err = NULL;
+
+  GST_OBJECT_LOCK (transform);
+  max_parallel_frames = priv->max_parallel_frames;
+  GST_OBJECT_UNLOCK (transform);
+
+  if (max_parallel_frames <= 1)
+    return TRUE;
+
+  if (!klass->stateless) {
+    GST_WARNING_OBJECT (transform, "%s keeps state between frames, "
+        "processing them one by one", G_OBJECT_TYPE_NAME (transform));
+    return TRUE;
+  }
+
+  priv->pool = g_thread_pool_new (gst_opencv_video_filter_worker, transform,
+      max_parallel_frames, TRUE, &err);
+  if (priv->pool == NULL) {
+    GST_ELEMENT_ERROR (transform, RESOURCE, FAILED, (NULL),
+        ("Failed to start worker threads: %s", err->message));
+    g_error_free (err);
+    return FALSE;
+  }
+
+  /* one more job than workers, for the frame just submitted while the
+   * workers are all busy */
+  priv->n_jobs = max_parallel_frames + 1;
+  priv->jobs = new GstOpencvVideoFilterJob[priv->n_jobs] ();
+  priv->head = 0;
+  priv->count = 0;
+
+  GST_DEBUG_OBJECT (transform, "processing up to %u frames in parallel",
+      max_parallel_frames);
+
+  return TRUE;
+}
+
+static gboolean
+gst_opencv_video_filter_stop (GstBaseTransform * trans)
+{
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (trans);
+  GstOpencvVideoFilterPrivate *priv = transform->priv;
+
+  if (priv->pool == NULL)
+    return TRUE;
+
+  gst_opencv_video_filter_drain (transform, FALSE);
+  g_thread_pool_free (priv->pool, FALSE, TRUE);
+  priv->pool = NULL;
+
+  delete[]priv->jobs;
+  priv->jobs = NULL;
+  priv->n_jobs = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_opencv_video_filter_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (trans);
+
+  if (transform->priv->pool != NULL) {
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      gst_opencv_video_filter_drain (transform, FALSE);
+    else if (GST_EVENT_IS_SERIALIZED (event))
+      gst_opencv_video_filter_drain (transform, TRUE);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (parent_class)->sink_event (trans, event);
+}
+
+/* Frames wait for the ones before them, adding up to max-parallel-frames
+ * frames of latency */
+static gboolean
+gst_opencv_video_filter_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query)
+{
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (trans);
+  GstVideoInfo *info = &GST_VIDEO_FILTER (trans)->in_info;
+  GstClockTime min, max, latency;
+  gboolean live;
+
+  if (!GST_BASE_TRANSFORM_CLASS (parent_class)->query (trans, direction,
+          query))
+    return FALSE;
+
+  if (direction != GST_PAD_SRC || GST_QUERY_TYPE (query) != GST_QUERY_LATENCY
+      || transform->priv->pool == NULL || GST_VIDEO_INFO_FPS_N (info) <= 0)
+    return TRUE;
+
+  latency = gst_util_uint64_scale_int ((transform->priv->n_jobs - 1) *
+      GST_SECOND, GST_VIDEO_INFO_FPS_D (info), GST_VIDEO_INFO_FPS_N (info));
+
+  gst_query_parse_latency (query, &live, &min, &max);
+  min += latency;
+  if (GST_CLOCK_TIME_IS_VALID (max))
+    max += latency;
+  gst_query_set_latency (query, live, min, max);
+
+  return TRUE;
+}
+
+static GstFlowReturn
+gst_opencv_video_filter_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input)
+{
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (trans);
+  GstOpencvVideoFilterPrivate *priv = transform->priv;
+  GstOpencvVideoFilterJob *job;
+  GstBuffer *inbuf, *outbuf = NULL;
+  GstFlowReturn ret;
+
+  /* the default keeps QoS handling, and queues the buffer for
+   * generate_output */
+  ret = GST_BASE_TRANSFORM_CLASS (parent_class)->submit_input_buffer (trans,
+      is_discont, input);
+  if (ret != GST_FLOW_OK || priv->pool == NULL)
+    return ret;
+
+  inbuf = trans->queued_buf;
+  trans->queued_buf = NULL;
+  if (inbuf == NULL)
+    return GST_FLOW_OK;
+
+  if (!gst_base_transform_is_passthrough (trans)) {
+    if (!GST_VIDEO_FILTER (trans)->negotiated) {
+      gst_buffer_unref (inbuf);
+      GST_ELEMENT_ERROR (transform, CORE, NOT_IMPLEMENTED, (NULL),
+          ("unknown format"));
+      return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    /* the input itself, made writable, for in-place transforms */
+    ret = GST_BASE_TRANSFORM_GET_CLASS (trans)->prepare_output_buffer (trans,
+        inbuf, &outbuf);
+    if (ret != GST_FLOW_OK) {
+      gst_buffer_unref (inbuf);
+      return ret;
+    }
+    if (outbuf != inbuf && gst_base_transform_is_in_place (trans)) {
+      gst_buffer_unref (inbuf);
+      inbuf = outbuf;
+    }
+  }
+
+  g_mutex_lock (&priv->lock);
+  job = &priv->jobs[(priv->head + priv->count) % priv->n_jobs];
+  job->inbuf = inbuf;
+  job->outbuf = outbuf;
+  job->ret = GST_FLOW_OK;
+  job->done = outbuf == NULL;
+  priv->count++;
+  g_mutex_unlock (&priv->lock);
+
+  if (outbuf != NULL)
+    g_thread_pool_push (priv->pool, job, NULL);
+
+  return GST_FLOW_OK;
+}
+
+static GstFlowReturn
+gst_opencv_video_filter_generate_output (GstBaseTransform * trans,
+    GstBuffer ** outbuf)
+{
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (trans);
+  GstOpencvVideoFilterPrivate *priv = transform->priv;
+  GstFlowReturn ret = GST_FLOW_OK;
+  gboolean full;
+
+  if (priv->pool == NULL)
+    return GST_BASE_TRANSFORM_CLASS (parent_class)->generate_output (trans,
+        outbuf);
+
+  /* wait for the oldest frame only when every worker is busy, otherwise
+   * take whatever is done and come back with the next buffer */
+  g_mutex_lock (&priv->lock);
+  full = priv->count >= priv->n_jobs;
+  g_mutex_unlock (&priv->lock);
+
+  *outbuf = NULL;
+  while (gst_opencv_video_filter_pop_job (transform, full, outbuf, &ret)) {
+    if (*outbuf != NULL || ret != GST_FLOW_OK)
+      break;
+    full = FALSE;
+  }
+
+  return ret;
+}
+
+/* The cv::Mat the subclass gets for a format.  A single cv::Mat takes only
+ * packed formats; with the planes functions, any format whose planes are
+ * all cv::Mat layouts goes, and the first plane is described. */
+static gboolean
+gst_opencv_video_filter_mat_params (GstVideoInfo * info, gboolean planes,
+    gint * width, gint * height, int *cv_type, GError ** err)
+{
+  if (!planes)
+    return gst_opencv_cv_mat_params_from_video_info (info, width, height,
+        cv_type, err);
+
+  /* last plane first, leaving the first plane described */
+  for (guint i = GST_VIDEO_INFO_N_PLANES (info); i-- > 0;)
+    if (!gst_opencv_cv_mat_params_from_video_plane (info, i, width, height,
+            cv_type, err))
+      return FALSE;
+
+  return TRUE;
+}
+
 static gboolean
 gst_opencv_video_filter_set_info (GstVideoFilter * trans, GstCaps * incaps,
     GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info)
@@ -182,8 +672,10 @@ gst_opencv_video_filter_set_info (GstVideoFilter * trans, GstCaps * incaps,
   int out_cv_type;
   GError *in_err = NULL;
   GError *out_err = NULL;
+  gboolean planes = klass->cv_trans_planes_func
+      || klass->cv_trans_planes_ip_func;
 
-  if (!gst_opencv_cv_mat_params_from_video_info (in_info, &in_width,
+  if (!gst_opencv_video_filter_mat_params (in_info, planes, &in_width,
           &in_height, &in_cv_type, &in_err)) {
     GST_WARNING_OBJECT (transform, "Failed to parse input caps: %s",
         in_err->message);
@@ -191,7 +683,7 @@ gst_opencv_video_filter_set_info (GstVideoFilter * trans, GstCaps * incaps,
     return FALSE;
   }
 
-  if (!gst_opencv_cv_mat_params_from_video_info (out_info, &out_width,
+  if (!gst_opencv_video_filter_mat_params (out_info, planes, &out_width,
           &out_height, &out_cv_type, &out_err)) {
     GST_WARNING_OBJECT (transform, "Failed to parse output caps: %s",
         out_err->message);
@@ -205,9 +697,6 @@ gst_opencv_video_filter_set_info (GstVideoFilter * trans, GstCaps * incaps,
       return FALSE;
   }
 
-  transform->cvImage.create (cv::Size (in_width, in_height), in_cv_type);
-  transform->out_cvImage.create (cv::Size (out_width, out_height), out_cv_type);
-
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (transform),
       transform->in_place);
   return TRUE;
@@ -217,7 +706,14 @@ static void
 gst_opencv_video_filter_set_property (GObject * object, guint prop_id,
     const GValue * value, GParamSpec * pspec)
 {
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (object);
+
   switch (prop_id) {
+    case PROP_MAX_PARALLEL_FRAMES:
+      GST_OBJECT_LOCK (transform);
+      transform->priv->max_parallel_frames = g_value_get_uint (value);
+      GST_OBJECT_UNLOCK (transform);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -228,7 +724,14 @@ static void
 gst_opencv_video_filter_get_property (GObject * object, guint prop_id,
     GValue * value, GParamSpec * pspec)
 {
+  GstOpencvVideoFilter *transform = GST_OPENCV_VIDEO_FILTER (object);
+
   switch (prop_id) {
+    case PROP_MAX_PARALLEL_FRAMES:
+      GST_OBJECT_LOCK (transform);
+      g_value_set_uint (value, transform->priv->max_parallel_frames);
+      GST_OBJECT_UNLOCK (transform);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
       break;
@@ -242,3 +745,29 @@ gst_opencv_video_filter_set_in_place (GstOpencvVideoFilter * transform,
   transform->in_place = ip;
   gst_base_transform_set_in_place (GST_BASE_TRANSFORM (transform), ip);
 }
+
+/**
+ * gst_opencv_video_filter_scratch:
+ * @transform: the #GstOpencvVideoFilter
+ * @index: which scratch, below %GST_OPENCV_VIDEO_FILTER_N_SCRATCH
+ *
+ * Returns a cv::Mat for temporary results of the transform being run,
+ * private to the frame being processed and kept from one frame to the
+ * next, so that create() only allocates it once.  Only valid from within
+ * the transform functions.
+ *
+ * Returns: the scratch cv::Mat
+ */
+cv::Mat *
+gst_opencv_video_filter_scratch (GstOpencvVideoFilter * transform,
+    guint index)
+{
+  cv::Mat *scratch = (cv::Mat *) g_private_get (&worker_scratch);
+
+  g_return_val_if_fail (index < GST_OPENCV_VIDEO_FILTER_N_SCRATCH, NULL);
+
+  if (scratch == NULL)
+    scratch = transform->priv->scratch;
+
+  return &scratch[index];
+}
@@ -72,6 +72,10 @@ G_BEGIN_DECLS
 
 typedef struct _GstOpencvVideoFilter GstOpencvVideoFilter;
 typedef struct _GstOpencvVideoFilterClass GstOpencvVideoFilterClass;
+typedef struct _GstOpencvVideoFilterPrivate GstOpencvVideoFilterPrivate;
+
+/* Number of scratch cv::Mat returned by gst_opencv_video_filter_scratch() */
+#define GST_OPENCV_VIDEO_FILTER_N_SCRATCH 4
 
 typedef GstFlowReturn (*GstOpencvVideoFilterTransformIPFunc)
     (GstOpencvVideoFilter * transform, GstBuffer * buffer, cv::Mat img);
@@ -79,6 +83,16 @@ typedef GstFlowReturn (*GstOpencvVideoFilterTransformFunc)
     (GstOpencvVideoFilter * transform, GstBuffer * buffer, cv::Mat img,
     GstBuffer * outbuf, cv::Mat outimg);
 
+/* Transforms that take one cv::Mat per plane, e.g. the luma and chroma
+ * planes of NV12 or I420, which a single cv::Mat cannot describe */
+typedef GstFlowReturn (*GstOpencvVideoFilterTransformPlanesIPFunc)
+    (GstOpencvVideoFilter * transform, GstBuffer * buffer, cv::Mat * planes,
+    guint n_planes);
+typedef GstFlowReturn (*GstOpencvVideoFilterTransformPlanesFunc)
+    (GstOpencvVideoFilter * transform, GstBuffer * buffer, cv::Mat * planes,
+    guint n_planes, GstBuffer * outbuf, cv::Mat * outplanes,
+    guint n_outplanes);
+
 typedef gboolean (*GstOpencvVideoFilterSetCaps)
     (GstOpencvVideoFilter * transform, gint in_width, gint in_height,
     int in_cv_type, gint out_width, gint out_height,
@@ -92,6 +106,8 @@ struct _GstOpencvVideoFilter
 
   cv::Mat cvImage;
   cv::Mat out_cvImage;
+
+  GstOpencvVideoFilterPrivate *priv;
 };
 
 struct _GstOpencvVideoFilterClass
@@ -102,6 +118,15 @@ struct _GstOpencvVideoFilterClass
   GstOpencvVideoFilterTransformIPFunc cv_trans_ip_func;
 
   GstOpencvVideoFilterSetCaps cv_set_caps;
+
+  /* When set, used instead of cv_trans_func and cv_trans_ip_func */
+  GstOpencvVideoFilterTransformPlanesFunc cv_trans_planes_func;
+  GstOpencvVideoFilterTransformPlanesIPFunc cv_trans_planes_ip_func;
+
+  /* Set by subclasses whose transform keeps no state between frames and
+   * uses gst_opencv_video_filter_scratch() for its temporaries, so that
+   * max-parallel-frames may run it on several frames at once */
+  gboolean stateless;
 };
 
 GST_OPENCV_API
@@ -111,6 +136,10 @@ GST_OPENCV_API
 void gst_opencv_video_filter_set_in_place (GstOpencvVideoFilter * transform,
                                            gboolean ip);
 
+GST_OPENCV_API
+cv::Mat * gst_opencv_video_filter_scratch (GstOpencvVideoFilter * transform,
+                                           guint index);
+
 G_END_DECLS
 
 #endif /* __GST_OPENCV_VIDEO_FILTER_H__ */
@@ -0,0 +1,348 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * BoxSet - detections as arrays, for post-processing four boxes at a time
+ *
+ *  The results come as a vector of box structs.  BoxSet loads them into
+ *  one array per field (corners, area, score, label), so clamping,
+ *  conversion to pixels and non-maximum suppression run as row kernels
+ *  over contiguous floats, on the NEON or SSE path vaikernels picked.
+ *
+ *  nms() sorts by score and suppresses, for each box kept, every later box
+ *  overlapping it by more than the threshold in one pass over the arrays,
+ *  branch free, so the cost grows with the number of candidates but not
+ *  with how they overlap.  Overlap is IoU, or intersection over the
+ *  smaller box for boxes cut by tile edges; class-aware suppression only
+ *  compares boxes of one label.  select() then keeps the surviving boxes
+ *  of the original vector, best first, with all their other fields.
+ *
+ *  Box is any type with normalized x, y, width, height and score members,
+ *  and optionally a label, like the Vitis-AI-Library results.
+ */
+
+#ifndef __BOXSET_HPP__
+#define __BOXSET_HPP__
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <vaikernels.hpp>
+
+enum BoxOverlap
+{
+  BOX_OVERLAP_IOU,              /* intersection over union */
+  BOX_OVERLAP_IOS               /* intersection over the smaller box */
+};
+
+/* Clamp n floats to lo..hi in place */
+static inline void
+ClampRow (float * v, int n, float lo, float hi)
+{
+  int i = 0;
+
+#if defined(VAI_KERNELS_NEON)
+  float32x4_t l = vdupq_n_f32 (lo), h = vdupq_n_f32 (hi);
+
+  for (; i + 4 <= n; i += 4)
+    vst1q_f32 (v + i, vminq_f32 (vmaxq_f32 (vld1q_f32 (v + i), l), h));
+#elif defined(VAI_KERNELS_SSE2)
+  __m128 l = _mm_set1_ps (lo), h = _mm_set1_ps (hi);
+
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_ps (v + i, _mm_min_ps (_mm_max_ps (_mm_loadu_ps (v + i), l), h));
+#endif
+
+  for (; i < n; i++)
+    v[i] = std::min (std::max (v[i], lo), hi);
+}
+
+/* dst = src * scale clamped to 0..hi, truncated to int */
+static inline void
+ScaleRow (const float * src, int n, float scale, float hi, int32_t * dst)
+{
+  int i = 0;
+
+#if defined(VAI_KERNELS_NEON)
+  float32x4_t s = vdupq_n_f32 (scale), l = vdupq_n_f32 (0.0f),
+      h = vdupq_n_f32 (hi);
+
+  for (; i + 4 <= n; i += 4)
+    vst1q_s32 (dst + i, vcvtq_s32_f32 (vminq_f32 (vmaxq_f32 (
+                    vmulq_f32 (vld1q_f32 (src + i), s), l), h)));
+#elif defined(VAI_KERNELS_SSE2)
+  __m128 s = _mm_set1_ps (scale), l = _mm_setzero_ps (), h = _mm_set1_ps (hi);
+
+  for (; i + 4 <= n; i += 4)
+    _mm_storeu_si128 ((__m128i *) (dst + i), _mm_cvttps_epi32 (_mm_min_ps (
+                _mm_max_ps (_mm_mul_ps (_mm_loadu_ps (src + i), s), l), h)));
+#endif
+
+  for (; i < n; i++)
+    dst[i] = (int32_t) std::min (std::max (src[i] * scale, 0.0f), hi);
+}
+
+class BoxSet
+{
+public:
+  template<class Box>
+  void load (const std::vector<Box> & boxes)
+  {
+    size_t n = boxes.size ();
+
+    resize (n);
+    for (size_t i = 0; i < n; i++) {
+      const Box & box = boxes[i];
+
+      x0_[i] = box.x;
+      y0_[i] = box.y;
+      x1_[i] = box.x + box.width;
+      y1_[i] = box.y + box.height;
+      score_[i] = box.score;
+      label_[i] = label (box, 0);
+      index_[i] = i;
+    }
+  }
+
+  size_t size () const { return index_.size (); }
+
+  /* Clamp the corners to the frame */
+  void clamp ()
+  {
+    int n = size ();
+
+    ClampRow (x0_.data (), n, 0.0f, 1.0f);
+    ClampRow (y0_.data (), n, 0.0f, 1.0f);
+    ClampRow (x1_.data (), n, 0.0f, 1.0f);
+    ClampRow (y1_.data (), n, 0.0f, 1.0f);
+  }
+
+  /* Pixel rectangles of the boxes in a cols x rows frame, clamped to it,
+   * in the order of the set */
+  void pixels (int cols, int rows, std::vector<cv::Rect> & rects)
+  {
+    int n = size ();
+
+    rects.clear ();
+    if (n == 0)
+      return;
+
+    px_.resize (4 * n);
+    ScaleRow (x0_.data (), n, cols, cols, px_.data ());
+    ScaleRow (y0_.data (), n, rows, rows, px_.data () + n);
+    ScaleRow (x1_.data (), n, cols, cols, px_.data () + 2 * n);
+    ScaleRow (y1_.data (), n, rows, rows, px_.data () + 3 * n);
+
+    rects.resize (n);
+    for (int i = 0; i < n; i++)
+      rects[i] = cv::Rect (px_[i], px_[n + i],
+          std::max (px_[2 * n + i] - px_[i], 0),
+          std::max (px_[3 * n + i] - px_[n + i], 0));
+  }
+
+  /* Greedy non-maximum suppression, leaves the kept boxes best first */
+  void nms (float threshold, bool class_aware,
+      BoxOverlap mode = BOX_OVERLAP_IOU)
+  {
+    int n = size ();
+    size_t kept = 0;
+
+    sort ();
+
+    area_.resize (n);
+    for (int i = 0; i < n; i++)
+      area_[i] = std::max (x1_[i] - x0_[i], 0.0f) *
+          std::max (y1_[i] - y0_[i], 0.0f);
+    keep_.assign (n, ~0u);
+
+    for (int i = 0; i < n; i++)
+      if (keep_[i])
+        suppress (i, threshold, class_aware, mode);
+
+    for (int i = 0; i < n; i++)
+      if (keep_[i])
+        move (i, kept++);
+    resize (kept);
+  }
+
+  /* Reduce 'boxes', the vector the set was loaded from, to the boxes left
+   * in the set, in its order */
+  template<class Box>
+  void select (std::vector<Box> & boxes) const
+  {
+    std::vector<Box> out;
+
+    out.reserve (size ());
+    for (int i : index_)
+      out.push_back (boxes[i]);
+    boxes.swap (out);
+  }
+
+private:
+  template<class Box>
+  static auto label (const Box & box, int) -> decltype ((int) box.label)
+  {
+    return box.label;
+  }
+
+  template<class Box>
+  static int label (const Box &, long)
+  {
+    return 0;
+  }
+
+  void resize (size_t n)
+  {
+    x0_.resize (n);
+    y0_.resize (n);
+    x1_.resize (n);
+    y1_.resize (n);
+    score_.resize (n);
+    label_.resize (n);
+    index_.resize (n);
+  }
+
+  void move (size_t from, size_t to)
+  {
+    x0_[to] = x0_[from];
+    y0_[to] = y0_[from];
+    x1_[to] = x1_[from];
+    y1_[to] = y1_[from];
+    score_[to] = score_[from];
+    label_[to] = label_[from];
+    index_[to] = index_[from];
+  }
+
+  /* Reorder every array by descending score */
+  void sort ()
+  {
+    std::vector<int> order (size ());
+
+    std::iota (order.begin (), order.end (), 0);
+    std::stable_sort (order.begin (), order.end (), [this] (int a, int b) {
+          return score_[a] > score_[b];
+        });
+
+    gather (x0_, order);
+    gather (y0_, order);
+    gather (x1_, order);
+    gather (y1_, order);
+    gather (score_, order);
+    gather (label_, order);
+    gather (index_, order);
+  }
+
+  template<class T>
+  static void gather (std::vector<T> & v, const std::vector<int> & order)
+  {
+    std::vector<T> out (v.size ());
+
+    for (size_t i = 0; i < order.size (); i++)
+      out[i] = v[order[i]];
+    v.swap (out);
+  }
+
+  /* Clear keep for every box after 'i' that box 'i' suppresses */
+  void suppress (int i, float threshold, bool class_aware, BoxOverlap mode)
+  {
+    int n = size ();
+    int j = i + 1;
+    bool ios = mode == BOX_OVERLAP_IOS;
+
+#if defined(VAI_KERNELS_NEON)
+    float32x4_t ax0 = vdupq_n_f32 (x0_[i]), ay0 = vdupq_n_f32 (y0_[i]);
+    float32x4_t ax1 = vdupq_n_f32 (x1_[i]), ay1 = vdupq_n_f32 (y1_[i]);
+    float32x4_t aarea = vdupq_n_f32 (area_[i]), thr = vdupq_n_f32 (threshold);
+    float32x4_t zero = vdupq_n_f32 (0.0f);
+    int32x4_t alabel = vdupq_n_s32 (label_[i]);
+    uint32x4_t any = vdupq_n_u32 (class_aware ? 0 : ~0u);
+
+    for (; j + 4 <= n; j += 4) {
+      float32x4_t iw = vmaxq_f32 (vsubq_f32 (vminq_f32 (ax1,
+                  vld1q_f32 (&x1_[j])), vmaxq_f32 (ax0, vld1q_f32 (&x0_[j]))),
+          zero);
+      float32x4_t ih = vmaxq_f32 (vsubq_f32 (vminq_f32 (ay1,
+                  vld1q_f32 (&y1_[j])), vmaxq_f32 (ay0, vld1q_f32 (&y0_[j]))),
+          zero);
+      float32x4_t inter = vmulq_f32 (iw, ih);
+      float32x4_t barea = vld1q_f32 (&area_[j]);
+      float32x4_t denom = ios ? vminq_f32 (aarea, barea) :
+          vsubq_f32 (vaddq_f32 (aarea, barea), inter);
+      uint32x4_t hit = vandq_u32 (vcgtq_f32 (inter, vmulq_f32 (thr, denom)),
+          vorrq_u32 (any, vceqq_s32 (alabel, vld1q_s32 (&label_[j]))));
+
+      vst1q_u32 (&keep_[j], vbicq_u32 (vld1q_u32 (&keep_[j]), hit));
+    }
+#elif defined(VAI_KERNELS_SSE2)
+    __m128 ax0 = _mm_set1_ps (x0_[i]), ay0 = _mm_set1_ps (y0_[i]);
+    __m128 ax1 = _mm_set1_ps (x1_[i]), ay1 = _mm_set1_ps (y1_[i]);
+    __m128 aarea = _mm_set1_ps (area_[i]), thr = _mm_set1_ps (threshold);
+    __m128 zero = _mm_setzero_ps ();
+    __m128i alabel = _mm_set1_epi32 (label_[i]);
+    __m128i any = _mm_set1_epi32 (class_aware ? 0 : -1);
+
+    for (; j + 4 <= n; j += 4) {
+      __m128 iw = _mm_max_ps (_mm_sub_ps (_mm_min_ps (ax1,
+                  _mm_loadu_ps (&x1_[j])), _mm_max_ps (ax0,
+                  _mm_loadu_ps (&x0_[j]))), zero);
+      __m128 ih = _mm_max_ps (_mm_sub_ps (_mm_min_ps (ay1,
+                  _mm_loadu_ps (&y1_[j])), _mm_max_ps (ay0,
+                  _mm_loadu_ps (&y0_[j]))), zero);
+      __m128 inter = _mm_mul_ps (iw, ih);
+      __m128 barea = _mm_loadu_ps (&area_[j]);
+      __m128 denom = ios ? _mm_min_ps (aarea, barea) :
+          _mm_sub_ps (_mm_add_ps (aarea, barea), inter);
+      __m128i hit = _mm_and_si128 (_mm_castps_si128 (_mm_cmpgt_ps (inter,
+                  _mm_mul_ps (thr, denom))), _mm_or_si128 (any,
+              _mm_cmpeq_epi32 (alabel,
+                  _mm_loadu_si128 ((const __m128i *) &label_[j]))));
+      __m128i *keep = (__m128i *) &keep_[j];
+
+      _mm_storeu_si128 (keep, _mm_andnot_si128 (hit,
+              _mm_loadu_si128 (keep)));
+    }
+#endif
+
+    for (; j < n; j++) {
+      float iw = std::max (std::min (x1_[i], x1_[j]) -
+          std::max (x0_[i], x0_[j]), 0.0f);
+      float ih = std::max (std::min (y1_[i], y1_[j]) -
+          std::max (y0_[i], y0_[j]), 0.0f);
+      float inter = iw * ih;
+      float denom = ios ? std::min (area_[i], area_[j]) :
+          area_[i] + area_[j] - inter;
+
+      if (inter > threshold * denom && (!class_aware || label_[i] == label_[j]))
+        keep_[j] = 0;
+    }
+  }
+
+  std::vector<float> x0_, y0_, x1_, y1_;        /* normalized corners */
+  std::vector<float> score_;
+  std::vector<int32_t> label_;
+  std::vector<int> index_;      /* position in the loaded vector */
+  std::vector<float> area_;
+  std::vector<uint32_t> keep_;
+  std::vector<int32_t> px_;
+};
+
+#endif /* __BOXSET_HPP__ */
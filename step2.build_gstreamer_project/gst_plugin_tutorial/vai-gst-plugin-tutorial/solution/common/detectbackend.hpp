@@ -0,0 +1,246 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * DetectBackend - model backends behind one detection interface
+ *
+ *  Every backend turns a BGR frame into a list of Detection boxes in
+ *  normalized coordinates, the same layout as the Vitis-AI-Library
+ *  results, so DrawBoxes and AttachBoxes work on them unchanged.
+ *
+ *  VitisBackend adapts any Vitis-AI-Library runner whose result holds a
+ *  vector of boxes; the runners come from the RunnerPool, and a batch of
+ *  frames goes through the runner's own batched run.  Backends are
+ *  created by name through the BackendRegistry, which is how the
+ *  vaidetect model-type property is resolved.
+ */
+
+#ifndef __DETECTBACKEND_HPP__
+#define __DETECTBACKEND_HPP__
+
+#include <algorithm>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#ifndef VAIDETECT_CPU_ONLY
+#include <runnerpool.hpp>
+#endif
+
+struct Detection
+{
+  int label;
+  float score;
+  float x, y, width, height;    /* normalized to the frame size */
+};
+
+class DetectBackend
+{
+public:
+  virtual ~DetectBackend () {}
+
+  virtual std::vector<Detection> run (const cv::Mat & img) = 0;
+
+  /* Backends that can batch override this */
+  virtual std::vector<std::vector<Detection>>
+  run (const std::vector<cv::Mat> & imgs)
+  {
+    std::vector<std::vector<Detection>> results;
+
+    for (auto &img : imgs)
+      results.push_back (run (img));
+    return results;
+  }
+
+  /* Class name of a label, used for drawing and for the meta roi_type */
+  virtual const char *label (int id) const = 0;
+
+  /* Size the model takes its input at, YUV frames are converted at this
+   * size.  Empty when the backend takes any size. */
+  virtual cv::Size input_size () const { return cv::Size (); }
+};
+
+/* Label of a result box; boxes without one, like FaceDetect's, are 0 */
+template<class Box>
+auto DetectionLabel (const Box & box, int) -> decltype ((int) box.label)
+{
+  return box.label;
+}
+
+template<class Box>
+int DetectionLabel (const Box & box, long)
+{
+  return 0;
+}
+
+template<class T>
+std::vector<Detection> ToDetections( const T & results )
+{
+  std::vector<Detection> out;
+
+  for (auto &box : results)
+    out.push_back ({ DetectionLabel (box, 0), (float) box.score,
+        (float) box.x, (float) box.y, (float) box.width,
+        (float) box.height });
+  return out;
+}
+
+#ifndef VAIDETECT_CPU_ONLY
+/* Backend for a Vitis-AI-Library runner.  Boxes picks the box vector out
+ * of the runner's result, e.g. &vitis::ai::SSDResult::bboxes.  The
+ * constructor throws std::runtime_error when the model fails to load. */
+template<class Runner, class Result, class Boxes>
+class VitisBackend : public DetectBackend
+{
+public:
+  VitisBackend (const std::string & model, Boxes Result::*boxes,
+      std::vector<std::string> labels)
+      : model_ (model), boxes_ (boxes), labels_ (std::move (labels))
+  {
+    if (!RunnerPool<Runner>::get ().ref (model_))
+      throw std::runtime_error ("failed to load model " + model_);
+
+    auto runner = RunnerPool<Runner>::get ().acquire (model_);
+    if (!runner) {
+      RunnerPool<Runner>::get ().unref (model_);
+      throw std::runtime_error ("failed to load model " + model_);
+    }
+    input_size_ = cv::Size (runner->getInputWidth (),
+        runner->getInputHeight ());
+  }
+
+  ~VitisBackend ()
+  {
+    RunnerPool<Runner>::get ().unref (model_);
+  }
+
+  std::vector<Detection> run (const cv::Mat & img) override
+  {
+    auto runner = RunnerPool<Runner>::get ().acquire (model_);
+
+    if (!runner)
+      return std::vector<Detection> ();
+    return ToDetections (runner->run (img).*boxes_);
+  }
+
+  /* One runner runs the whole batch, in chunks of the model's batch size,
+   * so frames of several streams share a DPU run */
+  std::vector<std::vector<Detection>>
+  run (const std::vector<cv::Mat> & imgs) override
+  {
+    auto runner = RunnerPool<Runner>::get ().acquire (model_);
+    std::vector<std::vector<Detection>> results;
+    size_t batch;
+
+    if (!runner) {
+      results.resize (imgs.size ());
+      return results;
+    }
+    batch = std::max<size_t> (runner->get_input_batch (), 1);
+
+    if (imgs.size () == 1) {
+      results.push_back (ToDetections (runner->run (imgs[0]).*boxes_));
+      return results;
+    }
+
+    for (size_t i = 0; i < imgs.size (); i += batch) {
+      std::vector<cv::Mat> chunk (imgs.begin () + i,
+          imgs.begin () + std::min (i + batch, imgs.size ()));
+
+      for (auto &result : runner->run (chunk))
+        results.push_back (ToDetections (result.*boxes_));
+    }
+    return results;
+  }
+
+  const char *label (int id) const override
+  {
+    if (id < 0 || id >= (int) labels_.size ())
+      return "object";
+    return labels_[id].c_str ();
+  }
+
+  cv::Size input_size () const override { return input_size_; }
+
+private:
+  std::string model_;
+  cv::Size input_size_;
+  Boxes Result::*boxes_;
+  std::vector<std::string> labels_;
+};
+#endif
+
+class BackendRegistry
+{
+public:
+  typedef std::function<std::unique_ptr<DetectBackend> (const std::string &)>
+      Factory;
+
+  static BackendRegistry & get ()
+  {
+    static BackendRegistry registry;
+    return registry;
+  }
+
+  void add (const std::string & type, Factory factory)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    factories_[type] = factory;
+  }
+
+  /* Returns nullptr for an unknown type */
+  std::unique_ptr<DetectBackend> create (const std::string & type,
+      const std::string & model)
+  {
+    Factory factory;
+
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      auto it = factories_.find (type);
+      if (it == factories_.end ())
+        return nullptr;
+      factory = it->second;
+    }
+
+    return factory (model);
+  }
+
+  std::vector<std::string> types ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    std::vector<std::string> out;
+
+    for (auto &entry : factories_)
+      out.push_back (entry.first);
+    return out;
+  }
+
+private:
+  BackendRegistry () {}
+
+  std::mutex mutex_;
+  std::map<std::string, Factory> factories_;
+};
+
+#endif /* __DETECTBACKEND_HPP__ */
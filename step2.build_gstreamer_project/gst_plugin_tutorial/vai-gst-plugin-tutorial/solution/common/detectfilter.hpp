@@ -0,0 +1,165 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * DetectFilter - drops detections before anything is done with them
+ *
+ *  Boxes below the confidence threshold or of a class outside the
+ *  allow-list are removed, and of the rest only the max-detections best
+ *  scoring are kept.  The allow-list is given as class names or ids and
+ *  turned into a bitmap over the label ids once, so each box costs a bit
+ *  test rather than a string comparison.  With an NMS threshold the
+ *  remaining boxes also go through BoxSet non-maximum suppression, per
+ *  class or across classes, which the model's own per-class NMS does not
+ *  do.  Box is any type with label, score and normalized x, y, width and
+ *  height members, like the Vitis-AI-Library results.
+ *
+ *  The settings change from the application thread while frames are
+ *  filtered, so every access is locked.
+ */
+
+#ifndef __DETECTFILTER_HPP__
+#define __DETECTFILTER_HPP__
+
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boxset.hpp>
+
+#define DETECT_FILTER_MAX_LABELS 1024
+
+class DetectFilter
+{
+public:
+  DetectFilter () : threshold_ (0.0), max_detections_ (0), all_ (true),
+      nms_threshold_ (0.0f), nms_class_aware_ (true) {}
+
+  void set_threshold (double threshold)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    threshold_ = threshold;
+  }
+
+  /* Keep at most 'max' boxes, 0 keeps all */
+  void set_max_detections (unsigned max)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    max_detections_ = max;
+  }
+
+  /* Suppress boxes overlapping a better one by more than 'threshold' IoU,
+   * of the same class or of any class; 0 disables */
+  void set_nms (double threshold, bool class_agnostic)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    nms_threshold_ = threshold;
+    nms_class_aware_ = !class_agnostic;
+  }
+
+  /* Allow only the comma separated class names or label ids in 'list',
+   * looked up in the 'count' entries of 'names'; NULL or an empty list
+   * allows every class.  Returns the entries that matched no class. */
+  std::string set_classes (const char *list, const std::string * names,
+      size_t count)
+  {
+    std::bitset<DETECT_FILTER_MAX_LABELS> allowed;
+    std::stringstream items (list ? list : "");
+    std::string item, unknown;
+    bool any = false;
+
+    count = std::min<size_t> (count, DETECT_FILTER_MAX_LABELS);
+
+    while (std::getline (items, item, ',')) {
+      size_t first = item.find_first_not_of (" \t");
+      size_t last = item.find_last_not_of (" \t");
+      char *end;
+      long id;
+
+      if (first == std::string::npos)
+        continue;
+      item = item.substr (first, last - first + 1);
+      any = true;
+
+      id = strtol (item.c_str (), &end, 10);
+      if (*end != '\0')
+        id = std::find (names, names + count, item) - names;
+
+      if (id >= 0 && (size_t) id < count)
+        allowed.set (id);
+      else
+        unknown += (unknown.empty () ? "" : ",") + item;
+    }
+
+    std::lock_guard<std::mutex> lock (mutex_);
+    allowed_ = allowed;
+    all_ = !any;
+
+    return unknown;
+  }
+
+  template<class Box>
+  void apply (std::vector<Box> & boxes)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    if (!all_ || threshold_ > 0.0)
+      boxes.erase (std::remove_if (boxes.begin (), boxes.end (),
+              [this] (const Box & box) {
+                return box.score < threshold_ || !allowed (box.label);
+              }), boxes.end ());
+
+    /* Leaves the boxes best first, so max-detections only cuts the tail */
+    if (nms_threshold_ > 0.0f && boxes.size () > 1) {
+      set_.load (boxes);
+      set_.nms (nms_threshold_, nms_class_aware_);
+      set_.select (boxes);
+    }
+
+    if (max_detections_ > 0 && boxes.size () > max_detections_) {
+      std::partial_sort (boxes.begin (), boxes.begin () + max_detections_,
+          boxes.end (), [] (const Box & a, const Box & b) {
+            return a.score > b.score;
+          });
+      boxes.resize (max_detections_);
+    }
+  }
+
+private:
+  bool allowed (int label) const
+  {
+    return all_ || (label >= 0 && label < DETECT_FILTER_MAX_LABELS &&
+        allowed_.test (label));
+  }
+
+  std::mutex mutex_;
+  double threshold_;
+  size_t max_detections_;
+  bool all_;
+  std::bitset<DETECT_FILTER_MAX_LABELS> allowed_;
+  float nms_threshold_;
+  bool nms_class_aware_;
+  BoxSet set_;                  /* kept to reuse its arrays */
+};
+
+#endif /* __DETECTFILTER_HPP__ */
@@ -0,0 +1,192 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * DetectQos - decides when a frame is too late to be worth inference
+ *
+ *  Two deadlines are checked, both with the element's average processing
+ *  time added, since that is when the frame would leave the element:
+ *
+ *  - the earliest running time from the last upstream QoS event, as the
+ *    sinks report it when they render late
+ *  - for live sources, the frame's own running time plus max-lateness
+ *    against the clock, which catches frames piling up in queues even
+ *    when the sinks run with sync=false and send no QoS events
+ *
+ *  The element then either drops the frame, with a QoS message, or with
+ *  leaky-inference lets it through with the last known detections.
+ */
+
+#ifndef __DETECTQOS_HPP__
+#define __DETECTQOS_HPP__
+
+#include <algorithm>
+#include <mutex>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+
+class DetectQos
+{
+public:
+  DetectQos () { reset (); }
+
+  void reset ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    earliest_ = GST_CLOCK_TIME_NONE;
+    proportion_ = 1.0;
+    avg_processing_ = 0;
+    processed_ = 0;
+    dropped_ = 0;
+    live_ = -1;
+  }
+
+  /* Take in a QoS event travelling upstream through the element */
+  void handle_event (GstEvent * event)
+  {
+    GstClockTimeDiff diff;
+    GstClockTime timestamp;
+    gdouble proportion;
+
+    if (GST_EVENT_TYPE (event) != GST_EVENT_QOS)
+      return;
+
+    gst_event_parse_qos (event, NULL, &proportion, &diff, &timestamp);
+
+    std::lock_guard<std::mutex> lock (mutex_);
+    proportion_ = proportion;
+    if (!GST_CLOCK_TIME_IS_VALID (timestamp))
+      earliest_ = GST_CLOCK_TIME_NONE;
+    else if (diff > 0)
+      earliest_ = timestamp + 2 * diff;   /* late: skip ahead further */
+    else
+      earliest_ = timestamp + diff;
+  }
+
+  /* Whether the upstream liveness still has to be queried */
+  bool live_unknown ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return live_ < 0;
+  }
+
+  void set_live (bool live)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    live_ = live;
+  }
+
+  /* Check a frame at 'running_time' arriving at running time 'now' (NONE
+   * without a clock).  On lateness the amount is stored in 'jitter'. */
+  bool late (GstClockTime running_time, GstClockTime now,
+      GstClockTimeDiff max_lateness, GstClockTimeDiff * jitter)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    GstClockTimeDiff late_by = G_MININT64;
+
+    if (!GST_CLOCK_TIME_IS_VALID (running_time))
+      return false;
+
+    if (GST_CLOCK_TIME_IS_VALID (earliest_))
+      late_by = GST_CLOCK_DIFF (running_time + avg_processing_, earliest_);
+
+    if (live_ > 0 && GST_CLOCK_TIME_IS_VALID (now) && max_lateness >= 0)
+      late_by = std::max (late_by,
+          GST_CLOCK_DIFF (running_time, now + avg_processing_) -
+          max_lateness);
+
+    *jitter = late_by;
+    return late_by > 0;
+  }
+
+  /* Check a buffer entering a GstBaseTransform, returning its running time
+   * in 'running_time' */
+  bool late (GstBaseTransform * trans, GstBuffer * buf,
+      GstClockTimeDiff max_lateness, GstClockTime * running_time,
+      GstClockTimeDiff * jitter)
+  {
+    GstClockTime now = GST_CLOCK_TIME_NONE;
+    GstClock *clock;
+
+    if (live_unknown ()) {
+      GstQuery *query = gst_query_new_latency ();
+      gboolean live = FALSE;
+
+      if (gst_pad_peer_query (GST_BASE_TRANSFORM_SINK_PAD (trans), query))
+        gst_query_parse_latency (query, &live, NULL, NULL);
+      gst_query_unref (query);
+      set_live (live);
+    }
+
+    *running_time = gst_segment_to_running_time (&trans->segment,
+        GST_FORMAT_TIME, GST_BUFFER_PTS (buf));
+
+    if ((clock = gst_element_get_clock (GST_ELEMENT (trans)))) {
+      now = gst_clock_get_time (clock) -
+          gst_element_get_base_time (GST_ELEMENT (trans));
+      gst_object_unref (clock);
+    }
+
+    return late (*running_time, now, max_lateness, jitter);
+  }
+
+  /* Account a frame that went through, 'duration' being its time in the
+   * element */
+  void processed (GstClockTime duration)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    processed_++;
+    if (avg_processing_ == 0)
+      avg_processing_ = duration;
+    else
+      avg_processing_ = (7 * avg_processing_ + duration) / 8;
+  }
+
+  /* Account a dropped frame and tell the application about it */
+  void post_dropped (GstElement * element, const GstSegment * segment,
+      GstBuffer * buffer, GstClockTime running_time, GstClockTimeDiff jitter)
+  {
+    GstMessage *msg;
+    std::unique_lock<std::mutex> lock (mutex_);
+
+    dropped_++;
+    msg = gst_message_new_qos (GST_OBJECT (element), live_ > 0,
+        running_time, gst_segment_to_stream_time (segment, GST_FORMAT_TIME,
+            GST_BUFFER_PTS (buffer)), GST_BUFFER_PTS (buffer),
+        GST_BUFFER_DURATION (buffer));
+    gst_message_set_qos_values (msg, jitter, proportion_, 1000000);
+    gst_message_set_qos_stats (msg, GST_FORMAT_BUFFERS, processed_, dropped_);
+    lock.unlock ();
+
+    gst_element_post_message (element, msg);
+  }
+
+private:
+  std::mutex mutex_;
+  GstClockTime earliest_;
+  gdouble proportion_;
+  GstClockTime avg_processing_;
+  guint64 processed_;
+  guint64 dropped_;
+  int live_;                    /* -1 until upstream was queried */
+};
+
+#endif /* __DETECTQOS_HPP__ */
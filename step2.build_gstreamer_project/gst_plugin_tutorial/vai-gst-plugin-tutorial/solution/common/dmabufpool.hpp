@@ -0,0 +1,300 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * dmabufpool - fd backed frames for the detectors, mapped only on demand
+ *
+ *  The detectors offer upstream a pool of dmabuf frames from their
+ *  propose_allocation, so a producer that imports buffers (v4l2src
+ *  io-mode=dmabuf-import, or any element filling downstream buffers such
+ *  as videotestsrc) writes straight into memory the detector can read
+ *  without a copy.  The frames are memfd pages exported through
+ *  /dev/udmabuf, which any Linux 4.20+ box has, so the path can be tested
+ *  without the board; without udmabuf the memfd itself is handed out as
+ *  fd memory.
+ *
+ *  Inference only reads the frame, and for YUV only the pixels sampled
+ *  down to the model input, so the frame is mapped for reading first.
+ *  FrameMapWritable upgrades the mapping when there is something to draw;
+ *  frames without detections are never mapped for writing, which for
+ *  dmabuf saves the cache flush and for shared memory the copy.
+ *
+ *  The pool type is registered once per process, whichever plugin comes
+ *  first, like the vaistats tracer.
+ */
+
+#ifndef __DMABUFPOOL_HPP__
+#define __DMABUFPOOL_HPP__
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/types.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideopool.h>
+#include <gst/allocators/gstdmabuf.h>
+#include <gst/allocators/gstfdmemory.h>
+
+#if defined(__has_include)
+#if __has_include(<linux/udmabuf.h>)
+#include <linux/udmabuf.h>
+#endif
+#endif
+
+#ifndef UDMABUF_CREATE
+struct udmabuf_create
+{
+  __u32 memfd;
+  __u32 flags;
+  __u64 offset;
+  __u64 size;
+};
+#define UDMABUF_FLAGS_CLOEXEC 0x01
+#define UDMABUF_CREATE _IOW('u', 0x42, struct udmabuf_create)
+#endif
+
+#define VAI_DMABUF_POOL_TYPE_NAME "GstVaiDmabufPool"
+
+typedef struct
+{
+  GstBufferPool parent;
+
+  GstAllocator *dmabuf;         /* wraps the udmabuf fds */
+  GstAllocator *fd;             /* wraps memfds when udmabuf is missing */
+  int udmabuf;                  /* /dev/udmabuf, -1 when unavailable */
+  GstVideoInfo info;
+  gboolean video_meta;
+} GstVaiDmabufPool;
+
+typedef struct
+{
+  GstBufferPoolClass parent_class;
+} GstVaiDmabufPoolClass;
+
+static GstBufferPoolClass *vai_dmabuf_pool_parent_class;
+
+static const gchar **
+VaiDmabufPoolGetOptions (GstBufferPool * pool)
+{
+  static const gchar *options[] = { GST_BUFFER_POOL_OPTION_VIDEO_META, NULL };
+
+  return options;
+}
+
+static gboolean
+VaiDmabufPoolSetConfig (GstBufferPool * pool, GstStructure * config)
+{
+  GstVaiDmabufPool *self = (GstVaiDmabufPool *) pool;
+  guint size, min, max;
+  GstCaps *caps;
+
+  if (!gst_buffer_pool_config_get_params (config, &caps, &size, &min, &max)
+      || !caps || !gst_video_info_from_caps (&self->info, caps))
+    return FALSE;
+
+  self->video_meta = gst_buffer_pool_config_has_option (config,
+      GST_BUFFER_POOL_OPTION_VIDEO_META);
+  gst_buffer_pool_config_set_params (config, caps,
+      MAX (size, GST_VIDEO_INFO_SIZE (&self->info)), min, max);
+
+  return vai_dmabuf_pool_parent_class->set_config (pool, config);
+}
+
+/* A memfd of 'size' bytes as dmabuf memory, or as fd memory without
+ * udmabuf */
+static GstMemory *
+VaiDmabufPoolAllocMemory (GstVaiDmabufPool * self, gsize size)
+{
+  struct udmabuf_create create;
+  int memfd, fd;
+
+  memfd = memfd_create ("vai-frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+  if (memfd < 0)
+    return NULL;
+
+  if (ftruncate (memfd, size) < 0) {
+    close (memfd);
+    return NULL;
+  }
+
+  /* udmabuf wants the memfd sealed against shrinking */
+  if (self->udmabuf >= 0 && fcntl (memfd, F_ADD_SEALS, F_SEAL_SHRINK) == 0) {
+    create.memfd = memfd;
+    create.flags = UDMABUF_FLAGS_CLOEXEC;
+    create.offset = 0;
+    create.size = size;
+
+    fd = ioctl (self->udmabuf, UDMABUF_CREATE, &create);
+    if (fd >= 0) {
+      close (memfd);
+      return gst_dmabuf_allocator_alloc (self->dmabuf, fd, size);
+    }
+  }
+
+  return gst_fd_allocator_alloc (self->fd, memfd, size,
+      GST_FD_MEMORY_FLAG_NONE);
+}
+
+static GstFlowReturn
+VaiDmabufPoolAllocBuffer (GstBufferPool * pool, GstBuffer ** buffer,
+    GstBufferPoolAcquireParams * params)
+{
+  GstVaiDmabufPool *self = (GstVaiDmabufPool *) pool;
+  GstVideoInfo *info = &self->info;
+  gsize size = GST_VIDEO_INFO_SIZE (info);
+  gsize page = sysconf (_SC_PAGESIZE);
+  GstMemory *mem;
+
+  /* udmabuf works in whole pages */
+  mem = VaiDmabufPoolAllocMemory (self, (size + page - 1) / page * page);
+  if (!mem)
+    return GST_FLOW_ERROR;
+  gst_memory_resize (mem, 0, size);
+
+  *buffer = gst_buffer_new ();
+  gst_buffer_append_memory (*buffer, mem);
+
+  if (self->video_meta)
+    gst_buffer_add_video_meta_full (*buffer, GST_VIDEO_FRAME_FLAG_NONE,
+        GST_VIDEO_INFO_FORMAT (info), GST_VIDEO_INFO_WIDTH (info),
+        GST_VIDEO_INFO_HEIGHT (info), GST_VIDEO_INFO_N_PLANES (info),
+        info->offset, info->stride);
+
+  return GST_FLOW_OK;
+}
+
+static void
+VaiDmabufPoolFinalize (GObject * object)
+{
+  GstVaiDmabufPool *self = (GstVaiDmabufPool *) object;
+
+  if (self->udmabuf >= 0)
+    close (self->udmabuf);
+  gst_object_unref (self->dmabuf);
+  gst_object_unref (self->fd);
+
+  G_OBJECT_CLASS (vai_dmabuf_pool_parent_class)->finalize (object);
+}
+
+static void
+VaiDmabufPoolClassInit (GstVaiDmabufPoolClass * klass)
+{
+  GstBufferPoolClass *pool_class = GST_BUFFER_POOL_CLASS (klass);
+
+  vai_dmabuf_pool_parent_class =
+      GST_BUFFER_POOL_CLASS (g_type_class_peek_parent (klass));
+
+  G_OBJECT_CLASS (klass)->finalize = VaiDmabufPoolFinalize;
+  pool_class->get_options = VaiDmabufPoolGetOptions;
+  pool_class->set_config = VaiDmabufPoolSetConfig;
+  pool_class->alloc_buffer = VaiDmabufPoolAllocBuffer;
+}
+
+static void
+VaiDmabufPoolInit (GstVaiDmabufPool * self)
+{
+  self->dmabuf = gst_dmabuf_allocator_new ();
+  self->fd = gst_fd_allocator_new ();
+  self->udmabuf = open ("/dev/udmabuf", O_RDWR | O_CLOEXEC);
+  gst_video_info_init (&self->info);
+  self->video_meta = FALSE;
+}
+
+static GType
+VaiDmabufPoolGetType (void)
+{
+  static const GTypeInfo info = {
+    sizeof (GstVaiDmabufPoolClass), NULL, NULL,
+    (GClassInitFunc) VaiDmabufPoolClassInit, NULL, NULL,
+    sizeof (GstVaiDmabufPool), 0, (GInstanceInitFunc) VaiDmabufPoolInit,
+    NULL
+  };
+  static gsize type = 0;
+
+  /* First used from the streaming threads of any detector */
+  if (g_once_init_enter (&type)) {
+    GType registered = g_type_from_name (VAI_DMABUF_POOL_TYPE_NAME);
+
+    if (!registered)
+      registered = g_type_register_static (GST_TYPE_BUFFER_POOL,
+          VAI_DMABUF_POOL_TYPE_NAME, &info, (GTypeFlags) 0);
+    g_once_init_leave (&type, registered);
+  }
+
+  return type;
+}
+
+/* Offer a dmabuf pool for the caps in an allocation query, ahead of any
+ * pool already in it.  Call from propose_allocation before chaining up. */
+static inline void
+VaiDmabufProposeAllocation (GstQuery * query)
+{
+  GstStructure *config;
+  GstBufferPool *pool;
+  GstVideoInfo info;
+  GstCaps *caps;
+
+  gst_query_parse_allocation (query, &caps, NULL);
+  if (!caps || !gst_video_info_from_caps (&info, caps))
+    return;
+
+  pool = GST_BUFFER_POOL (g_object_new (VaiDmabufPoolGetType (), NULL));
+  config = gst_buffer_pool_get_config (pool);
+  gst_buffer_pool_config_set_params (config, caps, GST_VIDEO_INFO_SIZE (&info),
+      2, 0);
+  gst_buffer_pool_config_add_option (config,
+      GST_BUFFER_POOL_OPTION_VIDEO_META);
+
+  if (gst_buffer_pool_set_config (pool, config))
+    gst_query_add_allocation_pool (query, pool, GST_VIDEO_INFO_SIZE (&info),
+        2, 0);
+  gst_object_unref (pool);
+}
+
+/* Whether the frame's memory is a dmabuf, imported or from our pool.  The
+ * pool's memfd fallback counts too, it is the same path without udmabuf. */
+static inline bool
+FrameIsDmabuf (GstBuffer * buffer)
+{
+  GstMemory *mem;
+
+  if (gst_buffer_n_memory (buffer) == 0)
+    return false;
+
+  mem = gst_buffer_peek_memory (buffer, 0);
+  return gst_is_dmabuf_memory (mem) || gst_is_fd_memory (mem);
+}
+
+/* Map a frame that was mapped for reading again for writing, for drawing.
+ * The buffer must be kept alive by the caller.  Returns false, with the
+ * frame unmapped, when the mapping fails. */
+static inline bool
+FrameMapWritable (GstVideoFrame * frame, const GstVideoInfo * info)
+{
+  GstBuffer *buffer = frame->buffer;
+
+  gst_video_frame_unmap (frame);
+
+  return gst_video_frame_map (frame, (GstVideoInfo *) info, buffer,
+      GST_MAP_READWRITE);
+}
+
+#endif /* __DMABUFPOOL_HPP__ */
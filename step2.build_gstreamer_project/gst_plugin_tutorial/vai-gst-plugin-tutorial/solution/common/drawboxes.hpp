@@ -27,6 +27,7 @@
 
 #include <iostream>
 #include <opencv2/opencv.hpp>
+#include <vaikernels.hpp>
 
 template<class T>
 void DrawBoxes( cv::Mat img, T results, cv::Scalar color = cv::Scalar(0, 255, 0))
@@ -39,12 +40,7 @@ void DrawBoxes( cv::Mat img, T results, cv::Scalar color = cv::Scalar(0, 255, 0)
     int xmax = xmin + (box.width * img.cols);
     int ymax = ymin + (box.height * img.rows);
 
-    xmin = std::min(std::max(xmin, 0), img.cols);
-    xmax = std::min(std::max(xmax, 0), img.cols);
-    ymin = std::min(std::max(ymin, 0), img.rows);
-    ymax = std::min(std::max(ymax, 0), img.rows);
-
-    cv::rectangle(img, cv::Point(xmin, ymin), cv::Point(xmax, ymax), color, 2, 1, 0);
+    DrawRect(img, xmin, ymin, xmax, ymax, color, 2);
   }
 }
 
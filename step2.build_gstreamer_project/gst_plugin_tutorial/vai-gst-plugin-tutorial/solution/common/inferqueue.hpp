@@ -0,0 +1,232 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * InferQueue - bounded queue of in-flight inference jobs
+ *
+ *  Frames are pushed from the streaming thread, run on a small pool of
+ *  worker threads and popped again in the order they were pushed, so the
+ *  caller can map the next frame and draw the previous results while the
+ *  DPU is busy.  The queue knows nothing about GStreamer; a job carries an
+ *  opaque tag (the mapped GstVideoFrame in the plugins) and the run
+ *  function is a plain callable, so a CPU mock can stand in for the
+ *  Vitis-AI runner.
+ *
+ *  Workers take up to 'batch' frames per run call.  A partial batch is
+ *  dispatched once its oldest frame has waited 'max_latency', or right
+ *  away when somebody is blocked waiting on the queue.
+ */
+
+#ifndef __INFERQUEUE_HPP__
+#define __INFERQUEUE_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+
+template<class Result>
+class InferQueue
+{
+public:
+  typedef std::function<std::vector<Result> (const std::vector<cv::Mat> &)>
+      RunFunc;
+
+  InferQueue () : depth_ (1), batch_ (1), max_latency_ (0), waiters_ (0),
+      stopping_ (false) {}
+  ~InferQueue () { stop (); }
+
+  /* Spawn the worker threads.  At most 'depth' jobs are held at once, which
+   * is never less than one batch. */
+  void start (unsigned workers, unsigned depth, unsigned batch,
+      std::chrono::microseconds max_latency, RunFunc run)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    batch_ = std::max (batch, 1u);
+    depth_ = std::max (depth, batch_);
+    max_latency_ = max_latency;
+    run_ = run;
+    stopping_ = false;
+    for (unsigned i = 0; i < std::max (workers, 1u); i++)
+      threads_.emplace_back (&InferQueue::worker, this);
+  }
+
+  /* Join the workers.  Jobs that were never started are completed with an
+   * empty result and can still be popped. */
+  void stop ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      stopping_ = true;
+    }
+    cond_.notify_all ();
+    for (auto &t : threads_)
+      t.join ();
+    threads_.clear ();
+    flush ();
+  }
+
+  /* Queue a frame for inference.  Blocks while the queue is full and the
+   * oldest job is still running.  A frame pushed with 'infer' unset skips
+   * the workers and comes back with an empty result, in order. */
+  void push (void *tag, cv::Mat img, bool infer = true)
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    std::unique_ptr<Job> job (new Job);
+
+    waiters_++;
+    cond_.notify_all ();
+    cond_.wait (lock, [this] {
+      return jobs_.size () < depth_ || jobs_.front ()->done;
+    });
+    waiters_--;
+
+    job->tag = tag;
+    job->img = img;
+    job->queued = Clock::now ();
+    job->done = !infer;
+    if (infer)
+      pending_.push_back (job.get ());
+    jobs_.push_back (std::move (job));
+    cond_.notify_all ();
+  }
+
+  /* Pop the oldest job if it has finished.  With 'wait' set, block until
+   * it does.  Returns false when the queue is empty or the head is still
+   * running. */
+  bool pop (void **tag, Result * result, bool wait)
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+
+    if (jobs_.empty ())
+      return false;
+    if (wait) {
+      waiters_++;
+      cond_.notify_all ();
+      cond_.wait (lock, [this] { return jobs_.front ()->done; });
+      waiters_--;
+    }
+    if (!jobs_.front ()->done)
+      return false;
+
+    *tag = jobs_.front ()->tag;
+    *result = std::move (jobs_.front ()->result);
+    jobs_.pop_front ();
+    cond_.notify_all ();
+    return true;
+  }
+
+  /* Mark every job that has not been picked up by a worker as done, so a
+   * flush does not wait on inference whose output is thrown away. */
+  void flush ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    for (auto job : pending_)
+      job->done = true;
+    pending_.clear ();
+    cond_.notify_all ();
+  }
+
+  size_t size ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return jobs_.size ();
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Job
+  {
+    Job () : tag (nullptr), done (false) {}
+
+    void *tag;
+    cv::Mat img;
+    Clock::time_point queued;
+    Result result;
+    bool done;
+  };
+
+  /* A batch may go out when it is full, when its oldest frame has waited
+   * long enough or when the caller is blocked on the queue */
+  bool batch_ready ()
+  {
+    return pending_.size () >= batch_ || waiters_ > 0 ||
+        Clock::now () >= pending_.front ()->queued + max_latency_;
+  }
+
+  void worker ()
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    std::vector<Job *> jobs;
+    std::vector<cv::Mat> imgs;
+
+    for (;;) {
+      cond_.wait (lock, [this] { return stopping_ || !pending_.empty (); });
+      if (stopping_)
+        return;
+
+      if (!batch_ready ()) {
+        cond_.wait_until (lock, pending_.front ()->queued + max_latency_);
+        continue;
+      }
+
+      jobs.clear ();
+      imgs.clear ();
+      while (!pending_.empty () && jobs.size () < batch_) {
+        jobs.push_back (pending_.front ());
+        imgs.push_back (pending_.front ()->img);
+        pending_.pop_front ();
+      }
+
+      lock.unlock ();
+      std::vector<Result> results = run_ (imgs);
+      lock.lock ();
+
+      for (size_t i = 0; i < jobs.size (); i++) {
+        if (i < results.size ())
+          jobs[i]->result = std::move (results[i]);
+        jobs[i]->done = true;
+      }
+      cond_.notify_all ();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::deque<std::unique_ptr<Job>> jobs_;   /* all jobs, in push order */
+  std::deque<Job *> pending_;               /* jobs not yet started */
+  std::vector<std::thread> threads_;
+  RunFunc run_;
+  unsigned depth_;
+  unsigned batch_;
+  std::chrono::microseconds max_latency_;
+  unsigned waiters_;                        /* threads blocked in push/pop */
+  bool stopping_;
+};
+
+#endif /* __INFERQUEUE_HPP__ */
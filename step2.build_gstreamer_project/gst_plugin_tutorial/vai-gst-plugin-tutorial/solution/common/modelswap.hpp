@@ -0,0 +1,227 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * ModelSwap - the model an element runs, replaceable while it streams
+ *
+ *  The element runs whatever model is current, leasing its runners from
+ *  the RunnerPool.  request() names a new model, which is loaded through
+ *  the pool on a background thread while the current one keeps serving;
+ *  the streaming thread calls swap() at a frame boundary and, once the
+ *  new model is loaded, the next frames run on it.  The old model is
+ *  unreffed there and its runners are freed by the pool as soon as the
+ *  last lease on them comes back, so a frame still in inference finishes
+ *  on the model it started on.
+ *
+ *  Requests made while a load is under way are not queued, the latest
+ *  one is loaded next.  A model that fails to load is reported by swap()
+ *  and the current one stays.
+ */
+
+#ifndef __MODELSWAP_HPP__
+#define __MODELSWAP_HPP__
+
+#include <exception>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include <runnerpool.hpp>
+
+typedef enum
+{
+  MODEL_SWAP_NONE,
+  MODEL_SWAP_DONE,              /* the requested model is now current */
+  MODEL_SWAP_FAILED             /* the requested model failed to load */
+} ModelSwapResult;
+
+template<class Runner>
+class ModelSwap
+{
+public:
+  typedef typename RunnerPool<Runner>::Lease Lease;
+
+  /* Every model is loaded with 'preload' runners, one per thread that
+   * runs it */
+  explicit ModelSwap (unsigned preload) : preload_ (preload), loading_ (false)
+  {
+  }
+
+  /* Wait for a load under way, then drop the models */
+  ~ModelSwap ()
+  {
+    if (loader_.joinable ())
+      loader_.join ();
+
+    if (!current_.empty ())
+      RunnerPool<Runner>::get ().unref (current_);
+    if (!ready_.empty ())
+      RunnerPool<Runner>::get ().unref (ready_);
+  }
+
+  /* Load the first model, blocking.  False when it failed to load. */
+  bool open (const std::string & model)
+  {
+    if (!load (model))
+      return false;
+
+    std::lock_guard<std::mutex> lock (mutex_);
+    current_ = model;
+    return true;
+  }
+
+  /* Lease a runner of the current model, from any thread */
+  Lease acquire ()
+  {
+    std::string model;
+
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      model = current_;
+    }
+
+    return RunnerPool<Runner>::get ().acquire (model);
+  }
+
+  std::string current ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return current_;
+  }
+
+  /* Start loading 'model' in the background, unless it is current */
+  void request (const std::string & model)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    requested_ = model;
+    if (loading_)
+      return;
+
+    /* the previous loader has finished, joining it does not block */
+    if (loader_.joinable ())
+      loader_.join ();
+    loading_ = true;
+    loader_ = std::thread (&ModelSwap::run, this);
+  }
+
+  /* Whether swap() has something to report, so the caller can finish
+   * the frames in flight on the current model first */
+  bool pending ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    return !ready_.empty () || !failed_.empty ();
+  }
+
+  /* Called between frames: make a loaded model current.  'model' is set
+   * to the new model, or to the one that failed to load. */
+  ModelSwapResult swap (std::string & model, std::string & previous)
+  {
+    ModelSwapResult result;
+
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+
+      if (!failed_.empty ()) {
+        model.swap (failed_);
+        failed_.clear ();
+        return MODEL_SWAP_FAILED;
+      }
+      if (ready_.empty ())
+        return MODEL_SWAP_NONE;
+
+      previous.swap (current_);
+      current_.swap (ready_);
+      ready_.clear ();
+      model = current_;
+      result = MODEL_SWAP_DONE;
+    }
+
+    /* Frees the runners that are idle, leased ones go when they return */
+    RunnerPool<Runner>::get ().unref (previous);
+
+    return result;
+  }
+
+private:
+  /* Ref the model and check it came up, unreffing it again if not */
+  bool load (const std::string & model)
+  {
+    bool ok;
+
+    if (!RunnerPool<Runner>::get ().ref (model, preload_))
+      return false;
+
+    ok = (bool) RunnerPool<Runner>::get ().acquire (model);
+    if (!ok)
+      RunnerPool<Runner>::get ().unref (model);
+
+    return ok;
+  }
+
+  /* Loader thread: load the latest request until there is none left */
+  void run ()
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+
+    while (!requested_.empty ()) {
+      std::string model, stale;
+      bool ok = true;
+
+      model.swap (requested_);
+      if (model == ready_)
+        continue;
+
+      /* back to the current model, a loaded one is not wanted any more */
+      if (model != current_) {
+        lock.unlock ();
+        ok = load (model);
+        lock.lock ();
+      }
+
+      if (!ok) {
+        failed_ = model;
+        continue;
+      }
+
+      stale.swap (ready_);
+      if (model != current_)
+        ready_ = model;
+
+      if (!stale.empty ()) {
+        lock.unlock ();
+        RunnerPool<Runner>::get ().unref (stale);
+        lock.lock ();
+      }
+    }
+
+    loading_ = false;
+  }
+
+  unsigned preload_;
+  std::mutex mutex_;
+  std::thread loader_;
+  bool loading_;
+  std::string current_;
+  std::string requested_;       /* waiting for the loader */
+  std::string ready_;           /* loaded, current after the next swap() */
+  std::string failed_;
+};
+
+#endif /* __MODELSWAP_HPP__ */
@@ -0,0 +1,468 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * resultlog - per-frame detections written to a file or a Unix socket
+ *
+ *  ResultLogWriter takes one ResultFrame per video frame from the
+ *  streaming thread through an SpscRing and formats and writes it on its
+ *  own thread, so a slow disk or a stalled socket reader costs frames in
+ *  the log, counted as dropped, but never stalls the pipeline.  The socket
+ *  is non-blocking, so closing does not hang on a reader that stopped
+ *  reading either: it gets RESULT_LOG_CLOSE_MS to take the rest.
+ *
+ *  Two formats:
+ *
+ *   jsonl   one line per frame,
+ *           {"pts":N,"frame":N,"boxes":[{"label":"apple","score":0.91,
+ *            "x":N,"y":N,"w":N,"h":N},...]}, pts is null when unknown
+ *   binary  the magic "VAIRES1\n", then per frame pts and frame number as
+ *           u64, the box count as u16, and per box the label length as u8,
+ *           the label, the score as f32 and x, y, w, h as i32, all in host
+ *           byte order (little endian on the board and on x86 hosts)
+ *
+ *  Boxes are in pixels, as in the region of interest meta they come from.
+ *  ResultLogRead loads a log of either format back for replay; it reads
+ *  what the writer writes, it is not a general JSON parser.
+ */
+
+#ifndef __RESULTLOG_HPP__
+#define __RESULTLOG_HPP__
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <gst/gst.h>
+
+#include <spscring.hpp>
+
+#define RESULT_LOG_MAX_BOXES 64
+#define RESULT_LOG_MAGIC "VAIRES1\n"
+#define RESULT_LOG_MAGIC_LEN 8
+#define RESULT_LOG_SOCKET_PREFIX "unix:"
+
+/* Writer thread poll interval when the ring is empty */
+#define RESULT_LOG_POLL_MS 5
+
+/* How long close() waits on a socket reader that takes nothing */
+#define RESULT_LOG_CLOSE_MS 500
+
+typedef enum
+{
+  RESULT_FORMAT_JSONL,
+  RESULT_FORMAT_BINARY
+} ResultFormat;
+
+/* A frame as the streaming thread leaves it in the ring */
+struct ResultBox
+{
+  GQuark label;
+  float score;
+  gint32 x, y, w, h;
+};
+
+struct ResultFrame
+{
+  guint64 pts;
+  guint64 frame;
+  guint n;
+  ResultBox boxes[RESULT_LOG_MAX_BOXES];
+};
+
+/* A frame as read back from a log */
+struct ResultDetection
+{
+  std::string label;
+  float score;
+  gint32 x, y, w, h;
+};
+
+struct ResultRecord
+{
+  guint64 pts;
+  guint64 frame;
+  std::vector<ResultDetection> boxes;
+};
+
+template<class T>
+static inline void
+ResultLogPut (std::string & out, T value)
+{
+  out.append ((const char *) &value, sizeof (value));
+}
+
+static inline void
+ResultLogJsonString (std::string & out, const char *s)
+{
+  out += '"';
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      out += '\\';
+    if ((unsigned char) *s >= 0x20)
+      out += *s;
+  }
+  out += '"';
+}
+
+/* Append one frame to 'out' */
+static inline void
+ResultLogFormat (ResultFormat format, const ResultFrame & frame,
+    std::string & out)
+{
+  char num[64];
+
+  if (format == RESULT_FORMAT_BINARY) {
+    ResultLogPut<guint64> (out, frame.pts);
+    ResultLogPut<guint64> (out, frame.frame);
+    ResultLogPut<guint16> (out, frame.n);
+    for (guint i = 0; i < frame.n; i++) {
+      const ResultBox & box = frame.boxes[i];
+      const char *label = box.label ? g_quark_to_string (box.label) : "";
+      guint8 len = MIN (strlen (label), 255);
+
+      ResultLogPut<guint8> (out, len);
+      out.append (label, len);
+      ResultLogPut<float> (out, box.score);
+      ResultLogPut<gint32> (out, box.x);
+      ResultLogPut<gint32> (out, box.y);
+      ResultLogPut<gint32> (out, box.w);
+      ResultLogPut<gint32> (out, box.h);
+    }
+    return;
+  }
+
+  if (GST_CLOCK_TIME_IS_VALID (frame.pts))
+    snprintf (num, sizeof (num), "%" G_GUINT64_FORMAT, frame.pts);
+  else
+    snprintf (num, sizeof (num), "null");
+  out += "{\"pts\":";
+  out += num;
+  snprintf (num, sizeof (num), ",\"frame\":%" G_GUINT64_FORMAT, frame.frame);
+  out += num;
+  out += ",\"boxes\":[";
+  for (guint i = 0; i < frame.n; i++) {
+    const ResultBox & box = frame.boxes[i];
+
+    out += i ? ",{\"label\":" : "{\"label\":";
+    ResultLogJsonString (out, box.label ? g_quark_to_string (box.label) : "");
+    out += ",\"score\":";
+    out += g_ascii_formatd (num, sizeof (num), "%.4f", box.score);
+    snprintf (num, sizeof (num), ",\"x\":%d,\"y\":%d,\"w\":%d,\"h\":%d}",
+        box.x, box.y, box.w, box.h);
+    out += num;
+  }
+  out += "]}\n";
+}
+
+class ResultLogWriter
+{
+public:
+  ResultLogWriter (size_t frames, ResultFormat format)
+      : ring_ (frames), format_ (format), fd_ (-1), socket_ (false),
+      stopping_ (false), failed_ (false), dropped_ (0), written_ (0) {}
+
+  ~ResultLogWriter () { close (); }
+
+  /* Open a file path, or unix:<path> for a listening Unix socket, and
+   * start the writer thread */
+  bool open (const char *location, std::string & error)
+  {
+    if (g_str_has_prefix (location, RESULT_LOG_SOCKET_PREFIX)) {
+      const char *path = location + strlen (RESULT_LOG_SOCKET_PREFIX);
+      struct sockaddr_un addr = { };
+
+      addr.sun_family = AF_UNIX;
+      if (strlen (path) >= sizeof (addr.sun_path)) {
+        error = "socket path too long";
+        return false;
+      }
+      strcpy (addr.sun_path, path);
+
+      fd_ = socket (AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+      if (fd_ >= 0 && (connect (fd_, (struct sockaddr *) &addr,
+                  sizeof (addr)) < 0
+              || fcntl (fd_, F_SETFL, fcntl (fd_, F_GETFL) | O_NONBLOCK) < 0)) {
+        ::close (fd_);
+        fd_ = -1;
+      }
+      socket_ = true;
+    } else {
+      fd_ = ::open (location, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    }
+
+    if (fd_ < 0) {
+      error = strerror (errno);
+      return false;
+    }
+
+    if (format_ == RESULT_FORMAT_BINARY)
+      buf_.assign (RESULT_LOG_MAGIC, RESULT_LOG_MAGIC_LEN);
+
+    stopping_ = false;
+    thread_ = std::thread (&ResultLogWriter::run, this);
+    return true;
+  }
+
+  /* Write out what is left in the ring and close */
+  void close ()
+  {
+    if (thread_.joinable ()) {
+      stopping_ = true;
+      thread_.join ();
+    }
+    if (fd_ >= 0)
+      ::close (fd_);
+    fd_ = -1;
+  }
+
+  /* Streaming thread: the frame to fill, or NULL when the writer is behind
+   * and the frame has to be dropped */
+  ResultFrame *claim ()
+  {
+    ResultFrame *frame = ring_.claim ();
+
+    if (!frame)
+      dropped_++;
+    return frame;
+  }
+
+  void commit () { ring_.commit (); }
+
+  /* Whether writing failed, the log is incomplete from then on */
+  bool failed () const { return failed_; }
+
+  guint64 dropped () const { return dropped_; }
+
+  guint64 written () const { return written_; }
+
+private:
+  void run ()
+  {
+    for (;;) {
+      bool stopping = stopping_;
+      ResultFrame *frame;
+
+      while ((frame = ring_.front ())) {
+        ResultLogFormat (format_, *frame, buf_);
+        ring_.release ();
+        written_++;
+        if (buf_.size () >= 64 * 1024)
+          flush ();
+      }
+      flush ();
+
+      /* Checked before draining, so the last frames are written too */
+      if (stopping)
+        break;
+      std::this_thread::sleep_for (
+          std::chrono::milliseconds (RESULT_LOG_POLL_MS));
+    }
+  }
+
+  void flush ()
+  {
+    size_t done = 0;
+    int stalled_ms = 0;
+
+    while (!failed_ && done < buf_.size ()) {
+      ssize_t n = socket_ ?
+          send (fd_, buf_.data () + done, buf_.size () - done, MSG_NOSIGNAL) :
+          write (fd_, buf_.data () + done, buf_.size () - done);
+
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+        struct pollfd pfd = { fd_, POLLOUT, 0 };
+
+        /* Wait for the reader, but only so long once close() is waiting */
+        if (stopping_ && stalled_ms >= RESULT_LOG_CLOSE_MS) {
+          failed_ = true;
+          break;
+        }
+        if (poll (&pfd, 1, RESULT_LOG_POLL_MS) == 0 && stopping_)
+          stalled_ms += RESULT_LOG_POLL_MS;
+        continue;
+      }
+      if (n <= 0) {
+        failed_ = true;
+      } else {
+        done += n;
+        stalled_ms = 0;
+      }
+    }
+    buf_.clear ();
+  }
+
+  SpscRing<ResultFrame> ring_;
+  ResultFormat format_;
+  int fd_;
+  bool socket_;
+  std::thread thread_;
+  std::string buf_;             /* only touched by the writer thread */
+  std::atomic<bool> stopping_;
+  std::atomic<bool> failed_;
+  std::atomic<guint64> dropped_;
+  std::atomic<guint64> written_;
+};
+
+/* Value after "key": in a jsonl line, from 'pos' on; moves 'pos' past it */
+static inline const char *
+ResultLogJsonValue (const std::string & line, const char *key, size_t & pos)
+{
+  std::string pattern = std::string ("\"") + key + "\":";
+  size_t at = line.find (pattern, pos);
+
+  if (at == std::string::npos)
+    return NULL;
+  pos = at + pattern.size ();
+  return line.c_str () + pos;
+}
+
+static inline bool
+ResultLogParseLine (const std::string & line, ResultRecord & record)
+{
+  size_t pos = 0;
+  const char *v;
+
+  if (!(v = ResultLogJsonValue (line, "pts", pos)))
+    return false;
+  record.pts = strncmp (v, "null", 4) ? g_ascii_strtoull (v, NULL, 10) :
+      GST_CLOCK_TIME_NONE;
+  if (!(v = ResultLogJsonValue (line, "frame", pos)))
+    return false;
+  record.frame = g_ascii_strtoull (v, NULL, 10);
+
+  record.boxes.clear ();
+  while ((v = ResultLogJsonValue (line, "label", pos))) {
+    ResultDetection box;
+
+    /* The string, unescaped */
+    for (v++, pos++; *v && *v != '"'; v++, pos++) {
+      if (*v == '\\' && v[1]) {
+        v++;
+        pos++;
+      }
+      box.label += *v;
+    }
+
+    if (!(v = ResultLogJsonValue (line, "score", pos)))
+      return false;
+    box.score = g_ascii_strtod (v, NULL);
+    if (!(v = ResultLogJsonValue (line, "x", pos)))
+      return false;
+    box.x = atoi (v);
+    if (!(v = ResultLogJsonValue (line, "y", pos)))
+      return false;
+    box.y = atoi (v);
+    if (!(v = ResultLogJsonValue (line, "w", pos)))
+      return false;
+    box.w = atoi (v);
+    if (!(v = ResultLogJsonValue (line, "h", pos)))
+      return false;
+    box.h = atoi (v);
+    record.boxes.push_back (box);
+  }
+
+  return true;
+}
+
+template<class T>
+static inline bool
+ResultLogGet (std::istream & in, T * value)
+{
+  return (bool) in.read ((char *) value, sizeof (T));
+}
+
+static inline bool
+ResultLogParseBinary (std::istream & in, ResultRecord & record)
+{
+  guint16 n;
+
+  if (!ResultLogGet (in, &record.pts) || !ResultLogGet (in, &record.frame)
+      || !ResultLogGet (in, &n))
+    return false;
+
+  record.boxes.resize (n);
+  for (auto &box : record.boxes) {
+    guint8 len;
+
+    if (!ResultLogGet (in, &len))
+      return false;
+    box.label.resize (len);
+    if (!in.read (&box.label[0], len) || !ResultLogGet (in, &box.score)
+        || !ResultLogGet (in, &box.x) || !ResultLogGet (in, &box.y)
+        || !ResultLogGet (in, &box.w) || !ResultLogGet (in, &box.h))
+      return false;
+  }
+
+  return true;
+}
+
+/* Load a log of either format.  A log cut short, as after a crash, gives
+ * the frames up to the damage. */
+static inline bool
+ResultLogRead (const char *path, std::vector<ResultRecord> & records,
+    std::string & error)
+{
+  std::ifstream in (path, std::ios::binary);
+  char magic[RESULT_LOG_MAGIC_LEN];
+  ResultRecord record;
+
+  if (!in) {
+    error = strerror (errno);
+    return false;
+  }
+
+  records.clear ();
+  if (in.read (magic, sizeof (magic)) &&
+      !memcmp (magic, RESULT_LOG_MAGIC, RESULT_LOG_MAGIC_LEN)) {
+    while (ResultLogParseBinary (in, record))
+      records.push_back (record);
+    return true;
+  }
+
+  in.clear ();
+  in.seekg (0);
+  for (std::string line; std::getline (in, line);) {
+    if (line.empty ())
+      continue;
+    if (!ResultLogParseLine (line, record)) {
+      error = "malformed line " + std::to_string (records.size () + 1);
+      return false;
+    }
+    records.push_back (record);
+  }
+
+  return true;
+}
+
+#endif /* __RESULTLOG_HPP__ */
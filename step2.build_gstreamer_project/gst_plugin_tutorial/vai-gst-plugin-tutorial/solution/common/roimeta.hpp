@@ -0,0 +1,66 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * AttachBoxes - the metadata counterpart of DrawBoxes
+ *
+ *  Instead of drawing into the frame, every box is attached to the buffer
+ *  as a GstVideoRegionOfInterestMeta in pixel coordinates, with the score
+ *  in a "detection" parameter structure.  The buffer must be writable, but
+ *  its memory is never mapped for writing, so shared buffers stay
+ *  zero-copy.  The pixel rectangles are computed for all boxes at once
+ *  by BoxSet.
+ */
+
+#ifndef __ROIMETA_HPP__
+#define __ROIMETA_HPP__
+
+#include <algorithm>
+#include <gst/video/video.h>
+#include <gst/video/gstvideometa.h>
+
+#include <boxset.hpp>
+
+template<class T, class LabelFunc>
+void AttachBoxes( GstBuffer *buffer, int cols, int rows, const T & results,
+    LabelFunc label )
+{
+  std::vector<cv::Rect> rects;
+  BoxSet set;
+
+  set.load(results);
+  set.pixels(cols, rows, rects);
+
+  for (size_t i = 0; i < results.size(); i++)
+  {
+    auto &box = results[i];
+    const cv::Rect &rect = rects[i];
+
+    GstVideoRegionOfInterestMeta *meta =
+        gst_buffer_add_video_region_of_interest_meta (buffer, label (box),
+        rect.x, rect.y, rect.width, rect.height);
+
+    gst_video_region_of_interest_meta_add_param (meta,
+        gst_structure_new ("detection",
+            "confidence", G_TYPE_DOUBLE, (gdouble) box.score,
+            NULL));
+  }
+}
+
+#endif /* __ROIMETA_HPP__ */
@@ -0,0 +1,223 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * RunnerPool - process-wide pool of Vitis-AI-Library runners
+ *
+ *  One pool per runner type, keyed by model name.  Elements ref the model
+ *  in start(), which loads the runners up front, and unref it in stop();
+ *  the runners are destroyed when the last element lets go.
+ *
+ *  A runner is not safe to call from two threads at once, so it is leased
+ *  for the duration of a run call and handed back to the pool afterwards.
+ *  A new runner is only created when every loaded one is leased and none
+ *  is being loaded, so elements on different streaming threads share the
+ *  models and only load as many copies as actually run concurrently.
+ *
+ *  Runner is any type with a static create (const std::string &) that
+ *  returns a std::unique_ptr, like the Vitis-AI-Library classes.  A create
+ *  that throws or returns nullptr is a model that failed to load; the pool
+ *  never throws and never keeps a null runner.
+ */
+
+#ifndef __RUNNERPOOL_HPP__
+#define __RUNNERPOOL_HPP__
+
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+template<class Runner>
+class RunnerPool
+{
+  struct Entry
+  {
+    Entry () : refcount (0), loaded (0), loading (0) {}
+
+    unsigned refcount;
+    size_t loaded;                /* runners created, idle or leased */
+    size_t loading;               /* runners being created */
+    std::vector<std::unique_ptr<Runner>> idle;
+  };
+
+public:
+  /* Exclusive use of one runner, returned to the pool on destruction */
+  class Lease
+  {
+  public:
+    Lease (RunnerPool *pool, std::shared_ptr<Entry> entry,
+        std::unique_ptr<Runner> runner)
+        : pool_ (pool), entry_ (std::move (entry)),
+        runner_ (std::move (runner)) {}
+    Lease (Lease &&) = default;
+    ~Lease ()
+    {
+      if (runner_)
+        pool_->release (entry_, std::move (runner_));
+    }
+
+    Runner *operator-> () const { return runner_.get (); }
+    Runner & operator* () const { return *runner_; }
+
+    /* False when the model failed to load */
+    explicit operator bool () const { return runner_ != nullptr; }
+
+  private:
+    RunnerPool *pool_;
+    std::shared_ptr<Entry> entry_;
+    std::unique_ptr<Runner> runner_;
+  };
+
+  static RunnerPool & get ()
+  {
+    static RunnerPool pool;
+    return pool;
+  }
+
+  /* Take a reference on a model and make sure at least 'preload' runners
+   * are loaded or loading.  Blocks while the models load.  Returns false,
+   * without the reference, when the model failed to load. */
+  bool ref (const std::string & model, unsigned preload = 1)
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    std::shared_ptr<Entry> entry;
+    size_t have, missing;
+    bool ok = true;
+
+    auto &slot = entries_[model];
+    if (!slot)
+      slot = std::make_shared<Entry> ();
+    slot->refcount++;
+    entry = slot;
+    have = entry->loaded + entry->loading;
+    missing = preload > have ? preload - have : 0;
+    entry->loading += missing;
+
+    for (; missing > 0; missing--) {
+      lock.unlock ();
+      std::unique_ptr<Runner> runner = load (model);
+      lock.lock ();
+
+      entry->loading--;
+      cond_.notify_all ();
+      if (!runner) {
+        entry->loading -= missing - 1;
+        ok = false;
+        break;
+      }
+      entry->loaded++;
+      entry->idle.push_back (std::move (runner));
+    }
+
+    lock.unlock ();
+    if (!ok)
+      unref (model);
+
+    return ok;
+  }
+
+  /* Drop a reference; the last one unloads the model.  Runners that are
+   * still leased are destroyed when they come back. */
+  void unref (const std::string & model)
+  {
+    std::vector<std::unique_ptr<Runner>> idle;
+
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      auto it = entries_.find (model);
+      if (it == entries_.end () || --it->second->refcount > 0)
+        return;
+      idle.swap (it->second->idle);
+      entries_.erase (it);
+    }
+
+    /* idle runners are freed here, outside the lock */
+  }
+
+  /* Lease an idle runner for the model.  If all of them are busy, wait for
+   * one that is being loaded, or else load another copy.  The lease is
+   * empty when that load fails. */
+  Lease acquire (const std::string & model)
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    std::shared_ptr<Entry> entry;
+    std::unique_ptr<Runner> runner;
+
+    auto it = entries_.find (model);
+    if (it != entries_.end ())
+      entry = it->second;
+    else
+      entry = std::make_shared<Entry> ();     /* unreffed, dies with lease */
+
+    cond_.wait (lock, [&entry] {
+      return !entry->idle.empty () || entry->loading == 0;
+    });
+
+    if (!entry->idle.empty ()) {
+      runner = std::move (entry->idle.back ());
+      entry->idle.pop_back ();
+    } else {
+      entry->loading++;
+      lock.unlock ();
+      runner = load (model);
+      lock.lock ();
+      entry->loading--;
+      if (runner)
+        entry->loaded++;
+      cond_.notify_all ();
+    }
+    lock.unlock ();
+
+    return Lease (this, std::move (entry), std::move (runner));
+  }
+
+private:
+  RunnerPool () {}
+
+  /* Create a runner, nullptr when the model fails to load */
+  static std::unique_ptr<Runner> load (const std::string & model)
+  {
+    try {
+      return Runner::create (model);
+    } catch (...) {
+      return nullptr;
+    }
+  }
+
+  void release (const std::shared_ptr<Entry> & entry,
+      std::unique_ptr<Runner> runner)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    if (!runner)
+      return;
+    entry->idle.push_back (std::move (runner));
+    cond_.notify_all ();
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::map<std::string, std::shared_ptr<Entry>> entries_;
+};
+
+#endif /* __RUNNERPOOL_HPP__ */
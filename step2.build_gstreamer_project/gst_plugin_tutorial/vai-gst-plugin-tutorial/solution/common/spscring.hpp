@@ -0,0 +1,99 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * SpscRing - lock-free ring between one producer and one consumer thread
+ *
+ *  The streaming thread claims a slot, fills it in place and commits it;
+ *  a background thread takes the slots in order and releases them.  No
+ *  lock is taken and nothing is allocated after construction, and a full
+ *  ring is reported to the producer rather than waited on, so the
+ *  streaming thread never blocks on the consumer.
+ *
+ *  Only one thread may produce and only one consume.  The capacity is
+ *  rounded up to a power of two.
+ */
+
+#ifndef __SPSCRING_HPP__
+#define __SPSCRING_HPP__
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+template<class T>
+class SpscRing
+{
+public:
+  explicit SpscRing (size_t capacity) : head_ (0), tail_ (0)
+  {
+    size_t size = 1;
+
+    while (size < capacity)
+      size <<= 1;
+    slots_.resize (size);
+    mask_ = size - 1;
+  }
+
+  /* Producer: the next free slot, or NULL when the ring is full */
+  T *claim ()
+  {
+    size_t head = head_.load (std::memory_order_relaxed);
+
+    if (head - tail_.load (std::memory_order_acquire) > mask_)
+      return NULL;
+
+    return &slots_[head & mask_];
+  }
+
+  /* Producer: hand the claimed slot to the consumer */
+  void commit ()
+  {
+    head_.store (head_.load (std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+  }
+
+  /* Consumer: the oldest committed slot, or NULL when the ring is empty */
+  T *front ()
+  {
+    size_t tail = tail_.load (std::memory_order_relaxed);
+
+    if (tail == head_.load (std::memory_order_acquire))
+      return NULL;
+
+    return &slots_[tail & mask_];
+  }
+
+  /* Consumer: give the slot from front() back to the producer */
+  void release ()
+  {
+    tail_.store (tail_.load (std::memory_order_relaxed) + 1,
+        std::memory_order_release);
+  }
+
+  size_t capacity () const { return mask_ + 1; }
+
+private:
+  std::vector<T> slots_;
+  size_t mask_;
+  alignas (64) std::atomic<size_t> head_;       /* written by the producer */
+  alignas (64) std::atomic<size_t> tail_;       /* written by the consumer */
+};
+
+#endif /* __SPSCRING_HPP__ */
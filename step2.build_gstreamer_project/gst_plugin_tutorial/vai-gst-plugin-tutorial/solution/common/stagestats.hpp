@@ -0,0 +1,186 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * StageStats - rolling latency percentiles of a detector element
+ *
+ *  Keeps the StageTimer split of the last VAI_STATS_WINDOW frames, and
+ *  their sum as the "total" stage.  The element reads percentiles from it
+ *  for its latency-p50/p95/p99 properties, each a "vai-latency" structure
+ *  with one guint64 field in ns per stage, and posts them periodically as
+ *  a "vai-stats" element message:
+ *
+ *    frames       guint64  frames accounted since start
+ *    window       guint    frames the percentiles are taken over
+ *    <stage>-p50, <stage>-p95, <stage>-p99
+ *                 guint64  for map, preprocess, infer, postprocess, draw
+ *                          and total, in ns
+ *
+ *  Frames are added from the streaming threads and read from the
+ *  application, so every access is locked.
+ */
+
+#ifndef __STAGESTATS_HPP__
+#define __STAGESTATS_HPP__
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gst/gst.h>
+
+#include <stagetimer.hpp>
+
+#define VAI_STATS_WINDOW 512
+
+/* The sum of all stages, next to the VaiStage values */
+#define VAI_STAGE_TOTAL VAI_STAGE_COUNT
+
+class StageStats
+{
+public:
+  explicit StageStats (size_t window = VAI_STATS_WINDOW)
+    : ring_ (window)
+  {
+    reset ();
+  }
+
+  void reset ()
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    next_ = 0;
+    count_ = 0;
+    frames_ = 0;
+    last_post_ = GST_CLOCK_TIME_NONE;
+  }
+
+  void add (const StageTimer & timer)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    Sample & sample = ring_[next_];
+
+    sample[VAI_STAGE_TOTAL] = 0;
+    for (int stage = 0; stage < VAI_STAGE_COUNT; stage++) {
+      sample[stage] = timer.get ((VaiStage) stage);
+      sample[VAI_STAGE_TOTAL] += sample[stage];
+    }
+
+    next_ = (next_ + 1) % ring_.size ();
+    count_ = std::min (count_ + 1, ring_.size ());
+    frames_++;
+  }
+
+  /* Nearest rank percentile 'p' (0-1) of 'stage' over the window, 0 with
+   * no frames yet */
+  GstClockTime percentile (int stage, double p)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    return percentile_locked (stage, p);
+  }
+
+  /* Percentile 'p' of every stage as a "vai-latency" structure */
+  GstStructure *latency (double p)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    GstStructure *s = gst_structure_new_empty ("vai-latency");
+
+    for (int stage = 0; stage <= VAI_STAGE_TOTAL; stage++)
+      gst_structure_set (s, name (stage), G_TYPE_UINT64,
+          (guint64) percentile_locked (stage, p), NULL);
+
+    return s;
+  }
+
+  /* Post a vai-stats message when 'interval' has passed since the last
+   * one; an interval of 0 never posts */
+  void post_if_due (GstElement * element, GstClockTime interval)
+  {
+    static const struct { const char *suffix; double p; } ranks[] = {
+      { "-p50", 0.50 }, { "-p95", 0.95 }, { "-p99", 0.99 }
+    };
+    std::unique_lock<std::mutex> lock (mutex_);
+    GstClockTime now;
+    GstStructure *s;
+
+    if (interval == 0 || count_ == 0)
+      return;
+
+    now = gst_util_get_timestamp ();
+    if (!GST_CLOCK_TIME_IS_VALID (last_post_)) {
+      last_post_ = now;
+      return;
+    }
+    if (now - last_post_ < interval)
+      return;
+    last_post_ = now;
+
+    s = gst_structure_new ("vai-stats",
+        "frames", G_TYPE_UINT64, frames_,
+        "window", G_TYPE_UINT, (guint) count_, NULL);
+    for (int stage = 0; stage <= VAI_STAGE_TOTAL; stage++)
+      for (auto &rank : ranks)
+        gst_structure_set (s, (std::string (name (stage)) +
+                rank.suffix).c_str (), G_TYPE_UINT64,
+            (guint64) percentile_locked (stage, rank.p), NULL);
+    lock.unlock ();
+
+    gst_element_post_message (element,
+        gst_message_new_element (GST_OBJECT (element), s));
+  }
+
+  static const char *name (int stage)
+  {
+    return stage == VAI_STAGE_TOTAL ? "total" :
+        StageTimer::name ((VaiStage) stage);
+  }
+
+private:
+  typedef std::array<GstClockTime, VAI_STAGE_COUNT + 1> Sample;
+
+  GstClockTime percentile_locked (int stage, double p)
+  {
+    std::vector<GstClockTime> values (count_);
+    size_t rank;
+
+    if (count_ == 0)
+      return 0;
+
+    for (size_t i = 0; i < count_; i++)
+      values[i] = ring_[i][stage];
+
+    rank = (size_t) std::ceil (p * count_);
+    rank = std::min (std::max (rank, (size_t) 1), count_) - 1;
+    std::nth_element (values.begin (), values.begin () + rank, values.end ());
+
+    return values[rank];
+  }
+
+  std::mutex mutex_;
+  std::vector<Sample> ring_;
+  size_t next_;
+  size_t count_;
+  guint64 frames_;
+  GstClockTime last_post_;
+};
+
+#endif /* __STAGESTATS_HPP__ */
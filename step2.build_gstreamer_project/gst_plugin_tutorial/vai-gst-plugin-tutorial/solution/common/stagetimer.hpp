@@ -0,0 +1,97 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * StageTimer - where a frame's time goes inside a detector element
+ *
+ *  The element marks the end of each stage as it goes; the time since
+ *  the previous mark is added to that stage.  With the element's timing
+ *  property set, the split is posted as a "vai-frame-timing" element
+ *  message per frame, which is what the vaibench harness collects:
+ *
+ *    stream       guint    sink pad index, 0 for single stream elements
+ *    pts          guint64  buffer PTS
+ *    map, preprocess, infer, postprocess, draw
+ *                 guint64  nanoseconds spent in each stage
+ */
+
+#ifndef __STAGETIMER_HPP__
+#define __STAGETIMER_HPP__
+
+#include <gst/gst.h>
+
+enum VaiStage
+{
+  VAI_STAGE_MAP,
+  VAI_STAGE_PREPROCESS,
+  VAI_STAGE_INFER,
+  VAI_STAGE_POSTPROCESS,
+  VAI_STAGE_DRAW,
+  VAI_STAGE_COUNT
+};
+
+class StageTimer
+{
+public:
+  StageTimer () : last_ (gst_util_get_timestamp ())
+  {
+    for (auto &time : times_)
+      time = 0;
+  }
+
+  /* End 'stage' now */
+  void mark (VaiStage stage)
+  {
+    GstClockTime now = gst_util_get_timestamp ();
+
+    times_[stage] += now - last_;
+    last_ = now;
+  }
+
+  GstClockTime get (VaiStage stage) const { return times_[stage]; }
+
+  static const char *name (VaiStage stage)
+  {
+    static const char *names[VAI_STAGE_COUNT] = {
+      "map", "preprocess", "infer", "postprocess", "draw"
+    };
+
+    return names[stage];
+  }
+
+  void post (GstElement * element, guint stream, GstClockTime pts) const
+  {
+    GstStructure *s = gst_structure_new ("vai-frame-timing",
+        "stream", G_TYPE_UINT, stream,
+        "pts", G_TYPE_UINT64, (guint64) pts, NULL);
+
+    for (int stage = 0; stage < VAI_STAGE_COUNT; stage++)
+      gst_structure_set (s, name ((VaiStage) stage), G_TYPE_UINT64,
+          (guint64) times_[stage], NULL);
+
+    gst_element_post_message (element,
+        gst_message_new_element (GST_OBJECT (element), s));
+  }
+
+private:
+  GstClockTime last_;
+  GstClockTime times_[VAI_STAGE_COUNT];
+};
+
+#endif /* __STAGETIMER_HPP__ */
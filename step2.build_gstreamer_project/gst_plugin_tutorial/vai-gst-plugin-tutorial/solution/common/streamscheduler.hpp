@@ -0,0 +1,253 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * StreamScheduler - one accelerator shared by several video streams
+ *
+ *  Every stream submits its frames from its own streaming thread and
+ *  blocks until the result is back.  A single scheduler thread owns the
+ *  model and runs the waiting frames in batches across streams, earliest
+ *  deadline first.  A frame's deadline is its submit time plus the
+ *  stream's deadline divided by the stream's priority, so a higher
+ *  priority stream is served sooner but no stream starves.
+ *
+ *  A batch goes out when it is full, when every stream has a frame
+ *  waiting (each stream has at most one in flight) or when the first
+ *  frame has waited max_latency.  A stream that ended sends no more
+ *  frames, so it is left out of "every stream" until it starts again.
+ */
+
+#ifndef __STREAMSCHEDULER_HPP__
+#define __STREAMSCHEDULER_HPP__
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+
+template<class Result>
+class StreamScheduler
+{
+public:
+  typedef std::function<std::vector<Result> (const std::vector<cv::Mat> &)>
+      RunFunc;
+
+  StreamScheduler () : batch_ (1), max_latency_ (0), stopping_ (true) {}
+  ~StreamScheduler () { stop (); }
+
+  void start (unsigned batch, std::chrono::microseconds max_latency,
+      RunFunc run)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    batch_ = std::max (batch, 1u);
+    max_latency_ = max_latency;
+    run_ = run;
+    ended_.clear ();
+    stopping_ = false;
+    thread_ = std::thread (&StreamScheduler::worker, this);
+  }
+
+  /* Cancel the waiting frames and join the scheduler thread.  Submitting
+   * fails until the next start(). */
+  void stop ()
+  {
+    {
+      std::lock_guard<std::mutex> lock (mutex_);
+      stopping_ = true;
+      cancel_locked ([] (const Job *) { return true; });
+    }
+    cond_.notify_all ();
+    if (thread_.joinable ())
+      thread_.join ();
+  }
+
+  void add_stream (unsigned stream)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    streams_.insert (stream);
+  }
+
+  void remove_stream (unsigned stream)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    streams_.erase (stream);
+    ended_.erase (stream);
+    cond_.notify_all ();
+  }
+
+  /* An ended stream is not waited for to fill a batch */
+  void set_ended (unsigned stream, bool ended)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    if (ended && streams_.count (stream))
+      ended_.insert (stream);
+    else
+      ended_.erase (stream);
+    cond_.notify_all ();
+  }
+
+  /* While a stream is flushing its frames are cancelled */
+  void set_flushing (unsigned stream, bool flushing)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    if (flushing) {
+      flushing_.insert (stream);
+      cancel_locked ([stream] (const Job * job) {
+        return job->stream == stream;
+      });
+    } else {
+      flushing_.erase (stream);
+    }
+    cond_.notify_all ();
+  }
+
+  /* Run one frame of a stream, blocking until it is done.  Returns false
+   * when the frame was cancelled by a flush or stop. */
+  bool submit (unsigned stream, cv::Mat img, unsigned priority,
+      std::chrono::microseconds deadline, Result * result)
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    Job job;
+
+    if (stopping_ || flushing_.count (stream))
+      return false;
+
+    job.stream = stream;
+    job.img = img;
+    job.queued = Clock::now ();
+    job.due = job.queued + deadline / std::max (priority, 1u);
+    pending_.push_back (&job);
+    cond_.notify_all ();
+
+    cond_.wait (lock, [&job] { return job.done; });
+    if (job.cancelled)
+      return false;
+
+    *result = std::move (job.result);
+    return true;
+  }
+
+private:
+  typedef std::chrono::steady_clock Clock;
+
+  struct Job
+  {
+    Job () : stream (0), done (false), cancelled (false) {}
+
+    unsigned stream;
+    cv::Mat img;
+    Clock::time_point queued;
+    Clock::time_point due;
+    Result result;
+    bool done;
+    bool cancelled;
+  };
+
+  template<class Pred>
+  void cancel_locked (Pred pred)
+  {
+    auto it = std::partition (pending_.begin (), pending_.end (),
+        [&pred] (const Job * job) { return !pred (job); });
+
+    for (auto cancel = it; cancel != pending_.end (); ++cancel) {
+      (*cancel)->cancelled = true;
+      (*cancel)->done = true;
+    }
+    pending_.erase (it, pending_.end ());
+    cond_.notify_all ();
+  }
+
+  Clock::time_point oldest ()
+  {
+    Clock::time_point t = pending_.front ()->queued;
+
+    for (auto job : pending_)
+      t = std::min (t, job->queued);
+    return t;
+  }
+
+  bool batch_ready ()
+  {
+    return pending_.size () >= batch_ ||
+        pending_.size () >= streams_.size () - ended_.size () ||
+        Clock::now () >= oldest () + max_latency_;
+  }
+
+  void worker ()
+  {
+    std::unique_lock<std::mutex> lock (mutex_);
+    std::vector<Job *> jobs;
+    std::vector<cv::Mat> imgs;
+
+    for (;;) {
+      cond_.wait (lock, [this] { return stopping_ || !pending_.empty (); });
+      if (stopping_)
+        return;
+
+      if (!batch_ready ()) {
+        cond_.wait_until (lock, oldest () + max_latency_);
+        continue;
+      }
+
+      /* earliest deadline first */
+      std::stable_sort (pending_.begin (), pending_.end (),
+          [] (const Job * a, const Job * b) { return a->due < b->due; });
+
+      size_t n = std::min<size_t> (pending_.size (), batch_);
+      jobs.assign (pending_.begin (), pending_.begin () + n);
+      pending_.erase (pending_.begin (), pending_.begin () + n);
+      imgs.clear ();
+      for (auto job : jobs)
+        imgs.push_back (job->img);
+
+      lock.unlock ();
+      std::vector<Result> results = run_ (imgs);
+      lock.lock ();
+
+      for (size_t i = 0; i < jobs.size (); i++) {
+        if (i < results.size ())
+          jobs[i]->result = std::move (results[i]);
+        jobs[i]->done = true;
+      }
+      cond_.notify_all ();
+    }
+  }
+
+  std::mutex mutex_;
+  std::condition_variable cond_;
+  std::thread thread_;
+  std::vector<Job *> pending_;        /* waiting jobs, on the callers' stacks */
+  std::set<unsigned> flushing_;
+  std::set<unsigned> streams_;
+  std::set<unsigned> ended_;          /* streams past EOS, a subset of streams_ */
+  RunFunc run_;
+  unsigned batch_;
+  std::chrono::microseconds max_latency_;
+  bool stopping_;
+};
+
+#endif /* __STREAMSCHEDULER_HPP__ */
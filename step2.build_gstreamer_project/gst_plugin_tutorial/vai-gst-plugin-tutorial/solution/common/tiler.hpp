@@ -0,0 +1,160 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * FrameTiler - detection on a high resolution frame in model sized tiles
+ *
+ *  Scaling a 1920x1080 frame down to the model input leaves small objects
+ *  a few pixels wide.  The tiler instead lays tiles of the model input size
+ *  over the frame at its own resolution, overlapping so an object cut by
+ *  one tile edge is whole in the neighbour, and the tiles run as a batch.
+ *
+ *  Each tile keeps a SceneChange thumbnail of when it last went through
+ *  the model, and a tile that has not moved since keeps its boxes rather
+ *  than running again; on a mostly still scene only the few tiles with
+ *  motion cost inference.
+ *
+ *  The boxes of all tiles are mapped to the frame and merged per class.
+ *  An object in the overlap is found by both tiles, often cut short in
+ *  one of them, so boxes are suppressed by their intersection over the
+ *  smaller box rather than by IoU, in a BoxSet.  Box is any type with
+ *  normalized x, y, width, height, label and score members, like the
+ *  Vitis-AI-Library results.
+ */
+
+#ifndef __TILER_HPP__
+#define __TILER_HPP__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <tracker.hpp>
+#include <boxset.hpp>
+
+#define FRAME_TILER_MERGE_OVERLAP 0.5f
+
+template<class Box>
+class FrameTiler
+{
+public:
+  /* Lay tiles of 'tile' size over a 'frame', neighbours overlapping by at
+   * least 'overlap' of a tile.  A frame smaller than a tile is one tile. */
+  void configure (cv::Size frame, cv::Size tile, double overlap)
+  {
+    std::vector<int> xs = positions (frame.width, tile.width, overlap);
+    std::vector<int> ys = positions (frame.height, tile.height, overlap);
+
+    frame_ = frame;
+    tiles_.clear ();
+    for (int y : ys)
+      for (int x : xs)
+        tiles_.push_back (cv::Rect (x, y, std::min (tile.width, frame.width),
+                std::min (tile.height, frame.height)));
+
+    scenes_.assign (tiles_.size (), SceneChange ());
+    boxes_.assign (tiles_.size (), std::vector<Box> ());
+  }
+
+  size_t size () const { return tiles_.size (); }
+
+  const cv::Rect & tile (size_t i) const { return tiles_[i]; }
+
+  /* Size of the thumbnail moved() needs, anything larger is scaled down */
+  static cv::Size thumb_size () { return cv::Size (32, 18); }
+
+  /* Whether tile 'i' differs by more than 'threshold' from when it last
+   * went through the model.  Always true for a threshold of 0. */
+  bool moved (size_t i, const cv::Mat & thumb, double threshold)
+  {
+    if (threshold <= 0.0)
+      return true;
+
+    return scenes_[i].score (thumb) > threshold;
+  }
+
+  /* Results of the model for tile 'i', normalized to the tile */
+  void update (size_t i, const std::vector<Box> & boxes)
+  {
+    const cv::Rect & tile = tiles_[i];
+
+    boxes_[i].clear ();
+    for (auto box : boxes) {
+      box.x = (tile.x + box.x * tile.width) / frame_.width;
+      box.y = (tile.y + box.y * tile.height) / frame_.height;
+      box.width = box.width * tile.width / frame_.width;
+      box.height = box.height * tile.height / frame_.height;
+      boxes_[i].push_back (box);
+    }
+    scenes_[i].update ();
+  }
+
+  /* The latest boxes of every tile, normalized to the frame, with the
+   * duplicates from overlapping tiles dropped */
+  std::vector<Box> merge ()
+  {
+    std::vector<Box> all;
+
+    for (auto &boxes : boxes_)
+      all.insert (all.end (), boxes.begin (), boxes.end ());
+
+    set_.load (all);
+    set_.nms (FRAME_TILER_MERGE_OVERLAP, true, BOX_OVERLAP_IOS);
+    set_.select (all);
+
+    return all;
+  }
+
+  /* Forget the boxes and thumbnails, every tile runs on the next frame */
+  void reset ()
+  {
+    for (auto &scene : scenes_)
+      scene.reset ();
+    for (auto &boxes : boxes_)
+      boxes.clear ();
+  }
+
+private:
+  /* Evenly spread tile origins along one axis */
+  static std::vector<int> positions (int length, int tile, double overlap)
+  {
+    std::vector<int> origins;
+    double step = tile * (1.0 - std::min (std::max (overlap, 0.0), 0.9));
+    int n;
+
+    if (length <= tile || step < 1.0)
+      return std::vector<int> (1, 0);
+
+    n = (int) std::ceil ((length - tile) / step) + 1;
+    for (int i = 0; i < n; i++)
+      origins.push_back ((int) std::lround ((double) i * (length - tile) /
+              (n - 1)));
+
+    return origins;
+  }
+
+  cv::Size frame_;
+  std::vector<cv::Rect> tiles_;
+  std::vector<SceneChange> scenes_;
+  std::vector<std::vector<Box>> boxes_;   /* normalized to the frame */
+  BoxSet set_;
+};
+
+#endif /* __TILER_HPP__ */
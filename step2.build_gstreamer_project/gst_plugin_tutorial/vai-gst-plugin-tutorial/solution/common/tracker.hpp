@@ -0,0 +1,170 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * Cheap helpers for skipping inference on frames in between detections
+ *
+ *  SceneChange keeps a tiny thumbnail of the last frame that went through
+ *  the model and scores how much the current frame differs from it.
+ *
+ *  BoxTracker matches each new set of detections against the previous one
+ *  by IoU, keeps a per-box velocity and extrapolates the boxes for the
+ *  frames that skip inference.  The velocity decays every frame, so a box
+ *  that goes long without a detection, like fruit left on the scale while
+ *  its weighing result is locked, comes to rest instead of drifting away,
+ *  and boxes are kept inside the frame.  Box is any type with normalized
+ *  x, y, width and height members, like the Vitis-AI-Library results.
+ */
+
+#ifndef __TRACKER_HPP__
+#define __TRACKER_HPP__
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+class SceneChange
+{
+public:
+  /* Mean absolute difference to the reference thumbnail, 0.0 - 1.0.
+   * Returns 1.0 when there is no reference yet. */
+  double score (const cv::Mat & img)
+  {
+    cv::resize (img, thumb_, cv::Size (32, 18), 0, 0, cv::INTER_AREA);
+    if (ref_.empty () || ref_.size () != thumb_.size ()
+        || ref_.type () != thumb_.type ())
+      return 1.0;
+
+    return cv::norm (thumb_, ref_, cv::NORM_L1) /
+        (thumb_.total () * thumb_.channels () * 255.0);
+  }
+
+  /* Make the thumbnail of the last scored frame the new reference */
+  void update () { thumb_.copyTo (ref_); }
+
+  void reset () { ref_.release (); }
+
+private:
+  cv::Mat thumb_;
+  cv::Mat ref_;
+};
+
+template<class Box>
+class BoxTracker
+{
+public:
+  BoxTracker (float min_iou = 0.3f, float decay = 0.8f, int max_steps = 30)
+      : min_iou_ (min_iou), decay_ (decay), max_steps_ (max_steps),
+      steps_ (0) {}
+
+  /* New detections from the model */
+  void update (const std::vector<Box> & boxes)
+  {
+    std::vector<Track> tracks;
+    std::vector<bool> used (tracks_.size (), false);
+    float elapsed = std::max (steps_ + 1, 1);
+
+    for (auto &box : boxes) {
+      Track track = { box, 0.0f, 0.0f };
+      int best = -1;
+      float best_iou = min_iou_;
+
+      for (size_t i = 0; i < tracks_.size (); i++) {
+        float overlap = iou (tracks_[i].origin, box);
+        if (!used[i] && overlap >= best_iou) {
+          best = i;
+          best_iou = overlap;
+        }
+      }
+
+      if (best >= 0) {
+        used[best] = true;
+        track.vx = (box.x - tracks_[best].origin.x) / elapsed;
+        track.vy = (box.y - tracks_[best].origin.y) / elapsed;
+      }
+      tracks.push_back (track);
+    }
+
+    tracks_.swap (tracks);
+    steps_ = 0;
+  }
+
+  /* Advance one frame without inference and return the moved boxes */
+  std::vector<Box> predict ()
+  {
+    std::vector<Box> boxes;
+    float travel;
+
+    /* Frames of motion so far, each at 'decay' times the speed of the one
+     * before; never more than 1 / (1 - decay) */
+    steps_ = std::min (steps_ + 1, max_steps_);
+    travel = decay_ < 1.0f ?
+        (1.0f - std::pow (decay_, (float) steps_)) / (1.0f - decay_) : steps_;
+
+    for (auto &track : tracks_) {
+      Box box = track.origin;
+      box.x = clamp (box.x + track.vx * travel, box.width);
+      box.y = clamp (box.y + track.vy * travel, box.height);
+      boxes.push_back (box);
+    }
+
+    return boxes;
+  }
+
+  void reset ()
+  {
+    tracks_.clear ();
+    steps_ = 0;
+  }
+
+private:
+  struct Track
+  {
+    Box origin;                 /* box at the last inference */
+    float vx, vy;               /* motion per frame */
+  };
+
+  /* Keep a box of 'size' starting at 'pos' inside 0.0 - 1.0 */
+  static float clamp (float pos, float size)
+  {
+    return std::min (std::max (pos, 0.0f), std::max (1.0f - size, 0.0f));
+  }
+
+  static float iou (const Box & a, const Box & b)
+  {
+    float x0 = std::max (a.x, b.x);
+    float y0 = std::max (a.y, b.y);
+    float x1 = std::min (a.x + a.width, b.x + b.width);
+    float y1 = std::min (a.y + a.height, b.y + b.height);
+    float inter = std::max (x1 - x0, 0.0f) * std::max (y1 - y0, 0.0f);
+    float uni = a.width * a.height + b.width * b.height - inter;
+
+    return uni > 0.0f ? inter / uni : 0.0f;
+  }
+
+  std::vector<Track> tracks_;
+  float min_iou_;
+  float decay_;                 /* velocity kept from one frame to the next */
+  int max_steps_;
+  int steps_;                   /* frames since the last update, capped */
+};
+
+#endif /* __TRACKER_HPP__ */
@@ -0,0 +1,418 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * vaikernels - per-frame pixel kernels for the detector plugins
+ *
+ *  NormalizeBGR  BGR frame to an int8 HWC tensor, (p - mean) * scale with
+ *                saturation, replacing convertTo/subtract/multiply
+ *  DrawRect      box outline, replacing cv::rectangle
+ *  GlyphAtlas    label text from glyphs rendered once with cv::putText,
+ *                so drawing a label is only a masked copy per glyph
+ *
+ *  Each row kernel has a NEON path for the A53, an SSE path for x86 hosts
+ *  and a scalar fallback, which also handles the row tails.  Define
+ *  VAI_KERNELS_SCALAR to force the fallback.  The kernelbench tool
+ *  compares them against the OpenCV calls they replace.
+ */
+
+#ifndef __VAIKERNELS_HPP__
+#define __VAIKERNELS_HPP__
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#ifndef VAI_KERNELS_SCALAR
+#if defined(__ARM_NEON) && defined(__aarch64__)
+#define VAI_KERNELS_NEON 1
+#include <arm_neon.h>
+#elif defined(__SSE2__)
+#define VAI_KERNELS_SSE2 1
+#include <emmintrin.h>
+#if defined(__SSSE3__)
+#define VAI_KERNELS_SSSE3 1
+#include <tmmintrin.h>
+#endif
+#endif
+#endif
+
+/* Name of the compiled kernel path, for logs and the benchmark */
+inline const char *
+VaiKernelsPath ()
+{
+#if defined(VAI_KERNELS_NEON)
+  return "neon";
+#elif defined(VAI_KERNELS_SSSE3)
+  return "ssse3";
+#elif defined(VAI_KERNELS_SSE2)
+  return "sse2";
+#else
+  return "scalar";
+#endif
+}
+
+#if defined(VAI_KERNELS_NEON)
+/* One channel of 8 pixels: widen, normalize, round to nearest, narrow */
+static inline int8x8_t
+NormalizeLanes (uint8x8_t px, float32x4_t mean, float32x4_t scale)
+{
+  uint16x8_t w = vmovl_u8 (px);
+  float32x4_t lo = vcvtq_f32_u32 (vmovl_u16 (vget_low_u16 (w)));
+  float32x4_t hi = vcvtq_f32_u32 (vmovl_u16 (vget_high_u16 (w)));
+
+  lo = vmulq_f32 (vsubq_f32 (lo, mean), scale);
+  hi = vmulq_f32 (vsubq_f32 (hi, mean), scale);
+
+  return vqmovn_s16 (vcombine_s16 (vqmovn_s32 (vcvtnq_s32_f32 (lo)),
+          vqmovn_s32 (vcvtnq_s32_f32 (hi))));
+}
+#endif
+
+/* Normalize 'n' interleaved BGR pixels into int8 */
+inline void
+NormalizeBGRRow (const uint8_t * src, int8_t * dst, int n,
+    const float mean[3], const float scale[3])
+{
+  int i = 0;
+
+#if defined(VAI_KERNELS_NEON)
+  float32x4_t m[3], s[3];
+
+  for (int c = 0; c < 3; c++) {
+    m[c] = vdupq_n_f32 (mean[c]);
+    s[c] = vdupq_n_f32 (scale[c]);
+  }
+
+  for (; i + 8 <= n; i += 8) {
+    uint8x8x3_t px = vld3_u8 (src + 3 * i);
+    int8x8x3_t out;
+
+    for (int c = 0; c < 3; c++)
+      out.val[c] = NormalizeLanes (px.val[c], m[c], s[c]);
+    vst3_s8 (dst + 3 * i, out);
+  }
+#elif defined(VAI_KERNELS_SSE2)
+  /* 48 bytes are 16 pixels and twelve float vectors.  The channel of lane
+   * 0 of vector k is k % 3, so three rotated mean/scale vectors cover
+   * the interleaving without shuffling the pixels apart. */
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128 m[3], s[3];
+
+  for (int k = 0; k < 3; k++) {
+    m[k] = _mm_setr_ps (mean[k], mean[(k + 1) % 3], mean[(k + 2) % 3],
+        mean[k]);
+    s[k] = _mm_setr_ps (scale[k], scale[(k + 1) % 3], scale[(k + 2) % 3],
+        scale[k]);
+  }
+
+  for (; i + 16 <= n; i += 16) {
+    for (int b = 0; b < 3; b++) {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (src + 3 * i + 16 * b));
+      __m128i lo = _mm_unpacklo_epi8 (v, zero);
+      __m128i hi = _mm_unpackhi_epi8 (v, zero);
+      __m128 f[4] = {
+        _mm_cvtepi32_ps (_mm_unpacklo_epi16 (lo, zero)),
+        _mm_cvtepi32_ps (_mm_unpackhi_epi16 (lo, zero)),
+        _mm_cvtepi32_ps (_mm_unpacklo_epi16 (hi, zero)),
+        _mm_cvtepi32_ps (_mm_unpackhi_epi16 (hi, zero)),
+      };
+      __m128i r[4];
+
+      for (int q = 0; q < 4; q++) {
+        int k = (4 * b + q) % 3;
+        r[q] = _mm_cvtps_epi32 (_mm_mul_ps (_mm_sub_ps (f[q], m[k]), s[k]));
+      }
+
+      _mm_storeu_si128 ((__m128i *) (dst + 3 * i + 16 * b),
+          _mm_packs_epi16 (_mm_packs_epi32 (r[0], r[1]),
+              _mm_packs_epi32 (r[2], r[3])));
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    for (int c = 0; c < 3; c++) {
+      long v = std::lrint ((src[3 * i + c] - mean[c]) * scale[c]);
+      dst[3 * i + c] = (int8_t) std::min (std::max (v, -128L), 127L);
+    }
+  }
+}
+
+/* Normalize a BGR frame into a contiguous HWC int8 tensor of
+ * rows * cols * 3 bytes.  'scale' includes the tensor's fixed-point
+ * scale, e.g. 2^fixpos / 255 for inputs normalized to [0, 1]. */
+inline void
+NormalizeBGR (const cv::Mat & img, int8_t * tensor, const float mean[3],
+    const float scale[3])
+{
+  for (int y = 0; y < img.rows; y++)
+    NormalizeBGRRow (img.ptr<uint8_t> (y), tensor + 3 * y * img.cols,
+        img.cols, mean, scale);
+}
+
+/* Set 'n' BGR pixels to one color */
+inline void
+FillBGRRow (uint8_t * dst, int n, const uint8_t bgr[3])
+{
+  int i = 0;
+
+#if defined(VAI_KERNELS_NEON)
+  uint8x16x3_t color = { { vdupq_n_u8 (bgr[0]), vdupq_n_u8 (bgr[1]),
+          vdupq_n_u8 (bgr[2]) } };
+
+  for (; i + 16 <= n; i += 16)
+    vst3q_u8 (dst + 3 * i, color);
+#elif defined(VAI_KERNELS_SSE2)
+  uint8_t pattern[48];
+  __m128i color[3];
+
+  for (int j = 0; j < 48; j++)
+    pattern[j] = bgr[j % 3];
+  for (int b = 0; b < 3; b++)
+    color[b] = _mm_loadu_si128 ((const __m128i *) (pattern + 16 * b));
+
+  for (; i + 16 <= n; i += 16)
+    for (int b = 0; b < 3; b++)
+      _mm_storeu_si128 ((__m128i *) (dst + 3 * i + 16 * b), color[b]);
+#endif
+
+  for (; i < n; i++) {
+    dst[3 * i + 0] = bgr[0];
+    dst[3 * i + 1] = bgr[1];
+    dst[3 * i + 2] = bgr[2];
+  }
+}
+
+/* Set the BGR pixels whose mask byte is non-zero to one color */
+inline void
+BlendBGRRow (uint8_t * dst, const uint8_t * mask, int n, const uint8_t bgr[3])
+{
+  int i = 0;
+
+#if defined(VAI_KERNELS_NEON)
+  uint8x16_t color[3] = { vdupq_n_u8 (bgr[0]), vdupq_n_u8 (bgr[1]),
+    vdupq_n_u8 (bgr[2]) };
+
+  for (; i + 16 <= n; i += 16) {
+    uint8x16_t m = vld1q_u8 (mask + i);
+    uint8x16x3_t px;
+
+    m = vtstq_u8 (m, m);
+    px = vld3q_u8 (dst + 3 * i);
+    for (int c = 0; c < 3; c++)
+      px.val[c] = vbslq_u8 (m, color[c], px.val[c]);
+    vst3q_u8 (dst + 3 * i, px);
+  }
+#elif defined(VAI_KERNELS_SSSE3)
+  /* Spread each mask byte over its pixel's three bytes */
+  const __m128i zero = _mm_setzero_si128 ();
+  uint8_t pattern[48], spread[48];
+  __m128i color[3], shuffle[3];
+
+  for (int j = 0; j < 48; j++) {
+    pattern[j] = bgr[j % 3];
+    spread[j] = j / 3;
+  }
+  for (int b = 0; b < 3; b++) {
+    color[b] = _mm_loadu_si128 ((const __m128i *) (pattern + 16 * b));
+    shuffle[b] = _mm_loadu_si128 ((const __m128i *) (spread + 16 * b));
+  }
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i m = _mm_loadu_si128 ((const __m128i *) (mask + i));
+
+    /* all ones where the mask is set */
+    m = _mm_xor_si128 (_mm_cmpeq_epi8 (m, zero), _mm_set1_epi8 (-1));
+    for (int b = 0; b < 3; b++) {
+      __m128i *p = (__m128i *) (dst + 3 * i + 16 * b);
+      __m128i mb = _mm_shuffle_epi8 (m, shuffle[b]);
+      __m128i px = _mm_loadu_si128 (p);
+
+      _mm_storeu_si128 (p, _mm_or_si128 (_mm_and_si128 (mb, color[b]),
+              _mm_andnot_si128 (mb, px)));
+    }
+  }
+#endif
+
+  for (; i < n; i++) {
+    if (mask[i]) {
+      dst[3 * i + 0] = bgr[0];
+      dst[3 * i + 1] = bgr[1];
+      dst[3 * i + 2] = bgr[2];
+    }
+  }
+}
+
+static inline void
+ScalarToBGR (const cv::Scalar & color, uint8_t bgr[3])
+{
+  for (int c = 0; c < 3; c++)
+    bgr[c] = (uint8_t) std::min (std::max (color[c], 0.0), 255.0);
+}
+
+/* Outline the box from (xmin, ymin) up to but excluding (xmax, ymax),
+ * 'thickness' pixels wide on the inside.  The box is clipped to the
+ * frame. */
+inline void
+DrawRect (cv::Mat img, int xmin, int ymin, int xmax, int ymax,
+    const cv::Scalar & color, int thickness = 2)
+{
+  uint8_t bgr[3];
+
+  xmin = std::max (xmin, 0);
+  ymin = std::max (ymin, 0);
+  xmax = std::min (xmax, img.cols);
+  ymax = std::min (ymax, img.rows);
+  if (xmin >= xmax || ymin >= ymax)
+    return;
+
+  ScalarToBGR (color, bgr);
+  thickness = std::max (thickness, 1);
+
+  for (int y = ymin; y < ymax; y++) {
+    uint8_t *row = img.ptr<uint8_t> (y);
+
+    if (y < ymin + thickness || y >= ymax - thickness) {
+      FillBGRRow (row + 3 * xmin, xmax - xmin, bgr);
+    } else {
+      int w = std::min (thickness, xmax - xmin);
+
+      FillBGRRow (row + 3 * xmin, w, bgr);
+      FillBGRRow (row + 3 * (xmax - w), w, bgr);
+    }
+  }
+}
+
+/* Label text drawn from cached glyph masks.  Every printable ASCII glyph
+ * is rendered once with cv::putText into its own mask; drawing a label
+ * then only blends the masks into the frame.  The atlas is immutable
+ * after construction, so one instance can be shared between threads. */
+class GlyphAtlas
+{
+public:
+  GlyphAtlas (int font = cv::FONT_HERSHEY_SIMPLEX, double scale = 1.0,
+      int thickness = 1)
+  {
+    int descent = 0;
+
+    ascent_ = 0;
+    pad_ = thickness + 1;
+    for (int c = FIRST; c <= LAST; c++) {
+      int baseline = 0;
+      cv::Size size = cv::getTextSize (std::string (1, (char) c), font, scale,
+          thickness, &baseline);
+
+      ascent_ = std::max (ascent_, size.height);
+      descent = std::max (descent, baseline);
+      glyphs_[c - FIRST].advance = std::max (size.width - thickness, 0);
+    }
+
+    for (int c = FIRST; c <= LAST; c++) {
+      Glyph & glyph = glyphs_[c - FIRST];
+
+      glyph.mask = cv::Mat::zeros (ascent_ + descent + 2 * pad_,
+          glyph.advance + 2 * pad_, CV_8UC1);
+      cv::putText (glyph.mask, std::string (1, (char) c),
+          cv::Point (pad_, ascent_ + pad_), font, scale, cv::Scalar (255),
+          thickness);
+    }
+  }
+
+  /* Draw 'text' with its baseline starting at 'org', like cv::putText */
+  void draw (cv::Mat img, const std::string & text, cv::Point org,
+      const cv::Scalar & color) const
+  {
+    uint8_t bgr[3];
+    int x = org.x;
+
+    ScalarToBGR (color, bgr);
+
+    for (unsigned char c : text) {
+      const Glyph & glyph = glyphs_[(c >= FIRST && c <= LAST ? c : '?') - FIRST];
+      int left = x - pad_;
+      int top = org.y - ascent_ - pad_;
+      int x0 = std::max (left, 0);
+      int x1 = std::min (left + glyph.mask.cols, img.cols);
+      int y0 = std::max (top, 0);
+      int y1 = std::min (top + glyph.mask.rows, img.rows);
+
+      for (int y = y0; y < y1 && x0 < x1; y++)
+        BlendBGRRow (img.ptr<uint8_t> (y) + 3 * x0,
+            glyph.mask.ptr<uint8_t> (y - top) + (x0 - left), x1 - x0, bgr);
+
+      x += glyph.advance;
+    }
+  }
+
+  /* Call fn (x, y) for every pixel 'text' covers inside a cols x rows
+   * frame, for frames that are not BGR */
+  template<class Fn>
+  void visit (const std::string & text, cv::Point org, int cols, int rows,
+      Fn fn) const
+  {
+    int x = org.x;
+
+    for (unsigned char c : text) {
+      const Glyph & glyph = glyphs_[(c >= FIRST && c <= LAST ? c : '?') - FIRST];
+      int left = x - pad_;
+      int top = org.y - ascent_ - pad_;
+
+      for (int y = std::max (top, 0);
+          y < std::min (top + glyph.mask.rows, rows); y++) {
+        const uint8_t *mask = glyph.mask.ptr<uint8_t> (y - top);
+
+        for (int mx = std::max (left, 0);
+            mx < std::min (left + glyph.mask.cols, cols); mx++)
+          if (mask[mx - left])
+            fn (mx, y);
+      }
+
+      x += glyph.advance;
+    }
+  }
+
+private:
+  enum { FIRST = ' ', LAST = '~' };
+
+  struct Glyph
+  {
+    cv::Mat mask;
+    int advance;
+  };
+
+  Glyph glyphs_[LAST - FIRST + 1];
+  int ascent_;
+  int pad_;
+};
+
+/* The atlas for the label font the plugins draw with, FONT_HERSHEY_SIMPLEX
+ * at scale 1.0 */
+inline const GlyphAtlas &
+LabelAtlas ()
+{
+  static const GlyphAtlas atlas (cv::FONT_HERSHEY_SIMPLEX, 1.0, 1);
+  return atlas;
+}
+
+#endif /* __VAIKERNELS_HPP__ */
@@ -0,0 +1,156 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * vaistats tracer - the per-frame stage split in the GstTracer log
+ *
+ *  Every plugin with a detector element registers the tracer, so
+ *
+ *    GST_TRACERS=vaistats GST_DEBUG=GST_TRACER:7 gst-launch-1.0 ...
+ *
+ *  logs one "vai-frame" record per frame and element, with the stream
+ *  (sink pad index), the PTS and the ns spent in map, preprocess, infer,
+ *  postprocess and draw.  Spikes can then be traced to a frame and a
+ *  stage without the application collecting bus messages.
+ *
+ *  The tracer has no hooks: the elements log the record themselves, and
+ *  only when the tracer was created from GST_TRACERS.  The record is kept
+ *  as qdata on the tracer type, which the plugins share, so whichever of
+ *  them registered the type first serves all of them.
+ */
+
+#ifndef __VAISTATSTRACER_HPP__
+#define __VAISTATSTRACER_HPP__
+
+#include <gst/gst.h>
+
+#include <stagetimer.hpp>
+
+#define VAI_STATS_TRACER_TYPE_NAME "GstVaiStatsTracer"
+
+typedef struct
+{
+  GstTracer parent;
+} GstVaiStatsTracer;
+
+typedef struct
+{
+  GstTracerClass parent_class;
+} GstVaiStatsTracerClass;
+
+static GstTracerRecord *vai_stats_frame_record;
+
+static GQuark
+VaiStatsTracerQuark (void)
+{
+  return g_quark_from_static_string ("vai-stats-tracer-record");
+}
+
+static GstStructure *
+VaiStatsTracerValue (GType type, const char *description)
+{
+  return gst_structure_new ("value",
+      "type", G_TYPE_GTYPE, type,
+      "description", G_TYPE_STRING, description, NULL);
+}
+
+static void
+VaiStatsTracerClassInit (GstVaiStatsTracerClass * klass)
+{
+  vai_stats_frame_record = gst_tracer_record_new ("vai-frame.class",
+      "element", GST_TYPE_STRUCTURE, gst_structure_new ("scope",
+          "type", G_TYPE_GTYPE, G_TYPE_STRING,
+          "related-to", GST_TYPE_TRACER_VALUE_SCOPE,
+          GST_TRACER_VALUE_SCOPE_ELEMENT, NULL),
+      "stream", GST_TYPE_STRUCTURE,
+      VaiStatsTracerValue (G_TYPE_UINT, "sink pad index"),
+      "pts", GST_TYPE_STRUCTURE,
+      VaiStatsTracerValue (G_TYPE_UINT64, "buffer PTS"),
+      "map", GST_TYPE_STRUCTURE,
+      VaiStatsTracerValue (G_TYPE_UINT64, "ns mapping the frame"),
+      "preprocess", GST_TYPE_STRUCTURE,
+      VaiStatsTracerValue (G_TYPE_UINT64, "ns preparing the model input"),
+      "infer", GST_TYPE_STRUCTURE,
+      VaiStatsTracerValue (G_TYPE_UINT64, "ns until the results were ready"),
+      "postprocess", GST_TYPE_STRUCTURE,
+      VaiStatsTracerValue (G_TYPE_UINT64, "ns handling the results"),
+      "draw", GST_TYPE_STRUCTURE,
+      VaiStatsTracerValue (G_TYPE_UINT64, "ns drawing into the frame"),
+      NULL);
+  GST_OBJECT_FLAG_SET (vai_stats_frame_record,
+      GST_OBJECT_FLAG_MAY_BE_LEAKED);
+}
+
+static void
+VaiStatsTracerInit (GstVaiStatsTracer * tracer)
+{
+  g_type_set_qdata (G_OBJECT_TYPE (tracer), VaiStatsTracerQuark (),
+      vai_stats_frame_record);
+}
+
+static GType
+VaiStatsTracerGetType (void)
+{
+  static const GTypeInfo info = {
+    sizeof (GstVaiStatsTracerClass), NULL, NULL,
+    (GClassInitFunc) VaiStatsTracerClassInit, NULL, NULL,
+    sizeof (GstVaiStatsTracer), 0, (GInstanceInitFunc) VaiStatsTracerInit,
+    NULL
+  };
+  GType type = g_type_from_name (VAI_STATS_TRACER_TYPE_NAME);
+
+  if (!type)
+    type = g_type_register_static (GST_TYPE_TRACER,
+        VAI_STATS_TRACER_TYPE_NAME, &info, (GTypeFlags) 0);
+
+  return type;
+}
+
+/* Call from plugin_init */
+static inline gboolean
+VaiStatsTracerRegister (GstPlugin * plugin)
+{
+  return gst_tracer_register (plugin, "vaistats", VaiStatsTracerGetType ());
+}
+
+/* The record to log when the tracer is active, NULL otherwise.  Look it up
+ * in start(), GST_TRACERS is only read by gst_init(). */
+static inline GstTracerRecord *
+VaiStatsTracerRecord (void)
+{
+  GType type = g_type_from_name (VAI_STATS_TRACER_TYPE_NAME);
+
+  return type ? (GstTracerRecord *) g_type_get_qdata (type,
+      VaiStatsTracerQuark ()) : NULL;
+}
+
+static inline void
+VaiStatsTrace (GstTracerRecord * record, GstElement * element, guint stream,
+    GstClockTime pts, const StageTimer & timer)
+{
+  gst_tracer_record_log (record, GST_OBJECT_NAME (element), stream,
+      (guint64) pts,
+      (guint64) timer.get (VAI_STAGE_MAP),
+      (guint64) timer.get (VAI_STAGE_PREPROCESS),
+      (guint64) timer.get (VAI_STAGE_INFER),
+      (guint64) timer.get (VAI_STAGE_POSTPROCESS),
+      (guint64) timer.get (VAI_STAGE_DRAW));
+}
+
+#endif /* __VAISTATSTRACER_HPP__ */
@@ -0,0 +1,234 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * yuvframe - detector input and drawing for camera formats
+ *
+ *  The detectors take NV12, YUY2 and I420 next to BGR, so no full frame
+ *  videoconvert is needed in front of them.  FrameToBGR samples the frame
+ *  straight down to the model's input size and converts only those
+ *  pixels (BT.601), which is all the runner looks at.  FrameRegionToBGR
+ *  does the same for a tile of the frame.  A BGR frame is wrapped without
+ *  a copy, as before.
+ *
+ *  Boxes and labels are drawn in the frame's own format.  The pixel
+ *  access goes through the component layout GStreamer describes for the
+ *  format, so any 8-bit YUV layout works the same way.
+ */
+
+#ifndef __YUVFRAME_HPP__
+#define __YUVFRAME_HPP__
+
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <gst/video/video.h>
+#include <opencv2/core.hpp>
+
+#include <vaikernels.hpp>
+
+static inline uint8_t
+ClampPixel (int v)
+{
+  return (uint8_t) std::min (std::max (v, 0), 255);
+}
+
+/* Limited range BT.601, as the cameras deliver it */
+static inline void
+BGRToYUV (const cv::Scalar & color, uint8_t yuv[3])
+{
+  int b = color[0], g = color[1], r = color[2];
+
+  yuv[0] = ClampPixel (16 + ((66 * r + 129 * g + 25 * b + 128) >> 8));
+  yuv[1] = ClampPixel (128 + ((-38 * r - 74 * g + 112 * b + 128) >> 8));
+  yuv[2] = ClampPixel (128 + ((112 * r - 94 * g - 18 * b + 128) >> 8));
+}
+
+static inline void
+YUVToBGR (int y, int u, int v, uint8_t * bgr)
+{
+  int c = 298 * (y - 16) + 128;
+  int d = u - 128;
+  int e = v - 128;
+
+  bgr[0] = ClampPixel ((c + 516 * d) >> 8);
+  bgr[1] = ClampPixel ((c - 100 * d - 208 * e) >> 8);
+  bgr[2] = ClampPixel ((c + 409 * e) >> 8);
+}
+
+/* Byte of component 'c' (0 = Y, 1 = U, 2 = V) for pixel (x, y) */
+static inline uint8_t *
+FrameComponent (GstVideoFrame * frame, int c, int x, int y)
+{
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+
+  return (uint8_t *) GST_VIDEO_FRAME_COMP_DATA (frame, c) +
+      (y >> GST_VIDEO_FORMAT_INFO_H_SUB (finfo, c)) *
+      GST_VIDEO_FRAME_COMP_STRIDE (frame, c) +
+      (x >> GST_VIDEO_FORMAT_INFO_W_SUB (finfo, c)) *
+      GST_VIDEO_FRAME_COMP_PSTRIDE (frame, c);
+}
+
+static inline bool
+FrameIsBGR (GstVideoFrame * frame)
+{
+  return GST_VIDEO_FRAME_FORMAT (frame) == GST_VIDEO_FORMAT_BGR;
+}
+
+/* Wrap a BGR frame in a Mat header without copying */
+static inline cv::Mat
+FrameMat (GstVideoFrame * frame)
+{
+  return cv::Mat (GST_VIDEO_FRAME_HEIGHT (frame), GST_VIDEO_FRAME_WIDTH (frame),
+      CV_8UC3, GST_VIDEO_FRAME_PLANE_DATA (frame, 0),
+      GST_VIDEO_FRAME_PLANE_STRIDE (frame, 0));
+}
+
+/* BGR image of 'region' of the frame for the runner.  A BGR frame is
+ * wrapped as it is; a YUV frame is nearest-neighbour sampled down to
+ * 'size', never up, and only the sampled pixels are converted.  An empty
+ * size keeps the region size. */
+static inline cv::Mat
+FrameRegionToBGR (GstVideoFrame * frame, const cv::Rect & region,
+    cv::Size size)
+{
+  const GstVideoFormatInfo *finfo = frame->info.finfo;
+  std::vector<int> offsets[3];
+  const uint8_t *rows[3];
+
+  if (FrameIsBGR (frame))
+    return FrameMat (frame) (region);
+
+  if (size.width <= 0 || size.height <= 0)
+    size = region.size ();
+  size.width = std::min (size.width, region.width);
+  size.height = std::min (size.height, region.height);
+
+  /* Byte offset of every sampled column in each component row */
+  for (int c = 0; c < 3; c++) {
+    offsets[c].resize (size.width);
+    for (int tx = 0; tx < size.width; tx++) {
+      int sx = region.x + (2 * tx + 1) * region.width / (2 * size.width);
+      offsets[c][tx] = (sx >> GST_VIDEO_FORMAT_INFO_W_SUB (finfo, c)) *
+          GST_VIDEO_FRAME_COMP_PSTRIDE (frame, c);
+    }
+  }
+
+  cv::Mat img (size, CV_8UC3);
+
+  for (int ty = 0; ty < size.height; ty++) {
+    int sy = region.y + (2 * ty + 1) * region.height / (2 * size.height);
+    uint8_t *dst = img.ptr<uint8_t> (ty);
+
+    for (int c = 0; c < 3; c++)
+      rows[c] = FrameComponent (frame, c, 0, sy);
+
+    for (int tx = 0; tx < size.width; tx++)
+      YUVToBGR (rows[0][offsets[0][tx]], rows[1][offsets[1][tx]],
+          rows[2][offsets[2][tx]], dst + 3 * tx);
+  }
+
+  return img;
+}
+
+/* BGR image of the whole frame for the runner, see FrameRegionToBGR */
+static inline cv::Mat
+FrameToBGR (GstVideoFrame * frame, cv::Size size)
+{
+  return FrameRegionToBGR (frame, cv::Rect (0, 0,
+          GST_VIDEO_FRAME_WIDTH (frame), GST_VIDEO_FRAME_HEIGHT (frame)),
+      size);
+}
+
+static inline void
+PutYUV (GstVideoFrame * frame, int x, int y, const uint8_t yuv[3])
+{
+  for (int c = 0; c < 3; c++)
+    *FrameComponent (frame, c, x, y) = yuv[c];
+}
+
+/* DrawRect for a frame in any of the detector formats */
+static inline void
+DrawRectFrame (GstVideoFrame * frame, int xmin, int ymin, int xmax, int ymax,
+    const cv::Scalar & color, int thickness = 2)
+{
+  uint8_t yuv[3];
+
+  if (FrameIsBGR (frame)) {
+    DrawRect (FrameMat (frame), xmin, ymin, xmax, ymax, color, thickness);
+    return;
+  }
+
+  xmin = std::max (xmin, 0);
+  ymin = std::max (ymin, 0);
+  xmax = std::min (xmax, (int) GST_VIDEO_FRAME_WIDTH (frame));
+  ymax = std::min (ymax, (int) GST_VIDEO_FRAME_HEIGHT (frame));
+  thickness = std::max (thickness, 1);
+  BGRToYUV (color, yuv);
+
+  for (int y = ymin; y < ymax; y++) {
+    bool edge = y < ymin + thickness || y >= ymax - thickness;
+
+    for (int x = xmin; x < xmax; x++) {
+      if (edge || x < xmin + thickness || x >= xmax - thickness)
+        PutYUV (frame, x, y, yuv);
+      else
+        x = xmax - thickness - 1;     /* skip the inside of the box */
+    }
+  }
+}
+
+/* LabelAtlas ().draw for a frame in any of the detector formats */
+static inline void
+DrawLabelFrame (GstVideoFrame * frame, const std::string & text,
+    cv::Point org, const cv::Scalar & color)
+{
+  uint8_t yuv[3];
+
+  if (FrameIsBGR (frame)) {
+    LabelAtlas ().draw (FrameMat (frame), text, org, color);
+    return;
+  }
+
+  BGRToYUV (color, yuv);
+  LabelAtlas ().visit (text, org, GST_VIDEO_FRAME_WIDTH (frame),
+      GST_VIDEO_FRAME_HEIGHT (frame), [frame, &yuv] (int x, int y) {
+        PutYUV (frame, x, y, yuv);
+      });
+}
+
+/* DrawBoxes for a frame in any of the detector formats */
+template<class T>
+void DrawBoxesFrame( GstVideoFrame * frame, const T & results,
+    cv::Scalar color = cv::Scalar(0, 255, 0))
+{
+  int cols = GST_VIDEO_FRAME_WIDTH (frame);
+  int rows = GST_VIDEO_FRAME_HEIGHT (frame);
+
+  for (auto &box : results)
+  {
+    int xmin = box.x * cols;
+    int ymin = box.y * rows;
+
+    DrawRectFrame(frame, xmin, ymin, xmin + (box.width * cols),
+        ymin + (box.height * rows), color, 2);
+  }
+}
+
+#endif /* __YUVFRAME_HPP__ */
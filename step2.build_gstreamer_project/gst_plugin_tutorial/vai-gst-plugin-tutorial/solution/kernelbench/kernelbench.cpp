@@ -0,0 +1,140 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * kernelbench - times the vaikernels against the OpenCV calls they replace
+ *
+ *  Usage: kernelbench [width height [iterations]]
+ *
+ *  Every kernel runs on the same synthetic frame as its OpenCV
+ *  counterpart; the output is the mean time per call of both and the
+ *  speedup.  The normalization results are also compared, since both
+ *  paths must produce the same tensor.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <vaikernels.hpp>
+
+typedef std::chrono::steady_clock Clock;
+
+/* Mean microseconds per call of 'fn' over 'iterations' calls */
+static double
+Time (int iterations, const std::function<void ()> & fn)
+{
+  fn ();                        /* warm up caches and lazy init */
+
+  auto start = Clock::now ();
+  for (int i = 0; i < iterations; i++)
+    fn ();
+  std::chrono::duration<double, std::micro> elapsed = Clock::now () - start;
+
+  return elapsed.count () / iterations;
+}
+
+static void
+Report (const char *name, double opencv, double kernel)
+{
+  printf ("%-22s %10.1f us %10.1f us %8.2fx\n", name, opencv, kernel,
+      opencv / kernel);
+}
+
+int
+main (int argc, char *argv[])
+{
+  int width = argc > 2 ? atoi (argv[1]) : 640;
+  int height = argc > 2 ? atoi (argv[2]) : 360;
+  int iterations = argc > 3 ? atoi (argv[3]) : 200;
+  const float mean[3] = { 104.0f, 117.0f, 123.0f };
+  const float scale[3] = { 0.5f, 0.5f, 0.5f };
+  const char *label = "person 0.87";
+
+  if (width <= 0 || height <= 0 || iterations <= 0) {
+    fprintf (stderr, "usage: %s [width height [iterations]]\n", argv[0]);
+    return 1;
+  }
+
+  cv::Mat frame (height, width, CV_8UC3);
+  cv::randu (frame, cv::Scalar::all (0), cv::Scalar::all (255));
+  cv::Mat img = frame.clone ();
+
+  /* Boxes spread over the frame, like a busy detection result */
+  std::vector<cv::Rect> boxes;
+  for (int i = 0; i < 16; i++)
+    boxes.push_back (cv::Rect ((i % 4) * width / 4 + 4, (i / 4) * height / 4 + 4,
+            width / 5, height / 5));
+
+  printf ("kernelbench: %dx%d, %d iterations, %s kernels\n\n", width, height,
+      iterations, VaiKernelsPath ());
+  printf ("%-22s %13s %13s %9s\n", "kernel", "opencv", "vaikernels",
+      "speedup");
+
+  /* BGR normalization into an int8 tensor */
+  cv::Mat fp, ref;
+  std::vector<int8_t> tensor (width * height * 3);
+  double opencv = Time (iterations, [&] {
+        frame.convertTo (fp, CV_32FC3);
+        cv::subtract (fp, cv::Scalar (mean[0], mean[1], mean[2]), fp);
+        cv::multiply (fp, cv::Scalar (scale[0], scale[1], scale[2]), fp);
+        fp.convertTo (ref, CV_8SC3);
+      });
+  double kernel = Time (iterations, [&] {
+        NormalizeBGR (frame, tensor.data (), mean, scale);
+      });
+  Report ("normalize bgr->int8", opencv, kernel);
+
+  int mismatches = 0;
+  for (int y = 0; y < height; y++)
+    for (int x = 0; x < width * 3; x++)
+      mismatches += ref.ptr<int8_t> (y)[x] != tensor[y * width * 3 + x];
+
+  /* Box outlines */
+  opencv = Time (iterations, [&] {
+        for (auto &box : boxes)
+          cv::rectangle (img, box, cv::Scalar (0, 255, 0), 2, 1, 0);
+      });
+  kernel = Time (iterations, [&] {
+        for (auto &box : boxes)
+          DrawRect (img, box.x, box.y, box.x + box.width, box.y + box.height,
+              cv::Scalar (0, 255, 0), 2);
+      });
+  Report ("16 rectangles", opencv, kernel);
+
+  /* Labels */
+  opencv = Time (iterations, [&] {
+        for (auto &box : boxes)
+          cv::putText (img, label, box.tl (), cv::FONT_HERSHEY_SIMPLEX, 1.0,
+              cv::Scalar (0, 255, 0), 1);
+      });
+  kernel = Time (iterations, [&] {
+        for (auto &box : boxes)
+          LabelAtlas ().draw (img, label, box.tl (), cv::Scalar (0, 255, 0));
+      });
+  Report ("16 labels", opencv, kernel);
+
+  printf ("\nnormalize mismatches: %d\n", mismatches);
+
+  return mismatches ? 1 : 0;
+}
@@ -0,0 +1,470 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * vaibench - per-frame overhead of the detection plugins, without a DPU
+ *
+ *  Runs vaidetect, or vaimultidetect for several streams or batching,
+ *  with the mock model-type between appsrc and fakesink:
+ *
+ *    appsrc ! vaidetect model-type=mock model=<latency-us> ! fakesink
+ *
+ *  Every stream is fed synthetic frames as fast as the element takes them.
+ *  The element posts a vai-frame-timing message per frame, from which the
+ *  latency of the map, preprocess, infer, postprocess and draw stages is
+ *  summarized for every resolution, stream count and batch size asked
+ *  for, next to the throughput.
+ *
+ *  The plugin is found through GST_PLUGIN_PATH; "make run" sets it to the
+ *  vaidetect directory.  With --budget-us the exit status tells whether
+ *  the p95 overhead outside of inference stayed within budget, for CI.
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <gst/gst.h>
+#include <gst/app/gstappsrc.h>
+#include <gst/video/video.h>
+
+#include <stagetimer.hpp>
+
+/* Stage latencies of one run, filled from the bus sync handler */
+class Collector
+{
+public:
+  void add (const GstStructure * s)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+
+    for (int stage = 0; stage < VAI_STAGE_COUNT; stage++) {
+      guint64 ns = 0;
+
+      gst_structure_get_uint64 (s, StageTimer::name ((VaiStage) stage), &ns);
+      samples_[stage].push_back (ns);
+    }
+  }
+
+  /* Sorted latencies of one stage, or of all stages but infer */
+  std::vector<guint64> sorted (int stage)
+  {
+    std::lock_guard<std::mutex> lock (mutex_);
+    std::vector<guint64> out;
+
+    if (stage >= 0) {
+      out = samples_[stage];
+    } else if (!samples_[0].empty ()) {
+      out.assign (samples_[0].size (), 0);
+      for (int s = 0; s < VAI_STAGE_COUNT; s++)
+        if (s != VAI_STAGE_INFER)
+          for (size_t i = 0; i < out.size (); i++)
+            out[i] += samples_[s][i];
+    }
+
+    std::sort (out.begin (), out.end ());
+    return out;
+  }
+
+private:
+  std::mutex mutex_;
+  std::vector<guint64> samples_[VAI_STAGE_COUNT];
+};
+
+struct Config
+{
+  int width;
+  int height;
+  guint streams;
+  guint batch;
+};
+
+struct Result
+{
+  gboolean ok;
+  guint64 frames;
+  double seconds;
+};
+
+/* Options */
+static gchar *resolutions = g_strdup ("640x360,1280x720,1920x1080");
+static gchar *stream_counts = g_strdup ("1,4");
+static gchar *batch_sizes = g_strdup ("1,4");
+static gchar *format_name = g_strdup ("BGR");
+static gint frames = 300;
+static gint latency_us = 5000;
+static gboolean meta = FALSE;
+static gboolean histogram = FALSE;
+static gboolean csv = FALSE;
+static gint budget_us = 0;
+
+static GOptionEntry entries[] = {
+  {"resolutions", 'r', 0, G_OPTION_ARG_STRING, &resolutions,
+      "Comma separated frame sizes", "WxH,..."},
+  {"streams", 's', 0, G_OPTION_ARG_STRING, &stream_counts,
+      "Comma separated stream counts", "N,..."},
+  {"batch-sizes", 'b', 0, G_OPTION_ARG_STRING, &batch_sizes,
+      "Comma separated batch sizes", "N,..."},
+  {"format", 'f', 0, G_OPTION_ARG_STRING, &format_name,
+      "Frame format: BGR, NV12, YUY2 or I420", "FORMAT"},
+  {"frames", 'n', 0, G_OPTION_ARG_INT, &frames,
+      "Frames per stream", "N"},
+  {"latency-us", 'l', 0, G_OPTION_ARG_INT, &latency_us,
+      "Mock inference latency per run call", "US"},
+  {"meta", 'm', 0, G_OPTION_ARG_NONE, &meta,
+      "Attach ROI meta instead of drawing", NULL},
+  {"histogram", 'H', 0, G_OPTION_ARG_NONE, &histogram,
+      "Print a log2 histogram of every stage", NULL},
+  {"csv", 0, 0, G_OPTION_ARG_NONE, &csv,
+      "Print one CSV line per configuration", NULL},
+  {"budget-us", 0, 0, G_OPTION_ARG_INT, &budget_us,
+      "Fail when the p95 overhead outside inference exceeds this", "US"},
+  {NULL}
+};
+
+static std::vector<int>
+ParseList (const gchar * list)
+{
+  std::vector<int> out;
+  gchar **items = g_strsplit (list, ",", -1);
+
+  for (gchar ** item = items; *item; item++)
+    if (atoi (*item) > 0)
+      out.push_back (atoi (*item));
+  g_strfreev (items);
+
+  return out;
+}
+
+static std::vector<std::pair<int, int>>
+ParseResolutions (const gchar * list)
+{
+  std::vector<std::pair<int, int>> out;
+  gchar **items = g_strsplit (list, ",", -1);
+
+  for (gchar ** item = items; *item; item++) {
+    int w, h;
+
+    if (sscanf (*item, "%dx%d", &w, &h) == 2 && w > 0 && h > 0)
+      out.push_back (std::make_pair (w, h));
+  }
+  g_strfreev (items);
+
+  return out;
+}
+
+/* A frame with some structure, so the drawing and conversion touch
+ * realistic data */
+static GstBuffer *
+MakeFrame (const GstVideoInfo * info)
+{
+  GstBuffer *buf = gst_buffer_new_allocate (NULL, GST_VIDEO_INFO_SIZE (info),
+      NULL);
+  GstMapInfo map;
+
+  gst_buffer_map (buf, &map, GST_MAP_WRITE);
+  for (gsize i = 0; i < map.size; i++)
+    map.data[i] = (guint8) ((i * 7) ^ (i >> 9));
+  gst_buffer_unmap (buf, &map);
+
+  return buf;
+}
+
+struct Feeder
+{
+  GstAppSrc *src;
+  GstBuffer *frame;
+  GstClockTime duration;
+};
+
+/* Push the frames of one stream as fast as appsrc takes them */
+static gpointer
+Feed (gpointer data)
+{
+  Feeder *feeder = (Feeder *) data;
+
+  for (gint i = 0; i < frames; i++) {
+    GstBuffer *buf = gst_buffer_copy_deep (feeder->frame);
+
+    GST_BUFFER_PTS (buf) = i * feeder->duration;
+    GST_BUFFER_DURATION (buf) = feeder->duration;
+    if (gst_app_src_push_buffer (feeder->src, buf) != GST_FLOW_OK)
+      break;
+  }
+  gst_app_src_end_of_stream (feeder->src);
+
+  return NULL;
+}
+
+static GstBusSyncReply
+OnMessage (GstBus * bus, GstMessage * msg, gpointer data)
+{
+  const GstStructure *s = gst_message_get_structure (msg);
+
+  if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ELEMENT &&
+      gst_structure_has_name (s, "vai-frame-timing")) {
+    ((Collector *) data)->add (s);
+    gst_message_unref (msg);
+    return GST_BUS_DROP;
+  }
+
+  return GST_BUS_PASS;
+}
+
+static std::string
+PipelineDescription (const Config & config)
+{
+  gchar *desc;
+  std::string out;
+
+  if (config.streams == 1 && config.batch == 1) {
+    desc = g_strdup_printf ("appsrc name=src0 ! vaidetect model-type=mock "
+        "model=%d timing=true draw=%s ! fakesink sync=false", latency_us,
+        meta ? "false" : "true");
+    out = desc;
+    g_free (desc);
+    return out;
+  }
+
+  desc = g_strdup_printf ("vaimultidetect name=det model-type=mock model=%d "
+      "batch-size=%u timing=true draw=%s", latency_us, config.batch,
+      meta ? "false" : "true");
+  out = desc;
+  g_free (desc);
+
+  for (guint i = 0; i < config.streams; i++) {
+    desc = g_strdup_printf (" appsrc name=src%u ! det.sink_%u "
+        "det.src_%u ! fakesink sync=false", i, i, i);
+    out += desc;
+    g_free (desc);
+  }
+
+  return out;
+}
+
+static Result
+Run (const Config & config, GstVideoFormat format, Collector * collector)
+{
+  Result result = { FALSE, 0, 0.0 };
+  std::string description = PipelineDescription (config);
+  std::vector<Feeder> feeders (config.streams);
+  std::vector<GThread *> threads;
+  GstVideoInfo info;
+  GError *error = NULL;
+  GstElement *pipeline;
+  GstMessage *msg;
+  GstCaps *caps;
+  GstBus *bus;
+  gint64 start;
+
+  pipeline = gst_parse_launch (description.c_str (), &error);
+  if (!pipeline) {
+    g_printerr ("%s: %s\n", description.c_str (), error->message);
+    g_clear_error (&error);
+    return result;
+  }
+
+  gst_video_info_set_format (&info, format, config.width, config.height);
+  info.fps_n = 30;
+  info.fps_d = 1;
+  caps = gst_video_info_to_caps (&info);
+
+  for (guint i = 0; i < config.streams; i++) {
+    gchar *name = g_strdup_printf ("src%u", i);
+    GstElement *src = gst_bin_get_by_name (GST_BIN (pipeline), name);
+
+    g_object_set (src, "caps", caps, "format", GST_FORMAT_TIME,
+        "block", TRUE, "max-bytes", (guint64) 4 * GST_VIDEO_INFO_SIZE (&info),
+        NULL);
+    feeders[i].src = GST_APP_SRC (src);
+    feeders[i].frame = MakeFrame (&info);
+    feeders[i].duration = gst_util_uint64_scale_int (GST_SECOND, 1, 30);
+    g_free (name);
+  }
+  gst_caps_unref (caps);
+
+  bus = gst_element_get_bus (pipeline);
+  gst_bus_set_sync_handler (bus, OnMessage, collector, NULL);
+
+  start = g_get_monotonic_time ();
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE) {
+    for (guint i = 0; i < config.streams; i++)
+      threads.push_back (g_thread_new ("feeder", Feed, &feeders[i]));
+
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+        (GstMessageType) (GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    result.seconds = (g_get_monotonic_time () - start) / 1e6;
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+      gst_message_parse_error (msg, &error, NULL);
+      g_printerr ("%s: %s\n", GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)),
+          error->message);
+      g_clear_error (&error);
+    } else {
+      result.ok = TRUE;
+    }
+    gst_message_unref (msg);
+  }
+
+  /* Stopping unblocks feeders that are still pushing after an error */
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  for (auto thread : threads)
+    g_thread_join (thread);
+  for (auto &feeder : feeders) {
+    gst_buffer_unref (feeder.frame);
+    gst_object_unref (feeder.src);
+  }
+  gst_bus_set_sync_handler (bus, NULL, NULL, NULL);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  result.frames = collector->sorted (VAI_STAGE_MAP).size ();
+  return result;
+}
+
+static double
+Percentile (const std::vector<guint64> & sorted, double p)
+{
+  if (sorted.empty ())
+    return 0.0;
+
+  return sorted[std::min (sorted.size () - 1,
+          (size_t) (p * sorted.size ()))] / 1000.0;
+}
+
+static void
+PrintHistogram (const std::vector<guint64> & sorted)
+{
+  std::map<int, size_t> buckets;
+
+  for (auto ns : sorted)
+    buckets[g_bit_storage (ns / 1000)]++;
+
+  for (auto &bucket : buckets) {
+    int bar = (int) (50 * bucket.second / sorted.size ());
+
+    printf ("      < %8lu us %8zu %s\n", 1UL << bucket.first, bucket.second,
+        std::string (std::max (bar, 1), '#').c_str ());
+  }
+}
+
+static void
+Report (const Config & config, const Result & result, Collector * collector)
+{
+  static const char *total = "overhead";
+  double fps = result.seconds > 0 ? result.frames / result.seconds : 0.0;
+
+  if (csv) {
+    printf ("%dx%d,%u,%u,%s,%.1f", config.width, config.height,
+        config.streams, config.batch, format_name, fps);
+    for (int stage = -1; stage < VAI_STAGE_COUNT; stage++) {
+      auto sorted = collector->sorted (stage);
+      printf (",%.1f,%.1f,%.1f", Percentile (sorted, 0.5),
+          Percentile (sorted, 0.95), Percentile (sorted, 0.99));
+    }
+    printf ("\n");
+    return;
+  }
+
+  printf ("\n%dx%d %s, %u stream(s), batch %u: %lu frames in %.2f s, "
+      "%.1f fps\n", config.width, config.height, format_name, config.streams,
+      config.batch, (unsigned long) result.frames, result.seconds, fps);
+  printf ("    %-12s %10s %10s %10s %10s\n", "stage (us)", "p50", "p95",
+      "p99", "max");
+
+  for (int stage = 0; stage <= VAI_STAGE_COUNT; stage++) {
+    int index = stage < VAI_STAGE_COUNT ? stage : -1;
+    auto sorted = collector->sorted (index);
+
+    printf ("    %-12s %10.1f %10.1f %10.1f %10.1f\n",
+        index >= 0 ? StageTimer::name ((VaiStage) index) : total,
+        Percentile (sorted, 0.5), Percentile (sorted, 0.95),
+        Percentile (sorted, 0.99), Percentile (sorted, 1.0));
+    if (histogram && !sorted.empty ())
+      PrintHistogram (sorted);
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  GOptionContext *context;
+  GError *error = NULL;
+  GstVideoFormat format;
+  gboolean ok = TRUE;
+
+  context = g_option_context_new ("- benchmark the detection plugins");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+  g_option_context_free (context);
+
+  format = gst_video_format_from_string (format_name);
+  if (format == GST_VIDEO_FORMAT_UNKNOWN || frames <= 0) {
+    g_printerr ("invalid format or frame count\n");
+    return 2;
+  }
+
+  if (csv) {
+    printf ("resolution,streams,batch,format,fps");
+    for (int stage = -1; stage < VAI_STAGE_COUNT; stage++) {
+      const char *name = stage < 0 ? "overhead" :
+          StageTimer::name ((VaiStage) stage);
+      printf (",%s_p50,%s_p95,%s_p99", name, name, name);
+    }
+    printf ("\n");
+  } else {
+    printf ("vaibench: %d frames per stream, mock inference %d us, %s\n",
+        frames, latency_us, meta ? "meta" : "draw");
+  }
+
+  for (auto &res : ParseResolutions (resolutions)) {
+    for (int streams : ParseList (stream_counts)) {
+      for (int batch : ParseList (batch_sizes)) {
+        Config config = { res.first, res.second, (guint) streams,
+          (guint) batch };
+        Collector collector;
+        Result result = Run (config, format, &collector);
+
+        if (!result.ok) {
+          ok = FALSE;
+          continue;
+        }
+
+        Report (config, result, &collector);
+
+        if (budget_us > 0 &&
+            Percentile (collector.sorted (-1), 0.95) > budget_us) {
+          g_printerr ("%dx%d, %d stream(s), batch %d: p95 overhead over "
+              "the %d us budget\n", res.first, res.second, streams, batch,
+              budget_us);
+          ok = FALSE;
+        }
+      }
+    }
+  }
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,648 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * SECTION:element-gstvaidetect
+ *
+ * The vaidetect element runs any supported detection model.  model-type
+ * picks the backend (tfssd, ssd, facedetect, cpu-stub or mock) and model
+ * names the Vitis-AI-Library model it loads, so one element covers what
+ * vaitfssd, vaipersondetect and vaifacedetect do.
+ *
+ * <refsect2>
+ * <title>Person detection with the Vitis-AI-Library</title>
+ * |[
+ * gst-launch-1.0 -v v4l2src ! video/x-raw, format=BGR ! \
+ *     vaidetect model-type=ssd model=ssd_pedestrain_pruned_0_97 ! \
+ *     autovideosink
+ * ]|
+ * </refsect2>
+ * <refsect2>
+ * <title>Running without a DPU</title>
+ * |[
+ * gst-launch-1.0 -v videotestsrc ! video/x-raw, format=BGR ! \
+ *     vaidetect model-type=cpu-stub ! fakesink
+ * ]|
+ * </refsect2>
+ *
+ * Besides BGR the element takes NV12, YUY2 and I420 straight from the
+ * camera; only the model input is converted.  With the mock model-type the
+ * model property is the simulated inference latency in microseconds,
+ * which together with the timing property is what the vaibench harness
+ * uses to measure the element apart from the DPU.
+ *
+ * The latency-p50, latency-p95 and latency-p99 properties give the time
+ * per stage over the last frames at any time; with stats-interval set the
+ * same is posted as a vai-stats element message, and the vaistats tracer
+ * logs every frame's split:
+ * |[
+ * GST_TRACERS=vaistats GST_DEBUG=GST_TRACER:7 gst-launch-1.0 ...
+ * ]|
+ *
+ * Upstream is offered a pool of dmabuf frames, which elements that fill
+ * downstream buffers write into directly; frames are mapped for writing
+ * only when there are boxes to draw.  The pool uses /dev/udmabuf, or plain
+ * memfds without it, so it also works off the board:
+ * |[
+ * GST_DEBUG=vaidetect:5 gst-launch-1.0 videotestsrc ! \
+ *     video/x-raw, format=NV12 ! vaidetect model-type=cpu-stub ! fakesink
+ * ]|
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+#include "gstvaidetect.h"
+#include "gstvaimultidetect.h"
+
+/* OpenCV header files */
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Header file for attaching detections as region of interest meta */
+#include <roimeta.hpp>
+
+/* Header file for the dmabuf pool offered upstream */
+#include <dmabufpool.hpp>
+
+/* Header files for YUV input and drawing, and per-stage timing */
+#include <yuvframe.hpp>
+#include <stagetimer.hpp>
+#include <vaistatstracer.hpp>
+
+GST_DEBUG_CATEGORY_STATIC (gst_vaidetect_debug_category);
+#define GST_CAT_DEFAULT gst_vaidetect_debug_category
+
+/* prototypes */
+static void gst_vaidetect_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vaidetect_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vaidetect_finalize (GObject * object);
+
+static gboolean gst_vaidetect_start (GstBaseTransform * trans);
+static gboolean gst_vaidetect_stop (GstBaseTransform * trans);
+static gboolean gst_vaidetect_propose_allocation (GstBaseTransform * trans,
+    GstQuery * decide_query, GstQuery * query);
+static GstFlowReturn gst_vaidetect_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
+static GstFlowReturn gst_vaidetect_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_vaidetect_generate_output (GstBaseTransform * trans,
+    GstBuffer ** outbuf);
+static gboolean gst_vaidetect_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_vaidetect_src_event (GstBaseTransform * trans,
+    GstEvent * event);
+
+enum
+{
+  PROP_0,
+  PROP_MODEL,
+  PROP_MODEL_TYPE,
+  PROP_DRAW,
+  PROP_LEAKY_INFERENCE,
+  PROP_MAX_LATENESS,
+  PROP_TIMING,
+  PROP_STATS_INTERVAL,
+  PROP_LATENCY_P50,
+  PROP_LATENCY_P95,
+  PROP_LATENCY_P99
+};
+
+#ifdef VAIDETECT_CPU_ONLY
+#define DEFAULT_MODEL ""
+#define DEFAULT_MODEL_TYPE "cpu-stub"
+#else
+#define DEFAULT_MODEL "ssd_pedestrain_pruned_0_97"
+#define DEFAULT_MODEL_TYPE "ssd"
+#endif
+#define DEFAULT_DRAW TRUE
+#define DEFAULT_LEAKY_INFERENCE FALSE
+#define DEFAULT_MAX_LATENESS (100 * GST_MSECOND)
+#define DEFAULT_TIMING FALSE
+#define DEFAULT_STATS_INTERVAL 0
+
+/* pad templates */
+
+/* Input format */
+#define VIDEO_SRC_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
+
+/* Output format */
+#define VIDEO_SINK_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
+
+
+/* Run the backend, or for a late frame in leaky mode hand out the last
+ * detections again */
+static std::vector<Detection>
+gst_vaidetect_detect (GstVaidetect * vaidetect, const cv::Mat & img)
+{
+  if (vaidetect->late)
+    return *vaidetect->last;
+
+  *vaidetect->last = vaidetect->backend->run(img);
+  return *vaidetect->last;
+}
+
+/* Draw bounding boxes and their class in the frame's own format */
+static void
+gst_vaidetect_draw (GstVaidetect * vaidetect, GstVideoFrame * frame,
+    const std::vector<Detection> & results)
+{
+  DetectBackend *backend = vaidetect->backend;
+
+  DrawBoxesFrame(frame, results);
+  for (auto &box : results)
+    DrawLabelFrame(frame, backend->label(box.label),
+        cv::Point(box.x * GST_VIDEO_FRAME_WIDTH(frame),
+            box.y * GST_VIDEO_FRAME_HEIGHT(frame)), cv::Scalar(0, 255, 0));
+}
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVaidetect, gst_vaidetect, GST_TYPE_VIDEO_FILTER,
+  GST_DEBUG_CATEGORY_INIT (gst_vaidetect_debug_category, "vaidetect", 0,
+  "debug category for vaidetect element"));
+
+static void
+gst_vaidetect_class_init (GstVaidetectClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *base_transform_class = GST_BASE_TRANSFORM_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS(klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+        gst_caps_from_string (VIDEO_SRC_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS(klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+        gst_caps_from_string (VIDEO_SINK_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS(klass),
+      "Object detection using the Vitis-AI-Library",
+      "Video Filter",
+      "Object Detection with a selectable model",
+      "Tom Simpson @ AVNET");
+
+  gobject_class->set_property = gst_vaidetect_set_property;
+  gobject_class->get_property = gst_vaidetect_get_property;
+  gobject_class->finalize = gst_vaidetect_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_MODEL,
+      g_param_spec_string ("model", "Model",
+          "Name of the model the backend loads", DEFAULT_MODEL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_MODEL_TYPE,
+      g_param_spec_string ("model-type", "Model type",
+          "Backend that runs the model, one of the types registered by the "
+          "plugin (tfssd, ssd, facedetect, cpu-stub, mock)", DEFAULT_MODEL_TYPE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_DRAW,
+      g_param_spec_boolean ("draw", "Draw",
+          "Draw the detections into the frame; when disabled they are "
+          "attached as GstVideoRegionOfInterestMeta and the frame is left "
+          "untouched", DEFAULT_DRAW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_LEAKY_INFERENCE,
+      g_param_spec_boolean ("leaky-inference", "Leaky inference",
+          "Pass late frames through with the last known detections instead "
+          "of dropping them", DEFAULT_LEAKY_INFERENCE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_MAX_LATENESS,
+      g_param_spec_int64 ("max-lateness", "Max lateness",
+          "How far behind the clock a frame from a live source may fall "
+          "before it counts as late (in ns, -1 = only upstream QoS events)",
+          -1, G_MAXINT64, DEFAULT_MAX_LATENESS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_TIMING,
+      g_param_spec_boolean ("timing", "Timing",
+          "Post a vai-frame-timing element message with the time spent in "
+          "each stage for every frame", DEFAULT_TIMING,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint64 ("stats-interval", "Stats interval",
+          "Post a vai-stats element message with the latency percentiles "
+          "of every stage this often (in ns, 0 = never)", 0, G_MAXUINT64,
+          DEFAULT_STATS_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P50,
+      g_param_spec_boxed ("latency-p50", "Latency p50",
+          "Median time spent in each stage over the last frames (in ns)",
+          GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P95,
+      g_param_spec_boxed ("latency-p95", "Latency p95",
+          "95th percentile of the time spent in each stage over the last "
+          "frames (in ns)", GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P99,
+      g_param_spec_boxed ("latency-p99", "Latency p99",
+          "99th percentile of the time spent in each stage over the last "
+          "frames (in ns)", GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_vaidetect_start);
+  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vaidetect_stop);
+  base_transform_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_vaidetect_propose_allocation);
+  base_transform_class->submit_input_buffer =
+      GST_DEBUG_FUNCPTR (gst_vaidetect_submit_input_buffer);
+  base_transform_class->generate_output =
+      GST_DEBUG_FUNCPTR (gst_vaidetect_generate_output);
+  base_transform_class->sink_event = GST_DEBUG_FUNCPTR (gst_vaidetect_sink_event);
+  base_transform_class->src_event = GST_DEBUG_FUNCPTR (gst_vaidetect_src_event);
+  base_transform_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_vaidetect_transform_ip);
+}
+
+static void
+gst_vaidetect_init (GstVaidetect *vaidetect)
+{
+  vaidetect->model = g_strdup (DEFAULT_MODEL);
+  vaidetect->model_type = g_strdup (DEFAULT_MODEL_TYPE);
+  vaidetect->draw = DEFAULT_DRAW;
+  vaidetect->leaky_inference = DEFAULT_LEAKY_INFERENCE;
+  vaidetect->max_lateness = DEFAULT_MAX_LATENESS;
+  vaidetect->timing = DEFAULT_TIMING;
+  vaidetect->backend = NULL;
+  vaidetect->qos = NULL;
+  vaidetect->late = FALSE;
+  vaidetect->last = NULL;
+  vaidetect->stats_interval = DEFAULT_STATS_INTERVAL;
+  vaidetect->stats = new StageStats ();
+  vaidetect->trace = NULL;
+  vaidetect->dmabuf = FALSE;
+
+  /* DetectQos decides which late frames to drop; the base class would
+   * drop them too, leaky-inference or not */
+  gst_base_transform_set_qos_enabled (GST_BASE_TRANSFORM (vaidetect), FALSE);
+}
+
+void
+gst_vaidetect_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (object);
+
+  GST_DEBUG_OBJECT (vaidetect, "set_property");
+
+  switch (property_id) {
+    case PROP_MODEL:
+      g_free (vaidetect->model);
+      vaidetect->model = g_value_dup_string (value);
+      break;
+    case PROP_MODEL_TYPE:
+      g_free (vaidetect->model_type);
+      vaidetect->model_type = g_value_dup_string (value);
+      break;
+    case PROP_DRAW:
+      vaidetect->draw = g_value_get_boolean (value);
+      break;
+    case PROP_LEAKY_INFERENCE:
+      vaidetect->leaky_inference = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_LATENESS:
+      vaidetect->max_lateness = g_value_get_int64 (value);
+      break;
+    case PROP_TIMING:
+      vaidetect->timing = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      vaidetect->stats_interval = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vaidetect_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (object);
+
+  GST_DEBUG_OBJECT (vaidetect, "get_property");
+
+  switch (property_id) {
+    case PROP_MODEL:
+      g_value_set_string (value, vaidetect->model);
+      break;
+    case PROP_MODEL_TYPE:
+      g_value_set_string (value, vaidetect->model_type);
+      break;
+    case PROP_DRAW:
+      g_value_set_boolean (value, vaidetect->draw);
+      break;
+    case PROP_LEAKY_INFERENCE:
+      g_value_set_boolean (value, vaidetect->leaky_inference);
+      break;
+    case PROP_MAX_LATENESS:
+      g_value_set_int64 (value, vaidetect->max_lateness);
+      break;
+    case PROP_TIMING:
+      g_value_set_boolean (value, vaidetect->timing);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint64 (value, vaidetect->stats_interval);
+      break;
+    case PROP_LATENCY_P50:
+      g_value_take_boxed (value, vaidetect->stats->latency (0.50));
+      break;
+    case PROP_LATENCY_P95:
+      g_value_take_boxed (value, vaidetect->stats->latency (0.95));
+      break;
+    case PROP_LATENCY_P99:
+      g_value_take_boxed (value, vaidetect->stats->latency (0.99));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vaidetect_finalize (GObject * object)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (object);
+
+  GST_DEBUG_OBJECT (vaidetect, "finalize");
+
+  g_free (vaidetect->model);
+  g_free (vaidetect->model_type);
+  delete vaidetect->stats;
+
+  G_OBJECT_CLASS (gst_vaidetect_parent_class)->finalize (object);
+}
+
+/* Create the backend, which loads the model before the first frame */
+static gboolean
+gst_vaidetect_start (GstBaseTransform * trans)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (trans);
+
+  GST_DEBUG_OBJECT (vaidetect, "start %s model %s", vaidetect->model_type,
+      vaidetect->model);
+
+  try {
+    vaidetect->backend = BackendRegistry::get ().create (
+        vaidetect->model_type ? vaidetect->model_type : "",
+        vaidetect->model ? vaidetect->model : "").release ();
+  } catch (const std::exception & e) {
+    GST_ELEMENT_ERROR (vaidetect, RESOURCE, NOT_FOUND, (NULL),
+        ("Failed to load model '%s': %s", vaidetect->model, e.what ()));
+    return FALSE;
+  }
+  if (!vaidetect->backend) {
+    GST_ELEMENT_ERROR (vaidetect, RESOURCE, SETTINGS, (NULL),
+        ("Unknown model-type '%s'", vaidetect->model_type));
+    return FALSE;
+  }
+
+  GST_OBJECT_LOCK (vaidetect);
+  vaidetect->qos = new DetectQos ();
+  GST_OBJECT_UNLOCK (vaidetect);
+  vaidetect->late = FALSE;
+  vaidetect->last = new std::vector<Detection> ();
+  vaidetect->stats->reset ();
+  vaidetect->trace = VaiStatsTracerRecord ();
+
+  return TRUE;
+}
+
+static gboolean
+gst_vaidetect_stop (GstBaseTransform * trans)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (trans);
+
+  GST_DEBUG_OBJECT (vaidetect, "stop");
+
+  delete vaidetect->backend;
+  vaidetect->backend = NULL;
+  delete vaidetect->last;
+  vaidetect->last = NULL;
+  GST_OBJECT_LOCK (vaidetect);
+  delete vaidetect->qos;
+  vaidetect->qos = NULL;
+  GST_OBJECT_UNLOCK (vaidetect);
+
+  return TRUE;
+}
+
+/* transform */
+
+/* Offer our dmabuf pool upstream, ahead of whatever downstream proposes.
+ * The element always works in place, so basetransform never passes a
+ * decide query and GstVideoFilter forwards the query downstream after us.
+ * In passthrough the buffers are not read, so no pool is offered. */
+static gboolean
+gst_vaidetect_propose_allocation (GstBaseTransform * trans,
+    GstQuery * decide_query, GstQuery * query)
+{
+  if (!gst_base_transform_is_passthrough (trans))
+    VaiDmabufProposeAllocation (query);
+
+  return GST_BASE_TRANSFORM_CLASS (gst_vaidetect_parent_class)->
+      propose_allocation (trans, decide_query, query);
+}
+
+/* The frame is mapped here rather than by GstVideoFilter so every stage is
+ * timed.  It is mapped for reading only, inference does not write, and
+ * mapped again for writing only when there are boxes to draw; otherwise
+ * the results go into meta.  So the buffer memory is never copied to make
+ * it writable, nor a dmabuf synced back, for nothing. */
+static GstFlowReturn
+gst_vaidetect_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (trans);
+  GstVideoFilter *filter = GST_VIDEO_FILTER (trans);
+  DetectBackend *backend = vaidetect->backend;
+  gboolean draw = vaidetect->draw;
+  StageTimer timer;
+  GstVideoFrame frame;
+
+  if (!filter->negotiated)
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  if (FrameIsDmabuf (buf) != !!vaidetect->dmabuf) {
+    vaidetect->dmabuf = !vaidetect->dmabuf;
+    GST_INFO_OBJECT (vaidetect, "input in %s",
+        vaidetect->dmabuf ? "dmabuf memory" : "system memory");
+  }
+
+  if (!gst_video_frame_map (&frame, &filter->in_info, buf, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (vaidetect, CORE, FAILED, (NULL),
+        ("Failed to map input buffer"));
+    return GST_FLOW_ERROR;
+  }
+  timer.mark (VAI_STAGE_MAP);
+
+  /* Setup an OpenCV Mat with the frame data, converted from YUV */
+  cv::Mat img = FrameToBGR(&frame, backend->input_size());
+  timer.mark (VAI_STAGE_PREPROCESS);
+
+  /* Perform detection */
+  auto results = gst_vaidetect_detect(vaidetect, img);
+  timer.mark (VAI_STAGE_INFER);
+
+  if (draw && !results.empty ()) {
+    if (!FrameMapWritable (&frame, &filter->in_info)) {
+      GST_ELEMENT_ERROR (vaidetect, CORE, FAILED, (NULL),
+          ("Failed to map input buffer for drawing"));
+      return GST_FLOW_ERROR;
+    }
+    gst_vaidetect_draw(vaidetect, &frame, results);
+    timer.mark (VAI_STAGE_DRAW);
+  }
+  gst_video_frame_unmap (&frame);
+
+  /* Attach bounding boxes as meta */
+  if (!draw)
+    AttachBoxes(buf, GST_VIDEO_INFO_WIDTH (&filter->in_info),
+        GST_VIDEO_INFO_HEIGHT (&filter->in_info), results,
+        [backend] (const Detection & box) { return backend->label(box.label); });
+  timer.mark (VAI_STAGE_POSTPROCESS);
+
+  vaidetect->stats->add (timer);
+  if (vaidetect->timing)
+    timer.post (GST_ELEMENT (vaidetect), 0, GST_BUFFER_PTS (buf));
+  if (vaidetect->trace)
+    VaiStatsTrace (vaidetect->trace, GST_ELEMENT (vaidetect), 0,
+        GST_BUFFER_PTS (buf), timer);
+  vaidetect->stats->post_if_due (GST_ELEMENT (vaidetect),
+      vaidetect->stats_interval);
+
+  GST_DEBUG_OBJECT (vaidetect, "transform_ip");
+
+  return GST_FLOW_OK;
+}
+
+/* Late frames are dropped here, before they are mapped, unless
+ * leaky-inference lets them through to reuse the last detections */
+static GstFlowReturn
+gst_vaidetect_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (trans);
+  GstClockTime running_time;
+  GstClockTimeDiff jitter;
+
+  vaidetect->late = vaidetect->qos->late (trans, input,
+      vaidetect->max_lateness, &running_time, &jitter);
+
+  if (vaidetect->late && !vaidetect->leaky_inference) {
+    GST_DEBUG_OBJECT (vaidetect, "late by %" GST_STIME_FORMAT ", dropping",
+        GST_STIME_ARGS (jitter));
+    vaidetect->qos->post_dropped (GST_ELEMENT (vaidetect), &trans->segment,
+        input, running_time, jitter);
+    gst_buffer_unref (input);
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_vaidetect_parent_class)->
+      submit_input_buffer (trans, is_discont, input);
+}
+
+/* Time the transform for the QoS average processing time */
+static GstFlowReturn
+gst_vaidetect_generate_output (GstBaseTransform * trans, GstBuffer ** outbuf)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (trans);
+  GstClockTime start = gst_util_get_timestamp ();
+  GstFlowReturn ret;
+
+  ret = GST_BASE_TRANSFORM_CLASS (gst_vaidetect_parent_class)->
+      generate_output (trans, outbuf);
+  if (*outbuf && !vaidetect->late)
+    vaidetect->qos->processed (gst_util_get_timestamp () - start);
+
+  return ret;
+}
+
+static gboolean
+gst_vaidetect_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (trans);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP && vaidetect->qos)
+    vaidetect->qos->reset ();
+
+  return GST_BASE_TRANSFORM_CLASS (gst_vaidetect_parent_class)->
+      sink_event (trans, event);
+}
+
+static gboolean
+gst_vaidetect_src_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstVaidetect *vaidetect = GST_VAIDETECT (trans);
+
+  GST_OBJECT_LOCK (vaidetect);
+  if (vaidetect->qos)
+    vaidetect->qos->handle_event (event);
+  GST_OBJECT_UNLOCK (vaidetect);
+
+  return GST_BASE_TRANSFORM_CLASS (gst_vaidetect_parent_class)->
+      src_event (trans, event);
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  gst_vaidetect_register_backends ();
+
+  return VaiStatsTracerRegister (plugin) &&
+      gst_element_register (plugin, "vaidetect", GST_RANK_NONE,
+      GST_TYPE_VAIDETECT) &&
+      gst_element_register (plugin, "vaimultidetect", GST_RANK_NONE,
+      GST_TYPE_VAIMULTIDETECT);
+}
+
+#ifndef VERSION
+#define VERSION "0.0.0"
+#endif
+#ifndef PACKAGE
+#define PACKAGE "vaidetect"
+#endif
+#ifndef PACKAGE_NAME
+#define PACKAGE_NAME "Gstreamer Xilinx Vitis-AI-Library"
+#endif
+#ifndef GST_PACKAGE_ORIGIN
+#define GST_PACKAGE_ORIGIN "http://xilinx.com; http://avnet.com"
+#endif
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    vaidetect,
+    "Object detection with selectable models using the Xilinx Vitis-AI-Library",
+    plugin_init, VERSION, "LGPL", PACKAGE_NAME, GST_PACKAGE_ORIGIN)
@@ -0,0 +1,83 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef _GST_VAIDETECT_H_
+#define _GST_VAIDETECT_H_
+
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+#include <detectbackend.hpp>
+#include <detectqos.hpp>
+#include <stagestats.hpp>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAIDETECT   (gst_vaidetect_get_type())
+#define GST_VAIDETECT(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VAIDETECT,GstVaidetect))
+#define GST_VAIDETECT_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VAIDETECT,GstVaidetectClass))
+#define GST_IS_VAIDETECT(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VAIDETECT))
+#define GST_IS_VAIDETECT_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VAIDETECT))
+
+typedef struct _GstVaidetect GstVaidetect;
+typedef struct _GstVaidetectClass GstVaidetectClass;
+
+struct _GstVaidetect
+{
+  GstVideoFilter base_vaidetect;
+
+  gchar *model;
+  gchar *model_type;
+  gboolean draw;
+  gboolean leaky_inference;
+  GstClockTimeDiff max_lateness;
+  gboolean timing;
+  GstClockTime stats_interval;
+
+  /* created from model-type and model in start() */
+  DetectBackend *backend;
+
+  /* QoS state, whether the frame in transform is late, and the detections
+   * late frames reuse in leaky mode */
+  DetectQos *qos;
+  gboolean late;
+  std::vector<Detection> *last;
+
+  /* whether the last frame came in dmabuf memory */
+  gboolean dmabuf;
+
+  /* rolling stage latencies, and the vaistats tracer record when that
+   * tracer is active */
+  StageStats *stats;
+  GstTracerRecord *trace;
+};
+
+struct _GstVaidetectClass
+{
+  GstVideoFilterClass base_vaidetect_class;
+};
+
+GType gst_vaidetect_get_type (void);
+
+G_END_DECLS
+
+/* Register the model types built into the plugin */
+void gst_vaidetect_register_backends (void);
+
+#endif
@@ -0,0 +1,169 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+/*
+ * Model backends of the vaidetect element
+ *
+ *  "tfssd", "ssd" and "facedetect" wrap the Vitis-AI-Library runners and
+ *  take the model name from the model property.  "cpu-stub" needs no
+ *  accelerator and ignores the model: it boxes the bright part of a small
+ *  thumbnail, so it is cheap, deterministic and fine for running the
+ *  element on x86 in benchmarks and tests.  "mock" stands in for the DPU
+ *  in the vaibench harness: the model property is the inference latency
+ *  in microseconds, paid once per run call, batched or not, and every
+ *  frame gets the same handful of boxes.
+ */
+
+#include <chrono>
+#include <cstdlib>
+#include <thread>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "gstvaidetect.h"
+
+#ifndef VAIDETECT_CPU_ONLY
+/* Vitis-AI-Library specific header files */
+#include <vitis/ai/ssd.hpp>
+#include <vitis/ai/tfssd.hpp>
+#include <vitis/ai/nnpp/tfssd.hpp>
+#include <vitis/ai/facedetect.hpp>
+#include <vitis/ai/nnpp/facedetect.hpp>
+#endif
+
+using namespace std;
+
+#ifndef VAIDETECT_CPU_ONLY
+static const vector<string> coco_classes = {"person","bicycle","car","motobike","aeroplane","bus","train","truck","boat","traffic light",
+"fire hydrant","stop sign","parking meter","bench","bird","cat","dog","horse","sheep","cow",
+"elephant","bear","zebra","giraffe","backpack","umbrella","handbag","tie","suitcase","frisbee",
+"skis","snowboard","sports ball","kite","baseball bat","baseball glove","skateboard","surfboard","tennis racket","bottle",
+"wine glass","cup","fork","knife","spoon","bowl","banana","apple","sandwich","orange",
+"broccoli","carrot","hot dog","pizza","donut","cake","chair","sofa","pottedplant","bed",
+"diningtable","toilet","tvmonitor","laptop","mouse","remote","keyboard","cell phone","micowave","oven",
+"toaster","sink","refrigerator","book","clock","vase","scissors","teddy bear","hair drier","toothbrush"
+};
+#endif
+
+/* Boxes the pixels well above the mean brightness of a 64x36 thumbnail */
+class StubBackend : public DetectBackend
+{
+public:
+  std::vector<Detection> run (const cv::Mat & img) override
+  {
+    cv::Mat thumb, gray, mask;
+    std::vector<Detection> results;
+
+    cv::resize (img, thumb, cv::Size (64, 36), 0, 0, cv::INTER_AREA);
+    cv::cvtColor (thumb, gray, cv::COLOR_BGR2GRAY);
+    cv::threshold (gray, mask, cv::mean (gray)[0] + 32, 255,
+        cv::THRESH_BINARY);
+
+    cv::Rect box = cv::boundingRect (mask);
+    if (box.area () > 0)
+      results.push_back ({ 0, (float) cv::countNonZero (mask) / box.area (),
+          box.x / 64.0f, box.y / 36.0f, box.width / 64.0f,
+          box.height / 36.0f });
+
+    return results;
+  }
+
+  const char *label (int id) const override
+  {
+    return "object";
+  }
+};
+
+/* Fixed boxes after a fixed latency, at an SSD-like 300x300 input */
+class MockBackend : public DetectBackend
+{
+public:
+  explicit MockBackend (const string & model)
+      : latency_ (strtoul (model.c_str (), NULL, 10)) {}
+
+  std::vector<Detection> run (const cv::Mat & img) override
+  {
+    std::this_thread::sleep_for (latency_);
+    return boxes ();
+  }
+
+  std::vector<std::vector<Detection>>
+  run (const std::vector<cv::Mat> & imgs) override
+  {
+    std::this_thread::sleep_for (latency_);
+    return std::vector<std::vector<Detection>> (imgs.size (), boxes ());
+  }
+
+  const char *label (int id) const override
+  {
+    return "object";
+  }
+
+  cv::Size input_size () const override
+  {
+    return cv::Size (300, 300);
+  }
+
+private:
+  static std::vector<Detection> boxes ()
+  {
+    return {
+      { 0, 0.9f, 0.10f, 0.10f, 0.20f, 0.30f },
+      { 0, 0.8f, 0.40f, 0.20f, 0.15f, 0.40f },
+      { 0, 0.7f, 0.65f, 0.50f, 0.25f, 0.35f },
+      { 0, 0.6f, 0.20f, 0.60f, 0.30f, 0.25f },
+    };
+  }
+
+  std::chrono::microseconds latency_;
+};
+
+void
+gst_vaidetect_register_backends (void)
+{
+  auto &registry = BackendRegistry::get ();
+
+#ifndef VAIDETECT_CPU_ONLY
+  registry.add ("tfssd", [] (const string & model) {
+    return unique_ptr<DetectBackend> (new VitisBackend<vitis::ai::TFSSD,
+        vitis::ai::TFSSDResult,
+        vector<vitis::ai::TFSSDResult::BoundingBox>> (model,
+            &vitis::ai::TFSSDResult::bboxes, coco_classes));
+  });
+  registry.add ("ssd", [] (const string & model) {
+    return unique_ptr<DetectBackend> (new VitisBackend<vitis::ai::SSD,
+        vitis::ai::SSDResult,
+        vector<vitis::ai::SSDResult::BoundingBox>> (model,
+            &vitis::ai::SSDResult::bboxes, { "background", "person" }));
+  });
+  registry.add ("facedetect", [] (const string & model) {
+    return unique_ptr<DetectBackend> (new VitisBackend<vitis::ai::FaceDetect,
+        vitis::ai::FaceDetectResult,
+        vector<vitis::ai::FaceDetectResult::BoundingBox>> (model,
+            &vitis::ai::FaceDetectResult::rects, { "face" }));
+  });
+#endif
+  registry.add ("cpu-stub", [] (const string & model) {
+    return unique_ptr<DetectBackend> (new StubBackend ());
+  });
+  registry.add ("mock", [] (const string & model) {
+    return unique_ptr<DetectBackend> (new MockBackend (model));
+  });
+}
@@ -0,0 +1,792 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+/**
+ * SECTION:element-gstvaimultidetect
+ *
+ * The vaimultidetect element runs one detection model for several video
+ * streams.  Every requested sink_%u pad gets a src_%u pad with the same
+ * number that outputs the annotated frames of that stream.
+ *
+ * Instead of one detector per branch contending for the DPU, a single
+ * scheduler thread batches the waiting frames of all streams, earliest
+ * deadline first.  Each sink pad has a deadline and a priority; a higher
+ * priority divides the deadline, so that stream is served sooner.
+ *
+ * <refsect2>
+ * <title>Two cameras, one person detector</title>
+ * |[
+ * gst-launch-1.0 vaimultidetect name=d model-type=ssd \
+ *     model=ssd_pedestrain_pruned_0_97 batch-size=2 \
+ *     v4l2src device=/dev/video2 ! video/x-raw, format=BGR ! d.sink_0 \
+ *     v4l2src device=/dev/video3 ! video/x-raw, format=BGR ! d.sink_1 \
+ *     d.src_0 ! queue ! autovideosink \
+ *     d.src_1 ! queue ! autovideosink
+ * ]|
+ * </refsect2>
+ *
+ * The stage latency properties, vai-stats messages and vaistats tracer
+ * records are the same as for vaidetect; the percentiles cover the frames
+ * of all streams, the tracer records carry the stream's pad index.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <stdio.h>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include "gstvaimultidetect.h"
+
+/* OpenCV header files */
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Header file for attaching detections as region of interest meta */
+#include <roimeta.hpp>
+
+/* Header files for YUV input and drawing, and per-stage timing */
+#include <yuvframe.hpp>
+#include <stagetimer.hpp>
+#include <vaistatstracer.hpp>
+
+/* Header file for mapping frames for writing only to draw */
+#include <dmabufpool.hpp>
+
+GST_DEBUG_CATEGORY_STATIC (gst_vaimultidetect_debug_category);
+#define GST_CAT_DEFAULT gst_vaimultidetect_debug_category
+
+/* prototypes */
+static void gst_vaimultidetect_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vaimultidetect_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vaimultidetect_finalize (GObject * object);
+
+static GstPad *gst_vaimultidetect_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps);
+static void gst_vaimultidetect_release_pad (GstElement * element,
+    GstPad * pad);
+static GstStateChangeReturn gst_vaimultidetect_change_state (GstElement *
+    element, GstStateChange transition);
+
+static GstFlowReturn gst_vaimultidetect_sink_chain (GstPad * pad,
+    GstObject * parent, GstBuffer * buf);
+static gboolean gst_vaimultidetect_sink_event (GstPad * pad,
+    GstObject * parent, GstEvent * event);
+static gboolean gst_vaimultidetect_src_query (GstPad * pad,
+    GstObject * parent, GstQuery * query);
+static GstIterator *gst_vaimultidetect_iterate_internal_links (GstPad * pad,
+    GstObject * parent);
+
+enum
+{
+  PROP_0,
+  PROP_MODEL,
+  PROP_MODEL_TYPE,
+  PROP_BATCH_SIZE,
+  PROP_MAX_BATCH_LATENCY,
+  PROP_DRAW,
+  PROP_TIMING,
+  PROP_STATS_INTERVAL,
+  PROP_LATENCY_P50,
+  PROP_LATENCY_P95,
+  PROP_LATENCY_P99
+};
+
+enum
+{
+  PROP_PAD_0,
+  PROP_PAD_PRIORITY,
+  PROP_PAD_DEADLINE
+};
+
+#ifdef VAIDETECT_CPU_ONLY
+#define DEFAULT_MODEL ""
+#define DEFAULT_MODEL_TYPE "cpu-stub"
+#else
+#define DEFAULT_MODEL "ssd_pedestrain_pruned_0_97"
+#define DEFAULT_MODEL_TYPE "ssd"
+#endif
+#define DEFAULT_BATCH_SIZE 4
+#define DEFAULT_MAX_BATCH_LATENCY (10 * GST_MSECOND)
+#define DEFAULT_DRAW TRUE
+#define DEFAULT_TIMING FALSE
+#define DEFAULT_STATS_INTERVAL 0
+
+#define DEFAULT_PAD_PRIORITY 1
+#define DEFAULT_PAD_DEADLINE (33 * GST_MSECOND)
+
+/* pad templates */
+
+#define VIDEO_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
+
+static GstStaticPadTemplate gst_vaimultidetect_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink_%u",
+    GST_PAD_SINK,
+    GST_PAD_REQUEST,
+    GST_STATIC_CAPS (VIDEO_CAPS));
+
+static GstStaticPadTemplate gst_vaimultidetect_src_template =
+GST_STATIC_PAD_TEMPLATE ("src_%u",
+    GST_PAD_SRC,
+    GST_PAD_SOMETIMES,
+    GST_STATIC_CAPS (VIDEO_CAPS));
+
+
+/* sink pad class */
+
+G_DEFINE_TYPE (GstVaimultidetectPad, gst_vaimultidetect_pad, GST_TYPE_PAD);
+
+static void
+gst_vaimultidetect_pad_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaimultidetectPad *pad = GST_VAIMULTIDETECT_PAD (object);
+
+  GST_OBJECT_LOCK (pad);
+  switch (property_id) {
+    case PROP_PAD_PRIORITY:
+      pad->priority = g_value_get_uint (value);
+      break;
+    case PROP_PAD_DEADLINE:
+      pad->deadline = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+gst_vaimultidetect_pad_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaimultidetectPad *pad = GST_VAIMULTIDETECT_PAD (object);
+
+  GST_OBJECT_LOCK (pad);
+  switch (property_id) {
+    case PROP_PAD_PRIORITY:
+      g_value_set_uint (value, pad->priority);
+      break;
+    case PROP_PAD_DEADLINE:
+      g_value_set_uint64 (value, pad->deadline);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+  GST_OBJECT_UNLOCK (pad);
+}
+
+static void
+gst_vaimultidetect_pad_class_init (GstVaimultidetectPadClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+
+  gobject_class->set_property = gst_vaimultidetect_pad_set_property;
+  gobject_class->get_property = gst_vaimultidetect_pad_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_PAD_PRIORITY,
+      g_param_spec_uint ("priority", "Priority",
+          "Scheduling weight of the stream, its deadline is divided by it",
+          1, 100, DEFAULT_PAD_PRIORITY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_PAD_DEADLINE,
+      g_param_spec_uint64 ("deadline", "Deadline",
+          "Time a frame of the stream may wait for inference (in ns)",
+          0, G_MAXUINT64, DEFAULT_PAD_DEADLINE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+}
+
+static void
+gst_vaimultidetect_pad_init (GstVaimultidetectPad * pad)
+{
+  pad->index = 0;
+  pad->srcpad = NULL;
+  pad->priority = DEFAULT_PAD_PRIORITY;
+  pad->deadline = DEFAULT_PAD_DEADLINE;
+  gst_video_info_init (&pad->info);
+  pad->negotiated = FALSE;
+}
+
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVaimultidetect, gst_vaimultidetect, GST_TYPE_ELEMENT,
+  GST_DEBUG_CATEGORY_INIT (gst_vaimultidetect_debug_category, "vaimultidetect", 0,
+  "debug category for vaimultidetect element"));
+
+static void
+gst_vaimultidetect_class_init (GstVaimultidetectClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstElementClass *element_class = GST_ELEMENT_CLASS (klass);
+
+  gst_element_class_add_static_pad_template_with_gtype (element_class,
+      &gst_vaimultidetect_sink_template, GST_TYPE_VAIMULTIDETECT_PAD);
+  gst_element_class_add_static_pad_template (element_class,
+      &gst_vaimultidetect_src_template);
+
+  gst_element_class_set_static_metadata (element_class,
+      "Multi-stream object detection using the Vitis-AI-Library",
+      "Video Filter",
+      "Object Detection for several streams sharing one accelerator",
+      "Tom Simpson @ AVNET");
+
+  gobject_class->set_property = gst_vaimultidetect_set_property;
+  gobject_class->get_property = gst_vaimultidetect_get_property;
+  gobject_class->finalize = gst_vaimultidetect_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_MODEL,
+      g_param_spec_string ("model", "Model",
+          "Name of the model the backend loads", DEFAULT_MODEL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_MODEL_TYPE,
+      g_param_spec_string ("model-type", "Model type",
+          "Backend that runs the model, one of the types registered by the "
+          "plugin (tfssd, ssd, facedetect, cpu-stub, mock)", DEFAULT_MODEL_TYPE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_BATCH_SIZE,
+      g_param_spec_uint ("batch-size", "Batch size",
+          "Maximum number of frames, from any streams, run together", 1, 64,
+          DEFAULT_BATCH_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH_LATENCY,
+      g_param_spec_uint64 ("max-batch-latency", "Max batch latency",
+          "Longest a frame waits for the other streams to fill a batch "
+          "(in ns)", 0, G_MAXUINT64, DEFAULT_MAX_BATCH_LATENCY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_DRAW,
+      g_param_spec_boolean ("draw", "Draw",
+          "Draw the detections into the frame; when disabled they are "
+          "attached as GstVideoRegionOfInterestMeta and the frame is left "
+          "untouched", DEFAULT_DRAW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_TIMING,
+      g_param_spec_boolean ("timing", "Timing",
+          "Post a vai-frame-timing element message with the time spent in "
+          "each stage for every frame", DEFAULT_TIMING,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint64 ("stats-interval", "Stats interval",
+          "Post a vai-stats element message with the latency percentiles "
+          "of every stage this often (in ns, 0 = never)", 0, G_MAXUINT64,
+          DEFAULT_STATS_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P50,
+      g_param_spec_boxed ("latency-p50", "Latency p50",
+          "Median time spent in each stage over the last frames of all "
+          "streams (in ns)", GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P95,
+      g_param_spec_boxed ("latency-p95", "Latency p95",
+          "95th percentile of the time spent in each stage over the last "
+          "frames of all streams (in ns)", GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P99,
+      g_param_spec_boxed ("latency-p99", "Latency p99",
+          "99th percentile of the time spent in each stage over the last "
+          "frames of all streams (in ns)", GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  element_class->request_new_pad =
+      GST_DEBUG_FUNCPTR (gst_vaimultidetect_request_new_pad);
+  element_class->release_pad = GST_DEBUG_FUNCPTR (gst_vaimultidetect_release_pad);
+  element_class->change_state =
+      GST_DEBUG_FUNCPTR (gst_vaimultidetect_change_state);
+}
+
+static void
+gst_vaimultidetect_init (GstVaimultidetect *vaimultidetect)
+{
+  vaimultidetect->model = g_strdup (DEFAULT_MODEL);
+  vaimultidetect->model_type = g_strdup (DEFAULT_MODEL_TYPE);
+  vaimultidetect->batch_size = DEFAULT_BATCH_SIZE;
+  vaimultidetect->max_batch_latency = DEFAULT_MAX_BATCH_LATENCY;
+  vaimultidetect->draw = DEFAULT_DRAW;
+  vaimultidetect->timing = DEFAULT_TIMING;
+  vaimultidetect->next_index = 0;
+  vaimultidetect->backend = NULL;
+  vaimultidetect->scheduler = new StreamScheduler<std::vector<Detection>> ();
+  vaimultidetect->stats_interval = DEFAULT_STATS_INTERVAL;
+  vaimultidetect->stats = new StageStats ();
+  vaimultidetect->trace = NULL;
+}
+
+void
+gst_vaimultidetect_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (object);
+
+  GST_DEBUG_OBJECT (vaimultidetect, "set_property");
+
+  switch (property_id) {
+    case PROP_MODEL:
+      g_free (vaimultidetect->model);
+      vaimultidetect->model = g_value_dup_string (value);
+      break;
+    case PROP_MODEL_TYPE:
+      g_free (vaimultidetect->model_type);
+      vaimultidetect->model_type = g_value_dup_string (value);
+      break;
+    case PROP_BATCH_SIZE:
+      vaimultidetect->batch_size = g_value_get_uint (value);
+      break;
+    case PROP_MAX_BATCH_LATENCY:
+      vaimultidetect->max_batch_latency = g_value_get_uint64 (value);
+      break;
+    case PROP_DRAW:
+      vaimultidetect->draw = g_value_get_boolean (value);
+      break;
+    case PROP_TIMING:
+      vaimultidetect->timing = g_value_get_boolean (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      vaimultidetect->stats_interval = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vaimultidetect_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (object);
+
+  GST_DEBUG_OBJECT (vaimultidetect, "get_property");
+
+  switch (property_id) {
+    case PROP_MODEL:
+      g_value_set_string (value, vaimultidetect->model);
+      break;
+    case PROP_MODEL_TYPE:
+      g_value_set_string (value, vaimultidetect->model_type);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint (value, vaimultidetect->batch_size);
+      break;
+    case PROP_MAX_BATCH_LATENCY:
+      g_value_set_uint64 (value, vaimultidetect->max_batch_latency);
+      break;
+    case PROP_DRAW:
+      g_value_set_boolean (value, vaimultidetect->draw);
+      break;
+    case PROP_TIMING:
+      g_value_set_boolean (value, vaimultidetect->timing);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint64 (value, vaimultidetect->stats_interval);
+      break;
+    case PROP_LATENCY_P50:
+      g_value_take_boxed (value, vaimultidetect->stats->latency (0.50));
+      break;
+    case PROP_LATENCY_P95:
+      g_value_take_boxed (value, vaimultidetect->stats->latency (0.95));
+      break;
+    case PROP_LATENCY_P99:
+      g_value_take_boxed (value, vaimultidetect->stats->latency (0.99));
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vaimultidetect_finalize (GObject * object)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (object);
+
+  GST_DEBUG_OBJECT (vaimultidetect, "finalize");
+
+  delete vaimultidetect->scheduler;
+  delete vaimultidetect->stats;
+  g_free (vaimultidetect->model);
+  g_free (vaimultidetect->model_type);
+
+  G_OBJECT_CLASS (gst_vaimultidetect_parent_class)->finalize (object);
+}
+
+/* pads */
+
+static GstPad *
+gst_vaimultidetect_request_new_pad (GstElement * element,
+    GstPadTemplate * templ, const gchar * name, const GstCaps * caps)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (element);
+  GstVaimultidetectPad *sinkpad;
+  GstPad *srcpad;
+  gchar *sinkname, *srcname;
+  guint index;
+
+  GST_OBJECT_LOCK (vaimultidetect);
+  if (name && sscanf (name, "sink_%u", &index) == 1) {
+    vaimultidetect->next_index = MAX (vaimultidetect->next_index, index + 1);
+  } else {
+    index = vaimultidetect->next_index++;
+  }
+  GST_OBJECT_UNLOCK (vaimultidetect);
+
+  sinkname = g_strdup_printf ("sink_%u", index);
+  srcname = g_strdup_printf ("src_%u", index);
+
+  sinkpad = GST_VAIMULTIDETECT_PAD (g_object_new (GST_TYPE_VAIMULTIDETECT_PAD,
+          "name", sinkname, "direction", GST_PAD_SINK, "template", templ,
+          NULL));
+  srcpad = gst_pad_new_from_static_template (&gst_vaimultidetect_src_template,
+      srcname);
+  g_free (sinkname);
+  g_free (srcname);
+
+  sinkpad->index = index;
+  sinkpad->srcpad = srcpad;
+  gst_pad_set_element_private (srcpad, sinkpad);
+
+  gst_pad_set_chain_function (GST_PAD (sinkpad),
+      GST_DEBUG_FUNCPTR (gst_vaimultidetect_sink_chain));
+  gst_pad_set_event_function (GST_PAD (sinkpad),
+      GST_DEBUG_FUNCPTR (gst_vaimultidetect_sink_event));
+  gst_pad_set_iterate_internal_links_function (GST_PAD (sinkpad),
+      GST_DEBUG_FUNCPTR (gst_vaimultidetect_iterate_internal_links));
+  gst_pad_set_iterate_internal_links_function (srcpad,
+      GST_DEBUG_FUNCPTR (gst_vaimultidetect_iterate_internal_links));
+  gst_pad_set_query_function (srcpad,
+      GST_DEBUG_FUNCPTR (gst_vaimultidetect_src_query));
+
+  /* Caps and allocation are answered by the paired pad's peer */
+  GST_PAD_SET_PROXY_CAPS (sinkpad);
+  GST_PAD_SET_PROXY_ALLOCATION (sinkpad);
+  GST_PAD_SET_PROXY_CAPS (srcpad);
+
+  vaimultidetect->scheduler->add_stream (index);
+
+  if (GST_STATE (element) > GST_STATE_READY) {
+    gst_pad_set_active (srcpad, TRUE);
+    gst_pad_set_active (GST_PAD (sinkpad), TRUE);
+  }
+  gst_element_add_pad (element, srcpad);
+  gst_element_add_pad (element, GST_PAD (sinkpad));
+
+  GST_DEBUG_OBJECT (vaimultidetect, "added stream %u", index);
+
+  return GST_PAD (sinkpad);
+}
+
+static void
+gst_vaimultidetect_release_pad (GstElement * element, GstPad * pad)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (element);
+  GstVaimultidetectPad *sinkpad = GST_VAIMULTIDETECT_PAD (pad);
+  GstPad *srcpad = sinkpad->srcpad;
+
+  GST_DEBUG_OBJECT (vaimultidetect, "removing stream %u", sinkpad->index);
+
+  /* Wake up the streaming thread if it waits on the scheduler */
+  vaimultidetect->scheduler->set_flushing (sinkpad->index, true);
+  gst_pad_set_active (pad, FALSE);
+  gst_pad_set_active (srcpad, FALSE);
+  vaimultidetect->scheduler->set_flushing (sinkpad->index, false);
+  vaimultidetect->scheduler->remove_stream (sinkpad->index);
+
+  gst_element_remove_pad (element, srcpad);
+  gst_element_remove_pad (element, pad);
+}
+
+static GstIterator *
+gst_vaimultidetect_iterate_internal_links (GstPad * pad, GstObject * parent)
+{
+  GValue value = G_VALUE_INIT;
+  GstIterator *it;
+  GstPad *other;
+
+  if (GST_PAD_IS_SINK (pad))
+    other = GST_VAIMULTIDETECT_PAD (pad)->srcpad;
+  else
+    other = GST_PAD (gst_pad_get_element_private (pad));
+  if (!other)
+    return NULL;
+
+  g_value_init (&value, GST_TYPE_PAD);
+  g_value_set_object (&value, other);
+  it = gst_iterator_new_single (GST_TYPE_PAD, &value);
+  g_value_unset (&value);
+
+  return it;
+}
+
+static gboolean
+gst_vaimultidetect_sink_event (GstPad * pad, GstObject * parent,
+    GstEvent * event)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (parent);
+  GstVaimultidetectPad *sinkpad = GST_VAIMULTIDETECT_PAD (pad);
+
+  switch (GST_EVENT_TYPE (event)) {
+    case GST_EVENT_CAPS:
+    {
+      GstCaps *caps;
+
+      gst_event_parse_caps (event, &caps);
+      sinkpad->negotiated = gst_video_info_from_caps (&sinkpad->info, caps);
+      if (!sinkpad->negotiated) {
+        gst_event_unref (event);
+        return FALSE;
+      }
+      break;
+    }
+    case GST_EVENT_FLUSH_START:
+      vaimultidetect->scheduler->set_flushing (sinkpad->index, true);
+      break;
+    case GST_EVENT_FLUSH_STOP:
+      vaimultidetect->scheduler->set_flushing (sinkpad->index, false);
+      vaimultidetect->scheduler->set_ended (sinkpad->index, false);
+      break;
+    case GST_EVENT_STREAM_START:
+      vaimultidetect->scheduler->set_ended (sinkpad->index, false);
+      break;
+    case GST_EVENT_EOS:
+      /* Don't hold the other streams' batches for frames that won't come */
+      vaimultidetect->scheduler->set_ended (sinkpad->index, true);
+      break;
+    default:
+      break;
+  }
+
+  /* forwarded to the paired src pad through the internal link */
+  return gst_pad_event_default (pad, parent, event);
+}
+
+/* A frame may wait up to max-batch-latency for the other streams to fill
+ * its batch, so add that to the latency upstream reports */
+static gboolean
+gst_vaimultidetect_src_query (GstPad * pad, GstObject * parent,
+    GstQuery * query)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (parent);
+  GstClockTime min, max, latency;
+  gboolean live;
+
+  if (!gst_pad_query_default (pad, parent, query))
+    return FALSE;
+
+  /* Same values the scheduler was started with; the properties involved
+   * only change in READY */
+  if (GST_QUERY_TYPE (query) != GST_QUERY_LATENCY
+      || vaimultidetect->batch_size <= 1)
+    return TRUE;
+  latency = vaimultidetect->max_batch_latency;
+
+  GST_DEBUG_OBJECT (pad, "adding latency %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (latency));
+
+  gst_query_parse_latency (query, &live, &min, &max);
+  min += latency;
+  if (GST_CLOCK_TIME_IS_VALID (max))
+    max += latency;
+  gst_query_set_latency (query, live, min, max);
+
+  return TRUE;
+}
+
+/* Hand the frame to the scheduler and wait for its turn; the results are
+ * drawn or attached here and the frame leaves on the paired src pad */
+static GstFlowReturn
+gst_vaimultidetect_sink_chain (GstPad * pad, GstObject * parent,
+    GstBuffer * buf)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (parent);
+  GstVaimultidetectPad *sinkpad = GST_VAIMULTIDETECT_PAD (pad);
+  DetectBackend *backend = vaimultidetect->backend;
+  std::vector<Detection> results;
+  GstVideoFrame frame;
+  GstClockTime deadline;
+  guint priority;
+  gboolean draw = vaimultidetect->draw;
+  StageTimer timer;
+
+  if (!sinkpad->negotiated) {
+    gst_buffer_unref (buf);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  /* Inference only reads the frame; it is mapped for writing below only
+   * when there are boxes to draw */
+  if (draw)
+    buf = gst_buffer_make_writable (buf);
+
+  if (!gst_video_frame_map (&frame, &sinkpad->info, buf, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (vaimultidetect, CORE, FAILED, (NULL),
+        ("Failed to map input buffer"));
+    gst_buffer_unref (buf);
+    return GST_FLOW_ERROR;
+  }
+  timer.mark (VAI_STAGE_MAP);
+
+  GST_OBJECT_LOCK (sinkpad);
+  priority = sinkpad->priority;
+  deadline = sinkpad->deadline;
+  GST_OBJECT_UNLOCK (sinkpad);
+
+  cv::Mat img = FrameToBGR(&frame, backend->input_size());
+  timer.mark (VAI_STAGE_PREPROCESS);
+
+  if (!vaimultidetect->scheduler->submit (sinkpad->index, img, priority,
+          std::chrono::microseconds (deadline / GST_USECOND), &results)) {
+    GST_DEBUG_OBJECT (sinkpad, "flushing");
+    gst_video_frame_unmap (&frame);
+    gst_buffer_unref (buf);
+    return GST_FLOW_FLUSHING;
+  }
+  timer.mark (VAI_STAGE_INFER);
+
+  if (draw && !results.empty ()) {
+    if (!FrameMapWritable (&frame, &sinkpad->info)) {
+      GST_ELEMENT_ERROR (vaimultidetect, CORE, FAILED, (NULL),
+          ("Failed to map input buffer for drawing"));
+      gst_buffer_unref (buf);
+      return GST_FLOW_ERROR;
+    }
+    DrawBoxesFrame(&frame, results);
+    for (auto &box : results)
+      DrawLabelFrame(&frame, backend->label(box.label),
+          cv::Point(box.x * sinkpad->info.width, box.y * sinkpad->info.height),
+          cv::Scalar(0, 255, 0));
+    timer.mark (VAI_STAGE_DRAW);
+  }
+  gst_video_frame_unmap (&frame);
+
+  if (!draw) {
+    buf = gst_buffer_make_writable (buf);
+    AttachBoxes(buf, sinkpad->info.width, sinkpad->info.height, results,
+        [backend] (const Detection & box) { return backend->label(box.label); });
+  }
+  timer.mark (VAI_STAGE_POSTPROCESS);
+
+  vaimultidetect->stats->add (timer);
+  if (vaimultidetect->timing)
+    timer.post (GST_ELEMENT (vaimultidetect), sinkpad->index,
+        GST_BUFFER_PTS (buf));
+  if (vaimultidetect->trace)
+    VaiStatsTrace (vaimultidetect->trace, GST_ELEMENT (vaimultidetect),
+        sinkpad->index, GST_BUFFER_PTS (buf), timer);
+  vaimultidetect->stats->post_if_due (GST_ELEMENT (vaimultidetect),
+      vaimultidetect->stats_interval);
+
+  return gst_pad_push (sinkpad->srcpad, buf);
+}
+
+/* state changes */
+
+static gboolean
+gst_vaimultidetect_start (GstVaimultidetect * vaimultidetect)
+{
+  DetectBackend *backend;
+
+  GST_DEBUG_OBJECT (vaimultidetect, "start %s model %s",
+      vaimultidetect->model_type, vaimultidetect->model);
+
+  try {
+    backend = BackendRegistry::get ().create (
+        vaimultidetect->model_type ? vaimultidetect->model_type : "",
+        vaimultidetect->model ? vaimultidetect->model : "").release ();
+  } catch (const std::exception & e) {
+    GST_ELEMENT_ERROR (vaimultidetect, RESOURCE, NOT_FOUND, (NULL),
+        ("Failed to load model '%s': %s", vaimultidetect->model, e.what ()));
+    return FALSE;
+  }
+  if (!backend) {
+    GST_ELEMENT_ERROR (vaimultidetect, RESOURCE, SETTINGS, (NULL),
+        ("Unknown model-type '%s'", vaimultidetect->model_type));
+    return FALSE;
+  }
+
+  vaimultidetect->backend = backend;
+  vaimultidetect->stats->reset ();
+  vaimultidetect->trace = VaiStatsTracerRecord ();
+  vaimultidetect->scheduler->start (vaimultidetect->batch_size,
+      std::chrono::microseconds (vaimultidetect->max_batch_latency /
+          GST_USECOND),
+      [backend] (const std::vector<cv::Mat> & imgs) {
+        return backend->run (imgs);
+      });
+
+  return TRUE;
+}
+
+static GstStateChangeReturn
+gst_vaimultidetect_change_state (GstElement * element,
+    GstStateChange transition)
+{
+  GstVaimultidetect *vaimultidetect = GST_VAIMULTIDETECT (element);
+  GstStateChangeReturn ret;
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (!gst_vaimultidetect_start (vaimultidetect))
+        return GST_STATE_CHANGE_FAILURE;
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      /* Release the streaming threads waiting on the scheduler before the
+       * pads are deactivated */
+      vaimultidetect->scheduler->stop ();
+      break;
+    default:
+      break;
+  }
+
+  ret = GST_ELEMENT_CLASS (gst_vaimultidetect_parent_class)->change_state
+      (element, transition);
+
+  switch (transition) {
+    case GST_STATE_CHANGE_READY_TO_PAUSED:
+      if (ret == GST_STATE_CHANGE_FAILURE) {
+        vaimultidetect->scheduler->stop ();
+        delete vaimultidetect->backend;
+        vaimultidetect->backend = NULL;
+      }
+      break;
+    case GST_STATE_CHANGE_PAUSED_TO_READY:
+      delete vaimultidetect->backend;
+      vaimultidetect->backend = NULL;
+      break;
+    default:
+      break;
+  }
+
+  return ret;
+}
@@ -0,0 +1,104 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+
+#ifndef _GST_VAIMULTIDETECT_H_
+#define _GST_VAIMULTIDETECT_H_
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <detectbackend.hpp>
+#include <streamscheduler.hpp>
+#include <stagestats.hpp>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAIMULTIDETECT   (gst_vaimultidetect_get_type())
+#define GST_VAIMULTIDETECT(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VAIMULTIDETECT,GstVaimultidetect))
+#define GST_VAIMULTIDETECT_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VAIMULTIDETECT,GstVaimultidetectClass))
+#define GST_IS_VAIMULTIDETECT(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VAIMULTIDETECT))
+#define GST_IS_VAIMULTIDETECT_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VAIMULTIDETECT))
+
+#define GST_TYPE_VAIMULTIDETECT_PAD   (gst_vaimultidetect_pad_get_type())
+#define GST_VAIMULTIDETECT_PAD(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VAIMULTIDETECT_PAD,GstVaimultidetectPad))
+#define GST_IS_VAIMULTIDETECT_PAD(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VAIMULTIDETECT_PAD))
+
+typedef struct _GstVaimultidetect GstVaimultidetect;
+typedef struct _GstVaimultidetectClass GstVaimultidetectClass;
+typedef struct _GstVaimultidetectPad GstVaimultidetectPad;
+typedef struct _GstVaimultidetectPadClass GstVaimultidetectPadClass;
+
+/* A sink_%u pad, paired with the src_%u pad of the same number */
+struct _GstVaimultidetectPad
+{
+  GstPad parent;
+
+  guint index;
+  GstPad *srcpad;
+
+  /* protected by the object lock */
+  guint priority;
+  GstClockTime deadline;
+
+  /* streaming thread only */
+  GstVideoInfo info;
+  gboolean negotiated;
+};
+
+struct _GstVaimultidetectPadClass
+{
+  GstPadClass parent_class;
+};
+
+struct _GstVaimultidetect
+{
+  GstElement base_vaimultidetect;
+
+  gchar *model;
+  gchar *model_type;
+  guint batch_size;
+  GstClockTime max_batch_latency;
+  gboolean draw;
+  gboolean timing;
+  GstClockTime stats_interval;
+
+  guint next_index;
+
+  /* the backend is created and the scheduler thread runs from READY
+   * to PAUSED until PAUSED to READY */
+  DetectBackend *backend;
+  StreamScheduler<std::vector<Detection>> *scheduler;
+
+  /* rolling stage latencies over all streams, and the vaistats tracer
+   * record when that tracer is active */
+  StageStats *stats;
+  GstTracerRecord *trace;
+};
+
+struct _GstVaimultidetectClass
+{
+  GstElementClass base_vaimultidetect_class;
+};
+
+GType gst_vaimultidetect_get_type (void);
+GType gst_vaimultidetect_pad_get_type (void);
+
+G_END_DECLS
+
+#endif
@@ -51,6 +51,13 @@
 
 /* Header file for custom drawing function */
 #include <drawboxes.hpp>
+#include <yuvframe.hpp>
+
+/* Header file for attaching detections as region of interest meta */
+#include <roimeta.hpp>
+
+/* Header file for the runners shared between element instances */
+#include <runnerpool.hpp>
 
 GST_DEBUG_CATEGORY_STATIC (gst_vaifacedetect_debug_category);
 #define GST_CAT_DEFAULT gst_vaifacedetect_debug_category
@@ -69,22 +76,41 @@ static gboolean gst_vaifacedetect_set_info (GstVideoFilter * filter, GstCaps * i
     GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info);
 static GstFlowReturn gst_vaifacedetect_transform_frame_ip (GstVideoFilter * filter,
     GstVideoFrame * frame);
+static GstFlowReturn gst_vaifacedetect_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_DRAW
 };
 
+#define DEFAULT_DRAW TRUE
+
 /* pad templates */
 
 /* Input format */
 #define VIDEO_SRC_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ BGR }")
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
 
 /* Output format */
 #define VIDEO_SINK_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ BGR }")
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
+
 
+#define MODEL_NAME "densebox_640_360"
+
+/* Run the model on one frame */
+static vitis::ai::FaceDetectResult
+gst_vaifacedetect_run (const cv::Mat & img)
+{
+  /* Lease a face detection object, preloaded in start() */
+  auto face = RunnerPool<vitis::ai::FaceDetect>::get().acquire(MODEL_NAME);
+
+  if (!face)
+    return vitis::ai::FaceDetectResult{};
+  return face->run(img);
+}
 
 /* class initialization */
 
@@ -118,8 +144,19 @@ gst_element_class_set_static_metadata (GST_ELEMENT_CLASS(klass),
   gobject_class->get_property = gst_vaifacedetect_get_property;
   gobject_class->dispose = gst_vaifacedetect_dispose;
   gobject_class->finalize = gst_vaifacedetect_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_DRAW,
+      g_param_spec_boolean ("draw", "Draw",
+          "Draw the detections into the frame; when disabled they are "
+          "attached as GstVideoRegionOfInterestMeta and the frame is left "
+          "untouched", DEFAULT_DRAW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
   base_transform_class->start = GST_DEBUG_FUNCPTR (gst_vaifacedetect_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vaifacedetect_stop);
+  base_transform_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_vaifacedetect_transform_ip);
   video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_vaifacedetect_set_info);
   video_filter_class->transform_frame_ip = GST_DEBUG_FUNCPTR (gst_vaifacedetect_transform_frame_ip);
 
@@ -128,6 +165,7 @@ gst_element_class_set_static_metadata (GST_ELEMENT_CLASS(klass),
 static void
 gst_vaifacedetect_init (GstVaifacedetect *vaifacedetect)
 {
+  vaifacedetect->draw = DEFAULT_DRAW;
 }
 
 void
@@ -139,6 +177,9 @@ gst_vaifacedetect_set_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (vaifacedetect, "set_property");
 
   switch (property_id) {
+    case PROP_DRAW:
+      vaifacedetect->draw = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -154,6 +195,9 @@ gst_vaifacedetect_get_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (vaifacedetect, "get_property");
 
   switch (property_id) {
+    case PROP_DRAW:
+      g_value_set_boolean (value, vaifacedetect->draw);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -191,6 +235,13 @@ gst_vaifacedetect_start (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (vaifacedetect, "start");
 
+  /* Load the model now rather than on the first frame */
+  if (!RunnerPool<vitis::ai::FaceDetect>::get ().ref (MODEL_NAME)) {
+    GST_ELEMENT_ERROR (vaifacedetect, RESOURCE, NOT_FOUND, (NULL),
+        ("Failed to load model '%s'", MODEL_NAME));
+    return FALSE;
+  }
+
   return TRUE;
 }
 
@@ -201,6 +252,8 @@ gst_vaifacedetect_stop (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (vaifacedetect, "stop");
 
+  RunnerPool<vitis::ai::FaceDetect>::get ().unref (MODEL_NAME);
+
   return TRUE;
 }
 
@@ -221,23 +274,60 @@ gst_vaifacedetect_transform_frame_ip (GstVideoFilter * filter, GstVideoFrame * f
 {
   GstVaifacedetect *vaifacedetect = GST_VAIFACEDETECT (filter);
   
-  /* Create face detection object */
-  thread_local auto face = vitis::ai::FaceDetect::create("densebox_640_360");
-
-  /* Setup an OpenCV Mat with the frame data */ 
-  cv::Mat img(360, 640, CV_8UC3, GST_VIDEO_FRAME_PLANE_DATA(frame, 0));
+  /* Setup an OpenCV Mat with the frame data, converted from YUV */
+  cv::Mat img = FrameToBGR(frame, cv::Size(640, 360));
 
   /* Perform face detection */
-  auto results = face->run(img);
+  auto results = gst_vaifacedetect_run(img);
 
   /* Draw bounding boxes around faces */
-  DrawBoxes(img, results.rects);
+  DrawBoxesFrame(frame, results.rects);
   
   GST_DEBUG_OBJECT (vaifacedetect, "transform_frame_ip");
 
   return GST_FLOW_OK;
 }
 
+/* With draw disabled the frame is only mapped for reading and the results
+ * go into meta, so the buffer memory is never copied to make it writable.
+ * Drawing goes through GstVideoFilter and transform_frame_ip(). */
+static GstFlowReturn
+gst_vaifacedetect_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstVaifacedetect *vaifacedetect = GST_VAIFACEDETECT (trans);
+  GstVideoFilter *filter = GST_VIDEO_FILTER (trans);
+  GstVideoFrame frame;
+
+  if (vaifacedetect->draw)
+    return GST_BASE_TRANSFORM_CLASS (gst_vaifacedetect_parent_class)->
+        transform_ip (trans, buf);
+
+  if (!filter->negotiated)
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  if (!gst_video_frame_map (&frame, &filter->in_info, buf, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (vaifacedetect, CORE, FAILED, (NULL),
+        ("Failed to map input buffer"));
+    return GST_FLOW_ERROR;
+  }
+
+  /* Setup an OpenCV Mat with the frame data, converted from YUV */
+  cv::Mat img = FrameToBGR(&frame, cv::Size(640, 360));
+
+  /* Perform face detection */
+  auto results = gst_vaifacedetect_run(img);
+  gst_video_frame_unmap (&frame);
+
+  /* Attach bounding boxes as meta */
+  AttachBoxes(buf, GST_VIDEO_INFO_WIDTH (&filter->in_info),
+      GST_VIDEO_INFO_HEIGHT (&filter->in_info), results.rects,
+      [] (const auto & box) { return "face"; });
+
+  GST_DEBUG_OBJECT (vaifacedetect, "transform_ip");
+
+  return GST_FLOW_OK;
+}
+
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
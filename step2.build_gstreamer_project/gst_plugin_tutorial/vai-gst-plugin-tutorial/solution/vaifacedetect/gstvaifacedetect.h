@@ -38,6 +38,7 @@ struct _GstVaifacedetect
 {
   GstVideoFilter base_vaifacedetect;
 
+  gboolean draw;
 };
 
 struct _GstVaifacedetectClass
@@ -0,0 +1,240 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-gstvaioverlay
+ *
+ * The vaioverlay element draws the GstVideoRegionOfInterestMeta attached
+ * by the Vitis-AI detectors when they run with draw=false.  Put it on the
+ * display branch only, so the other branches keep the untouched frames.
+ * It takes the same formats as the detectors and draws in the frame's own
+ * format, so no videoconvert is needed in front of it.
+ *
+ * <refsect2>
+ * <title>Example launch line</title>
+ * |[
+ * gst-launch-1.0 -v v4l2src ! video/x-raw, format=YUY2 ! \
+ *     vaifacedetect draw=false ! tee name=t \
+ *     t. ! queue ! vaioverlay ! autovideosink \
+ *     t. ! queue ! fakesink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+#include <gst/video/gstvideometa.h>
+#include "gstvaioverlay.h"
+
+/* OpenCV header files */
+#include <opencv2/core.hpp>
+#include <opencv2/opencv.hpp>
+#include <opencv2/imgproc.hpp>
+
+/* Header file for drawing in the detector formats */
+#include <yuvframe.hpp>
+
+GST_DEBUG_CATEGORY_STATIC (gst_vaioverlay_debug_category);
+#define GST_CAT_DEFAULT gst_vaioverlay_debug_category
+
+/* prototypes */
+static void gst_vaioverlay_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vaioverlay_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+
+static GstFlowReturn gst_vaioverlay_transform_frame_ip (GstVideoFilter * filter,
+    GstVideoFrame * frame);
+
+enum
+{
+  PROP_0,
+  PROP_COLOR,
+  PROP_LABELS
+};
+
+#define DEFAULT_COLOR 0xff00ff00
+#define DEFAULT_LABELS TRUE
+
+/* pad templates */
+
+/* Input format */
+#define VIDEO_SRC_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
+
+/* Output format */
+#define VIDEO_SINK_CAPS \
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
+
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVaioverlay, gst_vaioverlay, GST_TYPE_VIDEO_FILTER,
+  GST_DEBUG_CATEGORY_INIT (gst_vaioverlay_debug_category, "vaioverlay", 0,
+  "debug category for vaioverlay element"));
+
+static void
+gst_vaioverlay_class_init (GstVaioverlayClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstVideoFilterClass *video_filter_class = GST_VIDEO_FILTER_CLASS (klass);
+
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS(klass),
+      gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
+        gst_caps_from_string (VIDEO_SRC_CAPS)));
+  gst_element_class_add_pad_template (GST_ELEMENT_CLASS(klass),
+      gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
+        gst_caps_from_string (VIDEO_SINK_CAPS)));
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS(klass),
+      "Region of interest overlay",
+      "Filter/Effect/Video",
+      "Draws region of interest meta into the frame",
+      "Tom Simpson @ AVNET");
+
+  gobject_class->set_property = gst_vaioverlay_set_property;
+  gobject_class->get_property = gst_vaioverlay_get_property;
+
+  g_object_class_install_property (gobject_class, PROP_COLOR,
+      g_param_spec_uint ("color", "Color",
+          "Box and label color as 0xAARRGGBB, alpha is ignored",
+          0, G_MAXUINT32, DEFAULT_COLOR,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_CONTROLLABLE)));
+  g_object_class_install_property (gobject_class, PROP_LABELS,
+      g_param_spec_boolean ("labels", "Labels",
+          "Draw the region type above each box", DEFAULT_LABELS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_CONTROLLABLE)));
+
+  video_filter_class->transform_frame_ip = GST_DEBUG_FUNCPTR (gst_vaioverlay_transform_frame_ip);
+}
+
+static void
+gst_vaioverlay_init (GstVaioverlay *vaioverlay)
+{
+  vaioverlay->color = DEFAULT_COLOR;
+  vaioverlay->labels = DEFAULT_LABELS;
+}
+
+void
+gst_vaioverlay_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVaioverlay *vaioverlay = GST_VAIOVERLAY (object);
+
+  GST_DEBUG_OBJECT (vaioverlay, "set_property");
+
+  switch (property_id) {
+    case PROP_COLOR:
+      vaioverlay->color = g_value_get_uint (value);
+      break;
+    case PROP_LABELS:
+      vaioverlay->labels = g_value_get_boolean (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vaioverlay_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVaioverlay *vaioverlay = GST_VAIOVERLAY (object);
+
+  GST_DEBUG_OBJECT (vaioverlay, "get_property");
+
+  switch (property_id) {
+    case PROP_COLOR:
+      g_value_set_uint (value, vaioverlay->color);
+      break;
+    case PROP_LABELS:
+      g_value_set_boolean (value, vaioverlay->labels);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+/* transform */
+static GstFlowReturn
+gst_vaioverlay_transform_frame_ip (GstVideoFilter * filter, GstVideoFrame * frame)
+{
+  GstVaioverlay *vaioverlay = GST_VAIOVERLAY (filter);
+  GstVideoRegionOfInterestMeta *meta;
+  gpointer state = NULL;
+
+  cv::Rect bounds(0, 0, GST_VIDEO_FRAME_WIDTH(frame),
+      GST_VIDEO_FRAME_HEIGHT(frame));
+  cv::Scalar color((vaioverlay->color >> 0) & 0xff,
+      (vaioverlay->color >> 8) & 0xff, (vaioverlay->color >> 16) & 0xff);
+
+  /* Draw every region attached upstream */
+  while ((meta = (GstVideoRegionOfInterestMeta *)
+          gst_buffer_iterate_meta_filtered (frame->buffer, &state,
+              GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+    cv::Rect box(meta->x, meta->y, meta->w, meta->h);
+
+    box &= bounds;
+    DrawRectFrame(frame, box.x, box.y, box.x + box.width, box.y + box.height,
+        color, 2);
+
+    if (vaioverlay->labels && meta->roi_type)
+      DrawLabelFrame(frame, g_quark_to_string(meta->roi_type),
+          cv::Point(box.x, box.y), color);
+  }
+
+  GST_DEBUG_OBJECT (vaioverlay, "transform_frame_ip");
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "vaioverlay", GST_RANK_NONE,
+      GST_TYPE_VAIOVERLAY);
+}
+
+#ifndef VERSION
+#define VERSION "0.0.0"
+#endif
+#ifndef PACKAGE
+#define PACKAGE "vaioverlay"
+#endif
+#ifndef PACKAGE_NAME
+#define PACKAGE_NAME "GStreamer Xilinx Vitis-AI-Library"
+#endif
+#ifndef GST_PACKAGE_ORIGIN
+#define GST_PACKAGE_ORIGIN "http://xilinx.com; http://avnet.com"
+#endif
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    vaioverlay,
+    "Draws Vitis-AI-Library detections attached as meta",
+    plugin_init, VERSION, "LGPL", PACKAGE_NAME, GST_PACKAGE_ORIGIN)
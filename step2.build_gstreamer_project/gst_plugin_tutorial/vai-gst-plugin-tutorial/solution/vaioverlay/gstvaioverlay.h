@@ -0,0 +1,54 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_VAIOVERLAY_H_
+#define _GST_VAIOVERLAY_H_
+
+#include <gst/video/video.h>
+#include <gst/video/gstvideofilter.h>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAIOVERLAY   (gst_vaioverlay_get_type())
+#define GST_VAIOVERLAY(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VAIOVERLAY,GstVaioverlay))
+#define GST_VAIOVERLAY_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VAIOVERLAY,GstVaioverlayClass))
+#define GST_IS_VAIOVERLAY(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VAIOVERLAY))
+#define GST_IS_VAIOVERLAY_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VAIOVERLAY))
+
+typedef struct _GstVaioverlay GstVaioverlay;
+typedef struct _GstVaioverlayClass GstVaioverlayClass;
+
+struct _GstVaioverlay
+{
+  GstVideoFilter base_vaioverlay;
+
+  guint color;
+  gboolean labels;
+};
+
+struct _GstVaioverlayClass
+{
+  GstVideoFilterClass base_vaioverlay_class;
+};
+
+GType gst_vaioverlay_get_type (void);
+
+G_END_DECLS
+
+#endif
@@ -50,6 +50,13 @@
 
 /* Header file for custom drawing function */
 #include <drawboxes.hpp>
+#include <yuvframe.hpp>
+
+/* Header file for attaching detections as region of interest meta */
+#include <roimeta.hpp>
+
+/* Header file for the runners shared between element instances */
+#include <runnerpool.hpp>
 
 GST_DEBUG_CATEGORY_STATIC (gst_vaipersondetect_debug_category);
 #define GST_CAT_DEFAULT gst_vaipersondetect_debug_category
@@ -72,22 +79,41 @@ static GstFlowReturn gst_vaipersondetect_transform_frame (GstVideoFilter * filte
     GstVideoFrame * inframe, GstVideoFrame * outframe);
 static GstFlowReturn gst_vaipersondetect_transform_frame_ip (GstVideoFilter * filter,
     GstVideoFrame * frame);
+static GstFlowReturn gst_vaipersondetect_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_DRAW
 };
 
+#define DEFAULT_DRAW TRUE
+
 /* pad templates */
 
 /* Input format */
 #define VIDEO_SRC_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ BGR }")
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
 
 /* Output format */
 #define VIDEO_SINK_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ BGR }")
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
+
 
+#define MODEL_NAME "ssd_pedestrain_pruned_0_97"
+
+/* Run the model on one frame */
+static vitis::ai::SSDResult
+gst_vaipersondetect_run (const cv::Mat & img)
+{
+  /* Lease a person detection object, preloaded in start() */
+  auto person = RunnerPool<vitis::ai::SSD>::get().acquire(MODEL_NAME);
+
+  if (!person)
+    return vitis::ai::SSDResult{};
+  return person->run(img);
+}
 
 /* class initialization */
 
@@ -121,8 +147,19 @@ gst_vaipersondetect_class_init (GstVaipersondetectClass * klass)
   gobject_class->get_property = gst_vaipersondetect_get_property;
   gobject_class->dispose = gst_vaipersondetect_dispose;
   gobject_class->finalize = gst_vaipersondetect_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_DRAW,
+      g_param_spec_boolean ("draw", "Draw",
+          "Draw the detections into the frame; when disabled they are "
+          "attached as GstVideoRegionOfInterestMeta and the frame is left "
+          "untouched", DEFAULT_DRAW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
   base_transform_class->start = GST_DEBUG_FUNCPTR (gst_vaipersondetect_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vaipersondetect_stop);
+  base_transform_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_vaipersondetect_transform_ip);
   video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_vaipersondetect_set_info);
   video_filter_class->transform_frame_ip = GST_DEBUG_FUNCPTR (gst_vaipersondetect_transform_frame_ip);
 
@@ -131,6 +168,7 @@ gst_vaipersondetect_class_init (GstVaipersondetectClass * klass)
 static void
 gst_vaipersondetect_init (GstVaipersondetect *vaipersondetect)
 {
+  vaipersondetect->draw = DEFAULT_DRAW;
 }
 
 void
@@ -142,6 +180,9 @@ gst_vaipersondetect_set_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (vaipersondetect, "set_property");
 
   switch (property_id) {
+    case PROP_DRAW:
+      vaipersondetect->draw = g_value_get_boolean (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -157,6 +198,9 @@ gst_vaipersondetect_get_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (vaipersondetect, "get_property");
 
   switch (property_id) {
+    case PROP_DRAW:
+      g_value_set_boolean (value, vaipersondetect->draw);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -194,6 +238,13 @@ gst_vaipersondetect_start (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (vaipersondetect, "start");
 
+  /* Load the model now rather than on the first frame */
+  if (!RunnerPool<vitis::ai::SSD>::get ().ref (MODEL_NAME)) {
+    GST_ELEMENT_ERROR (vaipersondetect, RESOURCE, NOT_FOUND, (NULL),
+        ("Failed to load model '%s'", MODEL_NAME));
+    return FALSE;
+  }
+
   return TRUE;
 }
 
@@ -204,6 +255,8 @@ gst_vaipersondetect_stop (GstBaseTransform * trans)
 
   GST_DEBUG_OBJECT (vaipersondetect, "stop");
 
+  RunnerPool<vitis::ai::SSD>::get ().unref (MODEL_NAME);
+
   return TRUE;
 }
 
@@ -235,23 +288,60 @@ gst_vaipersondetect_transform_frame_ip (GstVideoFilter * filter, GstVideoFrame *
 {
   GstVaipersondetect *vaipersondetect = GST_VAIPERSONDETECT (filter);
 
-  /* Create person detection object */
-  thread_local auto person = vitis::ai::SSD::create("ssd_pedestrain_pruned_0_97");
-
-  /* Setup an OpenCV Mat with the frame data */
-  cv::Mat img(360, 640, CV_8UC3, GST_VIDEO_FRAME_PLANE_DATA(frame, 0));
+  /* Setup an OpenCV Mat with the frame data, converted from YUV */
+  cv::Mat img = FrameToBGR(frame, cv::Size(640, 360));
 
   /* Perform person detection */
-  auto results = person->run(img);
+  auto results = gst_vaipersondetect_run(img);
 
   /* Draw bounding boxes */
-  DrawBoxes(img, results.bboxes, cv::Scalar(0, 0, 255));
+  DrawBoxesFrame(frame, results.bboxes, cv::Scalar(0, 0, 255));
 
   GST_DEBUG_OBJECT (vaipersondetect, "transform_frame_ip");
 
   return GST_FLOW_OK;
 }
 
+/* With draw disabled the frame is only mapped for reading and the results
+ * go into meta, so the buffer memory is never copied to make it writable.
+ * Drawing goes through GstVideoFilter and transform_frame_ip(). */
+static GstFlowReturn
+gst_vaipersondetect_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstVaipersondetect *vaipersondetect = GST_VAIPERSONDETECT (trans);
+  GstVideoFilter *filter = GST_VIDEO_FILTER (trans);
+  GstVideoFrame frame;
+
+  if (vaipersondetect->draw)
+    return GST_BASE_TRANSFORM_CLASS (gst_vaipersondetect_parent_class)->
+        transform_ip (trans, buf);
+
+  if (!filter->negotiated)
+    return GST_FLOW_NOT_NEGOTIATED;
+
+  if (!gst_video_frame_map (&frame, &filter->in_info, buf, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (vaipersondetect, CORE, FAILED, (NULL),
+        ("Failed to map input buffer"));
+    return GST_FLOW_ERROR;
+  }
+
+  /* Setup an OpenCV Mat with the frame data, converted from YUV */
+  cv::Mat img = FrameToBGR(&frame, cv::Size(640, 360));
+
+  /* Perform person detection */
+  auto results = gst_vaipersondetect_run(img);
+  gst_video_frame_unmap (&frame);
+
+  /* Attach bounding boxes as meta */
+  AttachBoxes(buf, GST_VIDEO_INFO_WIDTH (&filter->in_info),
+      GST_VIDEO_INFO_HEIGHT (&filter->in_info), results.bboxes,
+      [] (const auto & box) { return "person"; });
+
+  GST_DEBUG_OBJECT (vaipersondetect, "transform_ip");
+
+  return GST_FLOW_OK;
+}
+
 static gboolean
 plugin_init (GstPlugin * plugin)
 {
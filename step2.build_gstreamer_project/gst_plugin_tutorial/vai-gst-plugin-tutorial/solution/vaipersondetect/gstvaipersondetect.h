@@ -38,6 +38,7 @@ struct _GstVaipersondetect
 {
   GstVideoFilter base_vaipersondetect;
 
+  gboolean draw;
 };
 
 struct _GstVaipersondetectClass
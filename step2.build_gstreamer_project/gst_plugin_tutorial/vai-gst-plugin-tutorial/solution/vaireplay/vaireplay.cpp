@@ -0,0 +1,229 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * vaireplay - a logged detection run shown on its recording
+ *
+ *  Puts the log written by vairesultsink back on the video it was
+ *  recorded with, drawn by vaioverlay, without the model or a DPU:
+ *
+ *    filesrc ! decodebin ! videoconvert ! vairesultimport ! vaioverlay
+ *        ! videoconvert ! autovideosink | x264enc ! mp4mux ! filesink
+ *
+ *  and prints per label how many boxes the run found and their mean
+ *  score, next to how many frames had a record.  With --headless nothing
+ *  is shown, for the summary alone.
+ *
+ *  The plugins are found through GST_PLUGIN_PATH; "make run" sets it to
+ *  the vairesult and vaioverlay directories.
+ */
+
+#include <cstdio>
+#include <map>
+#include <string>
+#include <gst/gst.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideometa.h>
+
+/* Boxes of one label */
+struct LabelStats
+{
+  guint64 boxes;
+  double score;
+};
+
+struct Summary
+{
+  guint64 frames;
+  guint64 with_boxes;
+  std::map<std::string, LabelStats> labels;
+};
+
+/* Options */
+static gchar *video = NULL;
+static gchar *results = NULL;
+static gchar *output = NULL;
+static gchar *sync_mode = g_strdup ("relative");
+static gint64 tolerance_ms = 5;
+static gboolean headless = FALSE;
+
+static GOptionEntry entries[] = {
+  {"video", 'v', 0, G_OPTION_ARG_FILENAME, &video,
+      "Recording to replay on", "FILE"},
+  {"results", 'r', 0, G_OPTION_ARG_FILENAME, &results,
+      "Log written by vairesultsink", "FILE"},
+  {"output", 'o', 0, G_OPTION_ARG_FILENAME, &output,
+      "Write an MP4 with the boxes instead of showing it", "FILE"},
+  {"sync-mode", 's', 0, G_OPTION_ARG_STRING, &sync_mode,
+      "Match records by pts, relative or frame", "MODE"},
+  {"tolerance-ms", 't', 0, G_OPTION_ARG_INT64, &tolerance_ms,
+      "Largest PTS difference between a frame and its record", "MS"},
+  {"headless", 0, 0, G_OPTION_ARG_NONE, &headless,
+      "Only print the summary", NULL},
+  {NULL}
+};
+
+/* Count the boxes vairesultimport attached, on the streaming thread */
+static GstPadProbeReturn
+OnBuffer (GstPad * pad, GstPadProbeInfo * info, gpointer data)
+{
+  Summary *summary = (Summary *) data;
+  GstBuffer *buf = GST_PAD_PROBE_INFO_BUFFER (info);
+  GstVideoRegionOfInterestMeta *meta;
+  gpointer state = NULL;
+  gboolean any = FALSE;
+
+  while ((meta = (GstVideoRegionOfInterestMeta *)
+          gst_buffer_iterate_meta_filtered (buf, &state,
+              GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+    LabelStats &stats = summary->labels[g_quark_to_string (meta->roi_type)];
+    GstStructure *detection =
+        gst_video_region_of_interest_meta_get_param (meta, "detection");
+    gdouble score = 0.0;
+
+    if (detection)
+      gst_structure_get_double (detection, "confidence", &score);
+    stats.boxes++;
+    stats.score += score;
+    any = TRUE;
+  }
+
+  summary->frames++;
+  if (any)
+    summary->with_boxes++;
+
+  return GST_PAD_PROBE_OK;
+}
+
+static std::string
+PipelineDescription ()
+{
+  gchar *desc;
+  std::string out;
+
+  desc = g_strdup_printf ("filesrc location=\"%s\" ! decodebin ! "
+      "videoconvert ! video/x-raw, format=BGR ! vairesultimport name=import "
+      "location=\"%s\" sync-mode=%s tolerance=%" G_GINT64_FORMAT " ! ",
+      video, results, sync_mode, tolerance_ms * GST_MSECOND);
+  out = desc;
+  g_free (desc);
+
+  if (headless) {
+    out += "fakesink sync=false";
+  } else if (output) {
+    desc = g_strdup_printf ("vaioverlay ! videoconvert ! x264enc ! mp4mux ! "
+        "filesink location=\"%s\"", output);
+    out += desc;
+    g_free (desc);
+  } else {
+    out += "vaioverlay ! videoconvert ! autovideosink";
+  }
+
+  return out;
+}
+
+static void
+Report (const Summary & summary, guint64 matched)
+{
+  printf ("\n%lu frames, %lu with a record, %lu with boxes\n",
+      (unsigned long) summary.frames, (unsigned long) matched,
+      (unsigned long) summary.with_boxes);
+  printf ("    %-20s %10s %10s %10s\n", "label", "boxes", "per frame",
+      "score");
+
+  for (auto &label : summary.labels) {
+    const LabelStats &stats = label.second;
+
+    printf ("    %-20s %10lu %10.2f %10.3f\n", label.first.c_str (),
+        (unsigned long) stats.boxes,
+        summary.frames ? (double) stats.boxes / summary.frames : 0.0,
+        stats.boxes ? stats.score / stats.boxes : 0.0);
+  }
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string description;
+  GOptionContext *context;
+  GError *error = NULL;
+  GstElement *pipeline, *import;
+  Summary summary = { 0, 0, {} };
+  guint64 matched = 0;
+  gboolean ok = FALSE;
+  GstMessage *msg;
+  GstPad *pad;
+  GstBus *bus;
+
+  context = g_option_context_new ("- replay a detection log on its video");
+  g_option_context_add_main_entries (context, entries, NULL);
+  g_option_context_add_group (context, gst_init_get_option_group ());
+  if (!g_option_context_parse (context, &argc, &argv, &error)) {
+    g_printerr ("%s\n", error->message);
+    return 2;
+  }
+  g_option_context_free (context);
+
+  if (!video || !results) {
+    g_printerr ("--video and --results are required\n");
+    return 2;
+  }
+
+  description = PipelineDescription ();
+  pipeline = gst_parse_launch (description.c_str (), &error);
+  if (!pipeline) {
+    g_printerr ("%s: %s\n", description.c_str (), error->message);
+    g_clear_error (&error);
+    return 1;
+  }
+
+  import = gst_bin_get_by_name (GST_BIN (pipeline), "import");
+  pad = gst_element_get_static_pad (import, "src");
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, OnBuffer, &summary,
+      NULL);
+  gst_object_unref (pad);
+
+  bus = gst_element_get_bus (pipeline);
+  if (gst_element_set_state (pipeline,
+          GST_STATE_PLAYING) != GST_STATE_CHANGE_FAILURE) {
+    msg = gst_bus_timed_pop_filtered (bus, GST_CLOCK_TIME_NONE,
+        (GstMessageType) (GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+
+    if (GST_MESSAGE_TYPE (msg) == GST_MESSAGE_ERROR) {
+      gst_message_parse_error (msg, &error, NULL);
+      g_printerr ("%s: %s\n", GST_OBJECT_NAME (GST_MESSAGE_SRC (msg)),
+          error->message);
+      g_clear_error (&error);
+    } else {
+      ok = TRUE;
+    }
+    gst_message_unref (msg);
+  }
+
+  g_object_get (import, "matched", &matched, NULL);
+  gst_element_set_state (pipeline, GST_STATE_NULL);
+  gst_object_unref (import);
+  gst_object_unref (bus);
+  gst_object_unref (pipeline);
+
+  if (ok)
+    Report (summary, matched);
+
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,408 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-gstvairesultimport
+ *
+ * The vairesultimport element reads a log written by vairesultsink and
+ * attaches each record's boxes to the matching frame of a video as
+ * GstVideoRegionOfInterestMeta, the same meta the detectors attach with
+ * draw=false, so vaioverlay or any other meta consumer can show a past
+ * run on its recording without the model.
+ *
+ * Records are matched to frames by sync-mode: pts takes the record with
+ * the nearest PTS within tolerance; relative does the same after lining
+ * up the first PTS of the log with the first PTS of the video, for a
+ * recording whose timestamps start over; frame takes the record with
+ * the frame number of the buffer count.
+ *
+ * <refsect2>
+ * <title>Replaying a logged run on its recording</title>
+ * |[
+ * gst-launch-1.0 filesrc location=scale.mp4 ! decodebin ! videoconvert ! \
+ *     video/x-raw, format=BGR ! vairesultimport location=scale.jsonl ! \
+ *     vaioverlay ! videoconvert ! autovideosink
+ * ]|
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <algorithm>
+#include <gst/gst.h>
+#include <gst/base/gstbasetransform.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideometa.h>
+#include "gstvairesultimport.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_vairesultimport_debug_category);
+#define GST_CAT_DEFAULT gst_vairesultimport_debug_category
+
+/* prototypes */
+static void gst_vairesultimport_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vairesultimport_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vairesultimport_finalize (GObject * object);
+
+static gboolean gst_vairesultimport_start (GstBaseTransform * trans);
+static gboolean gst_vairesultimport_stop (GstBaseTransform * trans);
+static GstFlowReturn gst_vairesultimport_transform_ip (GstBaseTransform *
+    trans, GstBuffer * buf);
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_SYNC_MODE,
+  PROP_TOLERANCE,
+  PROP_MATCHED
+};
+
+#define DEFAULT_LOCATION NULL
+#define DEFAULT_SYNC_MODE GST_VAIRESULT_SYNC_RELATIVE
+#define DEFAULT_TOLERANCE (5 * GST_MSECOND)
+
+/* pad templates */
+
+static GstStaticPadTemplate gst_vairesultimport_src_template =
+GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw(ANY)")
+    );
+
+static GstStaticPadTemplate gst_vairesultimport_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw(ANY)")
+    );
+
+GType
+gst_vairesult_sync_mode_get_type (void)
+{
+  static const GEnumValue modes[] = {
+    {GST_VAIRESULT_SYNC_PTS, "Nearest record PTS", "pts"},
+    {GST_VAIRESULT_SYNC_RELATIVE,
+        "Nearest record PTS, both counted from their first frame", "relative"},
+    {GST_VAIRESULT_SYNC_FRAME, "Record frame number", "frame"},
+    {0, NULL, NULL}
+  };
+  static gsize type = 0;
+
+  if (g_once_init_enter (&type))
+    g_once_init_leave (&type,
+        g_enum_register_static ("GstVairesultSyncMode", modes));
+
+  return type;
+}
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVairesultimport, gst_vairesultimport,
+  GST_TYPE_BASE_TRANSFORM,
+  GST_DEBUG_CATEGORY_INIT (gst_vairesultimport_debug_category,
+  "vairesultimport", 0, "debug category for vairesultimport element"));
+
+static void
+gst_vairesultimport_class_init (GstVairesultimportClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseTransformClass *base_transform_class =
+      GST_BASE_TRANSFORM_CLASS (klass);
+
+  gst_element_class_add_static_pad_template (GST_ELEMENT_CLASS (klass),
+      &gst_vairesultimport_src_template);
+  gst_element_class_add_static_pad_template (GST_ELEMENT_CLASS (klass),
+      &gst_vairesultimport_sink_template);
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS(klass),
+      "Detection result import",
+      "Filter/Video",
+      "Attaches the detections of a vairesultsink log as region of "
+      "interest meta",
+      "Tom Simpson @ AVNET");
+
+  gobject_class->set_property = gst_vairesultimport_set_property;
+  gobject_class->get_property = gst_vairesultimport_get_property;
+  gobject_class->finalize = gst_vairesultimport_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "Location",
+          "Log written by vairesultsink, jsonl or binary",
+          DEFAULT_LOCATION,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_SYNC_MODE,
+      g_param_spec_enum ("sync-mode", "Sync mode",
+          "How records are matched to frames",
+          GST_TYPE_VAIRESULT_SYNC_MODE, DEFAULT_SYNC_MODE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_TOLERANCE,
+      g_param_spec_uint64 ("tolerance", "Tolerance",
+          "Largest PTS difference (ns) between a frame and its record",
+          0, G_MAXUINT64, DEFAULT_TOLERANCE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_MATCHED,
+      g_param_spec_uint64 ("matched", "Matched",
+          "Frames a record was found for",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  base_transform_class->start = GST_DEBUG_FUNCPTR (gst_vairesultimport_start);
+  base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vairesultimport_stop);
+  base_transform_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_vairesultimport_transform_ip);
+}
+
+static void
+gst_vairesultimport_init (GstVairesultimport *vairesultimport)
+{
+  vairesultimport->location = g_strdup (DEFAULT_LOCATION);
+  vairesultimport->sync_mode = DEFAULT_SYNC_MODE;
+  vairesultimport->tolerance = DEFAULT_TOLERANCE;
+  vairesultimport->records = NULL;
+  vairesultimport->log_base = GST_CLOCK_TIME_NONE;
+  vairesultimport->stream_base = GST_CLOCK_TIME_NONE;
+  vairesultimport->frames = 0;
+  vairesultimport->matched = 0;
+
+  /* Only meta is added, the frame is never written */
+  gst_base_transform_set_in_place (GST_BASE_TRANSFORM (vairesultimport),
+      TRUE);
+}
+
+void
+gst_vairesultimport_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVairesultimport *vairesultimport = GST_VAIRESULTIMPORT (object);
+
+  GST_DEBUG_OBJECT (vairesultimport, "set_property");
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      g_free (vairesultimport->location);
+      vairesultimport->location = g_value_dup_string (value);
+      break;
+    case PROP_SYNC_MODE:
+      vairesultimport->sync_mode =
+          (GstVairesultSyncMode) g_value_get_enum (value);
+      break;
+    case PROP_TOLERANCE:
+      vairesultimport->tolerance = g_value_get_uint64 (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vairesultimport_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVairesultimport *vairesultimport = GST_VAIRESULTIMPORT (object);
+
+  GST_DEBUG_OBJECT (vairesultimport, "get_property");
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      g_value_set_string (value, vairesultimport->location);
+      break;
+    case PROP_SYNC_MODE:
+      g_value_set_enum (value, vairesultimport->sync_mode);
+      break;
+    case PROP_TOLERANCE:
+      g_value_set_uint64 (value, vairesultimport->tolerance);
+      break;
+    case PROP_MATCHED:
+      g_value_set_uint64 (value, vairesultimport->matched);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vairesultimport_finalize (GObject * object)
+{
+  GstVairesultimport *vairesultimport = GST_VAIRESULTIMPORT (object);
+
+  GST_DEBUG_OBJECT (vairesultimport, "finalize");
+
+  g_free (vairesultimport->location);
+  delete vairesultimport->records;
+
+  G_OBJECT_CLASS (gst_vairesultimport_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_vairesultimport_start (GstBaseTransform * trans)
+{
+  GstVairesultimport *vairesultimport = GST_VAIRESULTIMPORT (trans);
+  std::vector<ResultRecord> *records;
+  std::string error;
+
+  GST_DEBUG_OBJECT (vairesultimport, "start");
+
+  if (!vairesultimport->location) {
+    GST_ELEMENT_ERROR (vairesultimport, RESOURCE, NOT_FOUND,
+        ("No location set"), (NULL));
+    return FALSE;
+  }
+
+  records = new std::vector<ResultRecord> ();
+  if (!ResultLogRead (vairesultimport->location, *records, error)) {
+    GST_ELEMENT_ERROR (vairesultimport, RESOURCE, READ,
+        ("Could not read \"%s\"", vairesultimport->location),
+        ("%s", error.c_str ()));
+    delete records;
+    return FALSE;
+  }
+
+  /* Searched by the key of the sync mode; records without a PTS sort
+   * last and never match by PTS */
+  if (vairesultimport->sync_mode == GST_VAIRESULT_SYNC_FRAME)
+    std::stable_sort (records->begin (), records->end (),
+        [] (const ResultRecord & a, const ResultRecord & b) {
+          return a.frame < b.frame;
+        });
+  else
+    std::stable_sort (records->begin (), records->end (),
+        [] (const ResultRecord & a, const ResultRecord & b) {
+          return a.pts < b.pts;
+        });
+
+  GST_INFO_OBJECT (vairesultimport, "%" G_GSIZE_FORMAT " records in \"%s\"",
+      records->size (), vairesultimport->location);
+
+  delete vairesultimport->records;
+  vairesultimport->records = records;
+  vairesultimport->log_base = records->empty () ? GST_CLOCK_TIME_NONE :
+      records->front ().pts;
+  vairesultimport->stream_base = GST_CLOCK_TIME_NONE;
+  vairesultimport->frames = 0;
+  vairesultimport->matched = 0;
+
+  return TRUE;
+}
+
+static gboolean
+gst_vairesultimport_stop (GstBaseTransform * trans)
+{
+  GstVairesultimport *vairesultimport = GST_VAIRESULTIMPORT (trans);
+
+  GST_DEBUG_OBJECT (vairesultimport, "stop");
+
+  GST_INFO_OBJECT (vairesultimport, "%" G_GUINT64_FORMAT " of %"
+      G_GUINT64_FORMAT " frames matched", vairesultimport->matched,
+      vairesultimport->frames);
+
+  delete vairesultimport->records;
+  vairesultimport->records = NULL;
+
+  return TRUE;
+}
+
+/* The record for a frame, or NULL */
+static const ResultRecord *
+gst_vairesultimport_find (GstVairesultimport * self, GstClockTime pts)
+{
+  std::vector<ResultRecord> &records = *self->records;
+  std::vector<ResultRecord>::iterator it;
+  GstClockTime target, diff;
+
+  if (self->sync_mode == GST_VAIRESULT_SYNC_FRAME) {
+    it = std::lower_bound (records.begin (), records.end (), self->frames,
+        [] (const ResultRecord & r, guint64 frame) {
+          return r.frame < frame;
+        });
+    if (it != records.end () && it->frame == self->frames)
+      return &*it;
+    return NULL;
+  }
+
+  if (!GST_CLOCK_TIME_IS_VALID (pts))
+    return NULL;
+
+  target = pts;
+  if (self->sync_mode == GST_VAIRESULT_SYNC_RELATIVE) {
+    if (!GST_CLOCK_TIME_IS_VALID (self->stream_base))
+      self->stream_base = pts;
+    if (!GST_CLOCK_TIME_IS_VALID (self->log_base) || pts < self->stream_base)
+      return NULL;
+    target = pts - self->stream_base + self->log_base;
+  }
+
+  /* First record at or after the target, then the nearer of it and the
+   * one before */
+  it = std::lower_bound (records.begin (), records.end (), target,
+      [] (const ResultRecord & r, GstClockTime t) {
+        return r.pts < t;
+      });
+  if (it != records.begin () && (it == records.end () ||
+          target - (it - 1)->pts < it->pts - target))
+    --it;
+
+  if (it == records.end () || !GST_CLOCK_TIME_IS_VALID (it->pts))
+    return NULL;
+
+  diff = it->pts > target ? it->pts - target : target - it->pts;
+  if (diff > self->tolerance)
+    return NULL;
+
+  return &*it;
+}
+
+static GstFlowReturn
+gst_vairesultimport_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstVairesultimport *vairesultimport = GST_VAIRESULTIMPORT (trans);
+  const ResultRecord *record;
+
+  record = gst_vairesultimport_find (vairesultimport, GST_BUFFER_PTS (buf));
+  vairesultimport->frames++;
+
+  if (!record) {
+    GST_LOG_OBJECT (vairesultimport, "no record for %" GST_TIME_FORMAT,
+        GST_TIME_ARGS (GST_BUFFER_PTS (buf)));
+    return GST_FLOW_OK;
+  }
+
+  vairesultimport->matched++;
+  for (const ResultDetection & box : record->boxes) {
+    GstVideoRegionOfInterestMeta *meta =
+        gst_buffer_add_video_region_of_interest_meta (buf,
+        box.label.c_str (), box.x, box.y, box.w, box.h);
+
+    gst_video_region_of_interest_meta_add_param (meta,
+        gst_structure_new ("detection",
+            "confidence", G_TYPE_DOUBLE, (gdouble) box.score,
+            NULL));
+  }
+
+  return GST_FLOW_OK;
+}
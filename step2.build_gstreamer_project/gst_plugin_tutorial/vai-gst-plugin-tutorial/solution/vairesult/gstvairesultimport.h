@@ -0,0 +1,78 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_VAIRESULTIMPORT_H_
+#define _GST_VAIRESULTIMPORT_H_
+
+#include <gst/base/gstbasetransform.h>
+
+/* Header file for reading the result log back */
+#include <resultlog.hpp>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAIRESULTIMPORT   (gst_vairesultimport_get_type())
+#define GST_VAIRESULTIMPORT(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VAIRESULTIMPORT,GstVairesultimport))
+#define GST_VAIRESULTIMPORT_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VAIRESULTIMPORT,GstVairesultimportClass))
+#define GST_IS_VAIRESULTIMPORT(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VAIRESULTIMPORT))
+#define GST_IS_VAIRESULTIMPORT_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VAIRESULTIMPORT))
+
+#define GST_TYPE_VAIRESULT_SYNC_MODE (gst_vairesult_sync_mode_get_type())
+
+typedef enum
+{
+  GST_VAIRESULT_SYNC_PTS,
+  GST_VAIRESULT_SYNC_RELATIVE,
+  GST_VAIRESULT_SYNC_FRAME
+} GstVairesultSyncMode;
+
+typedef struct _GstVairesultimport GstVairesultimport;
+typedef struct _GstVairesultimportClass GstVairesultimportClass;
+
+struct _GstVairesultimport
+{
+  GstBaseTransform base_vairesultimport;
+
+  /* properties */
+  gchar *location;
+  GstVairesultSyncMode sync_mode;
+  GstClockTime tolerance;
+
+  /* the log, sorted by the key of the sync mode */
+  std::vector<ResultRecord> *records;
+
+  /* first PTS of the log and of the stream, for relative sync */
+  GstClockTime log_base;
+  GstClockTime stream_base;
+
+  guint64 frames;
+  guint64 matched;
+};
+
+struct _GstVairesultimportClass
+{
+  GstBaseTransformClass base_vairesultimport_class;
+};
+
+GType gst_vairesultimport_get_type (void);
+GType gst_vairesult_sync_mode_get_type (void);
+
+G_END_DECLS
+
+#endif
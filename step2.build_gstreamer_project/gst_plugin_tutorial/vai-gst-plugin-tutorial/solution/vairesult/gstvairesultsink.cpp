@@ -0,0 +1,392 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/**
+ * SECTION:element-gstvairesultsink
+ *
+ * The vairesultsink element writes the detections attached as
+ * GstVideoRegionOfInterestMeta by the Vitis-AI detectors running with
+ * draw=false to a log, one record per frame with the PTS and every box's
+ * label, score and pixel rectangle.  location is a file, or unix:<path>
+ * to stream to a listening Unix socket; format is jsonl or binary.
+ *
+ * The records go through a lock-free ring to a writer thread, so the
+ * streaming thread never waits for the disk or the socket.  When the
+ * writer falls ring-size frames behind, frames are left out of the log
+ * and counted in the dropped property.
+ *
+ * <refsect2>
+ * <title>Weighing station analytics next to the display</title>
+ * |[
+ * gst-launch-1.0 v4l2src ! video/x-raw, format=BGR ! \
+ *     vaitfssd draw=false weighing=true ! tee name=t \
+ *     t. ! queue ! vaioverlay ! kmssink \
+ *     t. ! queue ! vairesultsink location=/tmp/scale.jsonl
+ * ]|
+ * The log is put back on a recording of the video with vairesultimport,
+ * or the vaireplay tool.
+ * </refsect2>
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include <gst/gst.h>
+#include <gst/base/gstbasesink.h>
+#include <gst/video/video.h>
+#include <gst/video/gstvideometa.h>
+#include "gstvairesultsink.h"
+#include "gstvairesultimport.h"
+
+GST_DEBUG_CATEGORY_STATIC (gst_vairesultsink_debug_category);
+#define GST_CAT_DEFAULT gst_vairesultsink_debug_category
+
+/* prototypes */
+static void gst_vairesultsink_set_property (GObject * object,
+    guint property_id, const GValue * value, GParamSpec * pspec);
+static void gst_vairesultsink_get_property (GObject * object,
+    guint property_id, GValue * value, GParamSpec * pspec);
+static void gst_vairesultsink_finalize (GObject * object);
+
+static gboolean gst_vairesultsink_start (GstBaseSink * sink);
+static gboolean gst_vairesultsink_stop (GstBaseSink * sink);
+static GstFlowReturn gst_vairesultsink_render (GstBaseSink * sink,
+    GstBuffer * buffer);
+
+enum
+{
+  PROP_0,
+  PROP_LOCATION,
+  PROP_FORMAT,
+  PROP_RING_SIZE,
+  PROP_DROPPED
+};
+
+#define DEFAULT_LOCATION NULL
+#define DEFAULT_FORMAT RESULT_FORMAT_JSONL
+#define DEFAULT_RING_SIZE 256
+
+/* pad templates */
+
+static GstStaticPadTemplate gst_vairesultsink_sink_template =
+GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK,
+    GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw(ANY)")
+    );
+
+GType
+gst_vairesult_format_get_type (void)
+{
+  static const GEnumValue formats[] = {
+    {RESULT_FORMAT_JSONL, "One JSON object per line", "jsonl"},
+    {RESULT_FORMAT_BINARY, "Packed binary records", "binary"},
+    {0, NULL, NULL}
+  };
+  static gsize type = 0;
+
+  if (g_once_init_enter (&type))
+    g_once_init_leave (&type,
+        g_enum_register_static ("GstVairesultFormat", formats));
+
+  return type;
+}
+
+/* class initialization */
+
+G_DEFINE_TYPE_WITH_CODE (GstVairesultsink, gst_vairesultsink,
+  GST_TYPE_BASE_SINK,
+  GST_DEBUG_CATEGORY_INIT (gst_vairesultsink_debug_category, "vairesultsink",
+  0, "debug category for vairesultsink element"));
+
+static void
+gst_vairesultsink_class_init (GstVairesultsinkClass * klass)
+{
+  GObjectClass *gobject_class = G_OBJECT_CLASS (klass);
+  GstBaseSinkClass *base_sink_class = GST_BASE_SINK_CLASS (klass);
+
+  gst_element_class_add_static_pad_template (GST_ELEMENT_CLASS (klass),
+      &gst_vairesultsink_sink_template);
+
+  gst_element_class_set_static_metadata (GST_ELEMENT_CLASS(klass),
+      "Detection result log",
+      "Sink/Video",
+      "Writes region of interest meta to a file or socket",
+      "Tom Simpson @ AVNET");
+
+  gobject_class->set_property = gst_vairesultsink_set_property;
+  gobject_class->get_property = gst_vairesultsink_get_property;
+  gobject_class->finalize = gst_vairesultsink_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_LOCATION,
+      g_param_spec_string ("location", "Location",
+          "File to write, or unix:<path> for a listening Unix socket",
+          DEFAULT_LOCATION,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_FORMAT,
+      g_param_spec_enum ("format", "Format", "Record format",
+          GST_TYPE_VAIRESULT_FORMAT, DEFAULT_FORMAT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_RING_SIZE,
+      g_param_spec_uint ("ring-size", "Ring size",
+          "Frames the writer thread may fall behind before frames are "
+          "dropped from the log", 2, 65536, DEFAULT_RING_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_DROPPED,
+      g_param_spec_uint64 ("dropped", "Dropped",
+          "Frames left out of the log because the writer was behind",
+          0, G_MAXUINT64, 0,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  base_sink_class->start = GST_DEBUG_FUNCPTR (gst_vairesultsink_start);
+  base_sink_class->stop = GST_DEBUG_FUNCPTR (gst_vairesultsink_stop);
+  base_sink_class->render = GST_DEBUG_FUNCPTR (gst_vairesultsink_render);
+}
+
+static void
+gst_vairesultsink_init (GstVairesultsink *vairesultsink)
+{
+  vairesultsink->location = g_strdup (DEFAULT_LOCATION);
+  vairesultsink->format = DEFAULT_FORMAT;
+  vairesultsink->ring_size = DEFAULT_RING_SIZE;
+  vairesultsink->frames = 0;
+  vairesultsink->writer = NULL;
+
+  /* Results are logged as they come, not held back to the clock */
+  gst_base_sink_set_sync (GST_BASE_SINK (vairesultsink), FALSE);
+}
+
+void
+gst_vairesultsink_set_property (GObject * object, guint property_id,
+    const GValue * value, GParamSpec * pspec)
+{
+  GstVairesultsink *vairesultsink = GST_VAIRESULTSINK (object);
+
+  GST_DEBUG_OBJECT (vairesultsink, "set_property");
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      g_free (vairesultsink->location);
+      vairesultsink->location = g_value_dup_string (value);
+      break;
+    case PROP_FORMAT:
+      vairesultsink->format = (ResultFormat) g_value_get_enum (value);
+      break;
+    case PROP_RING_SIZE:
+      vairesultsink->ring_size = g_value_get_uint (value);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vairesultsink_get_property (GObject * object, guint property_id,
+    GValue * value, GParamSpec * pspec)
+{
+  GstVairesultsink *vairesultsink = GST_VAIRESULTSINK (object);
+
+  GST_DEBUG_OBJECT (vairesultsink, "get_property");
+
+  switch (property_id) {
+    case PROP_LOCATION:
+      g_value_set_string (value, vairesultsink->location);
+      break;
+    case PROP_FORMAT:
+      g_value_set_enum (value, vairesultsink->format);
+      break;
+    case PROP_RING_SIZE:
+      g_value_set_uint (value, vairesultsink->ring_size);
+      break;
+    case PROP_DROPPED:
+      GST_OBJECT_LOCK (vairesultsink);
+      g_value_set_uint64 (value, vairesultsink->writer ?
+          vairesultsink->writer->dropped () : 0);
+      GST_OBJECT_UNLOCK (vairesultsink);
+      break;
+    default:
+      G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
+      break;
+  }
+}
+
+void
+gst_vairesultsink_finalize (GObject * object)
+{
+  GstVairesultsink *vairesultsink = GST_VAIRESULTSINK (object);
+
+  GST_DEBUG_OBJECT (vairesultsink, "finalize");
+
+  g_free (vairesultsink->location);
+
+  G_OBJECT_CLASS (gst_vairesultsink_parent_class)->finalize (object);
+}
+
+static gboolean
+gst_vairesultsink_start (GstBaseSink * sink)
+{
+  GstVairesultsink *vairesultsink = GST_VAIRESULTSINK (sink);
+  ResultLogWriter *writer;
+  std::string error;
+
+  GST_DEBUG_OBJECT (vairesultsink, "start");
+
+  if (!vairesultsink->location) {
+    GST_ELEMENT_ERROR (vairesultsink, RESOURCE, NOT_FOUND,
+        ("No location set"), (NULL));
+    return FALSE;
+  }
+
+  writer = new ResultLogWriter (vairesultsink->ring_size,
+      vairesultsink->format);
+  if (!writer->open (vairesultsink->location, error)) {
+    GST_ELEMENT_ERROR (vairesultsink, RESOURCE, OPEN_WRITE,
+        ("Could not open \"%s\" for writing", vairesultsink->location),
+        ("%s", error.c_str ()));
+    delete writer;
+    return FALSE;
+  }
+
+  vairesultsink->frames = 0;
+  GST_OBJECT_LOCK (vairesultsink);
+  vairesultsink->writer = writer;
+  GST_OBJECT_UNLOCK (vairesultsink);
+
+  return TRUE;
+}
+
+static gboolean
+gst_vairesultsink_stop (GstBaseSink * sink)
+{
+  GstVairesultsink *vairesultsink = GST_VAIRESULTSINK (sink);
+  ResultLogWriter *writer;
+
+  GST_DEBUG_OBJECT (vairesultsink, "stop");
+
+  GST_OBJECT_LOCK (vairesultsink);
+  writer = vairesultsink->writer;
+  vairesultsink->writer = NULL;
+  GST_OBJECT_UNLOCK (vairesultsink);
+
+  if (writer) {
+    writer->close ();
+    GST_INFO_OBJECT (vairesultsink, "%" G_GUINT64_FORMAT " frames logged, %"
+        G_GUINT64_FORMAT " dropped", writer->written (), writer->dropped ());
+    delete writer;
+  }
+
+  return TRUE;
+}
+
+/* Copy the frame's region of interest meta into the ring, the writer
+ * thread formats and writes it */
+static GstFlowReturn
+gst_vairesultsink_render (GstBaseSink * sink, GstBuffer * buffer)
+{
+  GstVairesultsink *vairesultsink = GST_VAIRESULTSINK (sink);
+  ResultLogWriter *writer = vairesultsink->writer;
+  GstVideoRegionOfInterestMeta *meta;
+  gpointer state = NULL;
+  ResultFrame *frame;
+  guint skipped = 0;
+
+  if (writer->failed ()) {
+    GST_ELEMENT_ERROR (vairesultsink, RESOURCE, WRITE,
+        ("Could not write to \"%s\"", vairesultsink->location), (NULL));
+    return GST_FLOW_ERROR;
+  }
+
+  frame = writer->claim ();
+  if (!frame) {
+    GST_DEBUG_OBJECT (vairesultsink, "writer behind, frame %" G_GUINT64_FORMAT
+        " dropped", vairesultsink->frames++);
+    return GST_FLOW_OK;
+  }
+
+  frame->pts = GST_BUFFER_PTS (buffer);
+  frame->frame = vairesultsink->frames++;
+  frame->n = 0;
+
+  while ((meta = (GstVideoRegionOfInterestMeta *)
+          gst_buffer_iterate_meta_filtered (buffer, &state,
+              GST_VIDEO_REGION_OF_INTEREST_META_API_TYPE))) {
+    ResultBox *box = &frame->boxes[frame->n];
+    GstStructure *detection;
+    gdouble score = 0.0;
+
+    if (frame->n == RESULT_LOG_MAX_BOXES) {
+      skipped++;
+      continue;
+    }
+
+    detection = gst_video_region_of_interest_meta_get_param (meta,
+        "detection");
+    if (detection)
+      gst_structure_get_double (detection, "confidence", &score);
+
+    box->label = meta->roi_type;
+    box->score = score;
+    box->x = meta->x;
+    box->y = meta->y;
+    box->w = meta->w;
+    box->h = meta->h;
+    frame->n++;
+  }
+
+  writer->commit ();
+
+  if (skipped)
+    GST_WARNING_OBJECT (vairesultsink, "%u boxes beyond %d left out",
+        skipped, RESULT_LOG_MAX_BOXES);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+plugin_init (GstPlugin * plugin)
+{
+  return gst_element_register (plugin, "vairesultsink", GST_RANK_NONE,
+      GST_TYPE_VAIRESULTSINK) &&
+      gst_element_register (plugin, "vairesultimport", GST_RANK_NONE,
+      GST_TYPE_VAIRESULTIMPORT);
+}
+
+#ifndef VERSION
+#define VERSION "0.0.0"
+#endif
+#ifndef PACKAGE
+#define PACKAGE "vairesult"
+#endif
+#ifndef PACKAGE_NAME
+#define PACKAGE_NAME "GStreamer Xilinx Vitis-AI-Library"
+#endif
+#ifndef GST_PACKAGE_ORIGIN
+#define GST_PACKAGE_ORIGIN "http://xilinx.com; http://avnet.com"
+#endif
+
+GST_PLUGIN_DEFINE (GST_VERSION_MAJOR,
+    GST_VERSION_MINOR,
+    vairesult,
+    "Logs Vitis-AI-Library detections and puts them back on video",
+    plugin_init, VERSION, "LGPL", PACKAGE_NAME, GST_PACKAGE_ORIGIN)
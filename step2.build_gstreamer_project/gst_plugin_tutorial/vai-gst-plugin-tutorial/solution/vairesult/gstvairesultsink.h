@@ -0,0 +1,67 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#ifndef _GST_VAIRESULTSINK_H_
+#define _GST_VAIRESULTSINK_H_
+
+#include <gst/base/gstbasesink.h>
+
+/* Header file for the result log writer thread and its ring */
+#include <resultlog.hpp>
+
+G_BEGIN_DECLS
+
+#define GST_TYPE_VAIRESULTSINK   (gst_vairesultsink_get_type())
+#define GST_VAIRESULTSINK(obj)   (G_TYPE_CHECK_INSTANCE_CAST((obj),GST_TYPE_VAIRESULTSINK,GstVairesultsink))
+#define GST_VAIRESULTSINK_CLASS(klass)   (G_TYPE_CHECK_CLASS_CAST((klass),GST_TYPE_VAIRESULTSINK,GstVairesultsinkClass))
+#define GST_IS_VAIRESULTSINK(obj)   (G_TYPE_CHECK_INSTANCE_TYPE((obj),GST_TYPE_VAIRESULTSINK))
+#define GST_IS_VAIRESULTSINK_CLASS(obj)   (G_TYPE_CHECK_CLASS_TYPE((klass),GST_TYPE_VAIRESULTSINK))
+
+#define GST_TYPE_VAIRESULT_FORMAT (gst_vairesult_format_get_type())
+
+typedef struct _GstVairesultsink GstVairesultsink;
+typedef struct _GstVairesultsinkClass GstVairesultsinkClass;
+
+struct _GstVairesultsink
+{
+  GstBaseSink base_vairesultsink;
+
+  /* properties */
+  gchar *location;
+  ResultFormat format;
+  guint ring_size;
+
+  /* frames seen, numbering the log records */
+  guint64 frames;
+
+  /* writer thread, between start and stop */
+  ResultLogWriter *writer;
+};
+
+struct _GstVairesultsinkClass
+{
+  GstBaseSinkClass base_vairesultsink_class;
+};
+
+GType gst_vairesultsink_get_type (void);
+GType gst_vairesult_format_get_type (void);
+
+G_END_DECLS
+
+#endif
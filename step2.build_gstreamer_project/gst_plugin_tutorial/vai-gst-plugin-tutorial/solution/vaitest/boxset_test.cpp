@@ -0,0 +1,68 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * boxset_test - BoxSet pixel rectangles
+ *
+ *  A frame without detections, the common case, must give no rectangles
+ *  without touching the empty rows; build with
+ *  CFLAGS_EXTRA=-D_GLIBCXX_ASSERTIONS to have libstdc++ check that.
+ */
+
+#include <cstdio>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <boxset.hpp>
+
+#include "check.h"
+
+struct Box
+{
+  int label;
+  float score;
+  float x, y, width, height;
+};
+
+int
+main (int argc, char **argv)
+{
+  std::vector<cv::Rect> rects (3);
+  BoxSet set;
+
+  set.load (std::vector<Box> ());
+  set.pixels (640, 360, rects);
+  CHECK (rects.empty ());
+
+  set.load (std::vector<Box> { { 1, 0.5f, 0.1f, 0.1f, 0.2f, 0.2f },
+          { 2, 0.7f, 0.9f, 0.9f, 0.3f, 0.3f } });
+  set.pixels (640, 360, rects);
+  CHECK (rects.size () == 2);
+  CHECK (rects[0].x == 64 && rects[0].y == 36);
+  CHECK (rects[0].width == 128 && rects[0].height == 72);
+  CHECK (rects[1].x + rects[1].width <= 640);
+  CHECK (rects[1].y + rects[1].height <= 360);
+
+  set.load (std::vector<Box> ());
+  set.pixels (640, 360, rects);
+  CHECK (rects.empty ());
+
+  printf ("boxset_test: ok\n");
+  return 0;
+}
@@ -0,0 +1,42 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * check - the assertion the vaitest programs share
+ *
+ *  CHECK stops the test with the failed condition and its line, also in
+ *  builds with NDEBUG where assert would be compiled out.
+ */
+
+#ifndef __CHECK_H__
+#define __CHECK_H__
+
+#include <cstdio>
+#include <cstdlib>
+
+#define CHECK(cond) \
+  do { \
+    if (!(cond)) { \
+      fprintf (stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, \
+          #cond); \
+      exit (1); \
+    } \
+  } while (0)
+
+#endif /* __CHECK_H__ */
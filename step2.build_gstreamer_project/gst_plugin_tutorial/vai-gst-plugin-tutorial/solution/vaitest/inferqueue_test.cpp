@@ -0,0 +1,199 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * inferqueue_test - vaitfssd's async and batched inference queue
+ *
+ *  A CPU mock stands in for vitis::ai::TFSSD: it sleeps a varying time per
+ *  run, so with several workers the runs finish out of order, and reports
+ *  the size of the batch each frame went in.  Frames are pushed and popped
+ *  the way submit_input_buffer and generate_output do, with the PTS as the
+ *  tag.  They must come out in PTS order, a full batch must go out at
+ *  once, and a partial one after max_latency or as soon as somebody waits
+ *  on it.
+ */
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <inferqueue.hpp>
+
+#include "check.h"
+
+typedef std::chrono::steady_clock Clock;
+
+struct MockResult
+{
+  size_t batch = 0;             /* frames in the run this one went in */
+};
+
+/* Sleeps like a DPU run, longer on every other call */
+class MockRunner
+{
+public:
+  MockRunner () : runs_ (0) {}
+
+  std::vector<MockResult> run (const std::vector<cv::Mat> & imgs)
+  {
+    unsigned n = runs_++;
+
+    std::this_thread::sleep_for (std::chrono::milliseconds (1 + (n % 2) * 4));
+    return std::vector<MockResult> (imgs.size (), MockResult { imgs.size () });
+  }
+
+  unsigned runs () const { return runs_; }
+
+private:
+  std::atomic<unsigned> runs_;
+};
+
+static void *
+Tag (uintptr_t pts)
+{
+  return (void *) pts;
+}
+
+/* Several workers, every third frame skipping inference: all frames come
+ * back, in the order they were pushed */
+static void
+TestOrder ()
+{
+  InferQueue<MockResult> queue;
+  MockRunner runner;
+  std::vector<uintptr_t> out;
+  MockResult result;
+  void *tag;
+
+  queue.start (3, 4, 1, std::chrono::microseconds (0),
+      [&runner] (const std::vector<cv::Mat> & imgs) {
+        return runner.run (imgs);
+      });
+
+  for (uintptr_t pts = 1; pts <= 60; pts++) {
+    queue.push (Tag (pts), cv::Mat (), pts % 3 != 0);
+    while (queue.pop (&tag, &result, false))
+      out.push_back ((uintptr_t) tag);
+  }
+  while (queue.pop (&tag, &result, true))
+    out.push_back ((uintptr_t) tag);
+  queue.stop ();
+
+  CHECK (out.size () == 60);
+  for (size_t i = 0; i < out.size (); i++)
+    CHECK (out[i] == i + 1);
+  CHECK (runner.runs () == 40);
+}
+
+/* Milliseconds since 'start' */
+static long
+Elapsed (Clock::time_point start)
+{
+  return std::chrono::duration_cast<std::chrono::milliseconds>
+      (Clock::now () - start).count ();
+}
+
+static void
+TestBatch ()
+{
+  InferQueue<MockResult> queue;
+  MockRunner runner;
+  MockResult result;
+  Clock::time_point start;
+  void *tag;
+
+  queue.start (1, 8, 4, std::chrono::microseconds (200000),
+      [&runner] (const std::vector<cv::Mat> & imgs) {
+        return runner.run (imgs);
+      });
+
+  /* A partial batch is held until max_latency, then flushed on its own */
+  start = Clock::now ();
+  queue.push (Tag (1), cv::Mat ());
+  std::this_thread::sleep_for (std::chrono::milliseconds (20));
+  CHECK (!queue.pop (&tag, &result, false));
+  while (!queue.pop (&tag, &result, false)) {
+    CHECK (Elapsed (start) < 2000);
+    std::this_thread::sleep_for (std::chrono::milliseconds (1));
+  }
+  CHECK (Elapsed (start) >= 200);
+  CHECK ((uintptr_t) tag == 1 && result.batch == 1);
+
+  /* A full batch goes out at once, as one run */
+  start = Clock::now ();
+  for (uintptr_t pts = 2; pts <= 5; pts++)
+    queue.push (Tag (pts), cv::Mat ());
+  for (uintptr_t pts = 2; pts <= 5; pts++) {
+    CHECK (queue.pop (&tag, &result, true));
+    CHECK ((uintptr_t) tag == pts && result.batch == 4);
+  }
+  CHECK (Elapsed (start) < 200);
+
+  /* Waiting on a partial batch dispatches it without the max_latency */
+  start = Clock::now ();
+  queue.push (Tag (6), cv::Mat ());
+  queue.push (Tag (7), cv::Mat ());
+  CHECK (queue.pop (&tag, &result, true));
+  CHECK ((uintptr_t) tag == 6 && result.batch == 2);
+  CHECK (queue.pop (&tag, &result, true));
+  CHECK ((uintptr_t) tag == 7);
+  CHECK (Elapsed (start) < 200);
+
+  queue.stop ();
+  CHECK (runner.runs () == 3);
+}
+
+/* Jobs no worker picked up yet come back empty after stop, in order */
+static void
+TestStop ()
+{
+  InferQueue<MockResult> queue;
+  MockResult result;
+  void *tag;
+
+  queue.start (1, 8, 4, std::chrono::microseconds (10000000),
+      [] (const std::vector<cv::Mat> & imgs) {
+        return std::vector<MockResult> (imgs.size (), MockResult { 1 });
+      });
+  queue.push (Tag (1), cv::Mat ());
+  queue.push (Tag (2), cv::Mat ());
+  queue.stop ();
+
+  for (uintptr_t pts = 1; pts <= 2; pts++) {
+    result.batch = 99;
+    CHECK (queue.pop (&tag, &result, false));
+    CHECK ((uintptr_t) tag == pts && result.batch == 0);
+  }
+  CHECK (queue.size () == 0);
+}
+
+int
+main (int argc, char **argv)
+{
+  TestOrder ();
+  TestBatch ();
+  TestStop ();
+
+  printf ("inferqueue_test: ok\n");
+  return 0;
+}
@@ -0,0 +1,91 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * streamscheduler_test - vaimultidetect's batching across streams
+ *
+ *  Two streams share a scheduler with room for four frames per batch.
+ *  While both run, a frame from one waits max_latency for the other to
+ *  fill the batch; once the other stream has ended, the same frame must
+ *  go out at once, and wait again after that stream starts over.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <vector>
+#include <opencv2/core.hpp>
+
+#include <streamscheduler.hpp>
+
+#include "check.h"
+
+typedef std::chrono::steady_clock Clock;
+
+#define MAX_LATENCY std::chrono::milliseconds (200)
+
+/* Submit one frame on 'stream', returns how long it took in ms */
+static long
+Submit (StreamScheduler<size_t> & scheduler, unsigned stream)
+{
+  Clock::time_point start = Clock::now ();
+  size_t batch = 0;
+
+  CHECK (scheduler.submit (stream, cv::Mat (), 1,
+          std::chrono::milliseconds (33), &batch));
+  CHECK (batch == 1);
+
+  return std::chrono::duration_cast<std::chrono::milliseconds> (
+      Clock::now () - start).count ();
+}
+
+int
+main ()
+{
+  StreamScheduler<size_t> scheduler;
+
+  scheduler.add_stream (0);
+  scheduler.add_stream (1);
+  scheduler.start (4, MAX_LATENCY,
+      [] (const std::vector<cv::Mat> & imgs) {
+        return std::vector<size_t> (imgs.size (), imgs.size ());
+      });
+
+  /* Both streams running, stream 1 sends nothing: wait for it */
+  CHECK (Submit (scheduler, 0) >= 150);
+
+  /* Stream 1 reached EOS */
+  scheduler.set_ended (1, true);
+  CHECK (Submit (scheduler, 0) < 100);
+  CHECK (Submit (scheduler, 0) < 100);
+
+  /* and started again */
+  scheduler.set_ended (1, false);
+  CHECK (Submit (scheduler, 0) >= 150);
+
+  /* A released pad is gone for good, ended or not */
+  scheduler.set_ended (1, true);
+  scheduler.remove_stream (1);
+  scheduler.set_ended (1, false);
+  CHECK (Submit (scheduler, 0) < 100);
+
+  scheduler.stop ();
+
+  printf ("streamscheduler_test: ok\n");
+  return 0;
+}
@@ -0,0 +1,78 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * tracker_test - BoxTracker extrapolation between detections
+ *
+ *  A box seen moving right is predicted further right on the frames that
+ *  skip inference, but slows down, comes to rest and never leaves the
+ *  frame however long inference stays off.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+#include <tracker.hpp>
+
+#include "check.h"
+
+struct Box
+{
+  float x, y, width, height;
+};
+
+int
+main (int argc, char **argv)
+{
+  BoxTracker<Box> tracker;
+  std::vector<Box> boxes;
+  float last;
+
+  tracker.update ({ { 0.50f, 0.40f, 0.2f, 0.2f } });
+  tracker.update ({ { 0.60f, 0.40f, 0.2f, 0.2f } });
+
+  /* Keeps moving, at a decaying speed */
+  boxes = tracker.predict ();
+  CHECK (boxes.size () == 1 && std::fabs (boxes[0].x - 0.70f) < 1e-5f);
+  last = boxes[0].x;
+  boxes = tracker.predict ();
+  CHECK (boxes[0].x > last && boxes[0].x - last < 0.1f);
+
+  /* Stops at the frame edge and stays there */
+  for (int i = 0; i < 10000; i++) {
+    boxes = tracker.predict ();
+    CHECK (boxes[0].x >= 0.0f && boxes[0].x + boxes[0].width <= 1.0f);
+    CHECK (boxes[0].y == 0.40f);
+  }
+  CHECK (std::fabs (boxes[0].x - 0.80f) < 1e-5f);
+
+  /* A slow box on a long skip comes to rest inside the frame */
+  tracker.reset ();
+  tracker.update ({ { 0.10f, 0.10f, 0.1f, 0.1f } });
+  tracker.update ({ { 0.11f, 0.10f, 0.1f, 0.1f } });
+  for (int i = 0; i < 100; i++)
+    boxes = tracker.predict ();
+  last = boxes[0].x;
+  CHECK (last < 0.11f + 0.01f / (1.0f - 0.8f) + 1e-5f);
+  CHECK (tracker.predict ()[0].x == last);
+
+  printf ("tracker_test: ok\n");
+  return 0;
+}
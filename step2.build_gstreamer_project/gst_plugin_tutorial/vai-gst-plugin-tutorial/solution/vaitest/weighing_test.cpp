@@ -0,0 +1,104 @@
+/* GStreamer
+ * Copyright (C) 2020 AVNET Inc.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * weighing_test - vaitfssd's inference gating and weighing votes
+ *
+ *  Drives InferGate and WeighingEvent the way gst_vaitfssd_should_infer
+ *  and gst_vaitfssd_weigh do, with a fruit seen on every detected frame,
+ *  and counts the weighing results that would be posted as
+ *  fruit-identified.  A scene that stays still must give exactly one, and
+ *  every scene change one more.
+ */
+
+#include <cstdio>
+#include <opencv2/core.hpp>
+
+#include <weighing.hpp>
+
+#include "check.h"
+
+/* Run 'frames' frames of a still scene of gray level 'level', returns how
+ * many results were locked and counts the inferred frames */
+static int
+Weigh (InferGate & gate, WeighingEvent & event, unsigned interval,
+    int level, int frames, int *inferred)
+{
+  cv::Mat img (360, 640, CV_8UC3, cv::Scalar::all (level));
+  int posted = 0;
+
+  for (int i = 0; i < frames; i++) {
+    if (!gate.admit (img, interval, 0.1, &event))
+      continue;
+    (*inferred)++;
+    if (event.feed (3, 0.9))
+      posted++;
+  }
+
+  return posted;
+}
+
+static void
+TestInterval (unsigned interval)
+{
+  InferGate gate;
+  WeighingEvent event (5, 0.6);
+  int inferred = 0;
+
+  /* One weighing, however long the fruit stays */
+  CHECK (Weigh (gate, event, interval, 100, 200, &inferred) == 1);
+  CHECK (event.locked () && event.label () == 3);
+
+  /* Inference stops once locked: the window plus the first frame, which
+   * always runs, at most one interval apart */
+  CHECK (inferred <= 5 * (int) interval + 1);
+
+  /* The next fruit is a new weighing, and only one */
+  CHECK (Weigh (gate, event, interval, 200, 200, &inferred) == 1);
+  CHECK (Weigh (gate, event, interval, 200, 200, &inferred) == 0);
+}
+
+/* Without weighing every frame goes through with an interval of one */
+static void
+TestNoWeighing ()
+{
+  cv::Mat img (360, 640, CV_8UC3, cv::Scalar::all (100));
+  InferGate gate;
+  int inferred = 0;
+
+  for (int i = 0; i < 10; i++)
+    inferred += gate.admit (img, 1, 0.1, NULL);
+  CHECK (inferred == 10);
+
+  inferred = 0;
+  for (int i = 0; i < 9; i++)
+    inferred += gate.admit (img, 3, 0.1, NULL);
+  CHECK (inferred == 3);
+}
+
+int
+main (int argc, char **argv)
+{
+  TestInterval (1);
+  TestInterval (3);
+  TestNoWeighing ();
+
+  printf ("weighing_test: ok\n");
+  return 0;
+}
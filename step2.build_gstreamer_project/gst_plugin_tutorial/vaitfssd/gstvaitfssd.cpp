@@ -21,6 +21,25 @@
  *
  * The vaitfssd element does FIXME stuff.
  *
+ * With tiling the frame is detected at its own resolution in overlapping
+ * tiles of the model input size, so small fruit is not scaled away; tiles
+ * without motion since they were last detected keep their boxes.  Take
+ * the full camera resolution rather than the 640x360 the scaler gives:
+ * |[
+ * gst-launch-1.0 v4l2src device=/dev/video2 io-mode=4 ! \
+ *     video/x-raw, width=1920, height=1080, format=BGR ! \
+ *     vaitfssd tiling=true tile-overlap=0.2 ! kmssink
+ * ]|
+ *
+ * The model property may be changed while playing, e.g. from
+ * ssd_mobilenet_v1_coco_tf to a model retrained on fruit with the same
+ * COCO label map.  The new model loads in the background while the
+ * current one keeps detecting and takes over between two frames once it
+ * is ready, announced by a vai-model-changed element message; no frame is
+ * dropped, and the old model is unloaded after its last inference.  A
+ * model that fails to load leaves the current one running, with a
+ * warning.
+ *
  * <refsect2>
  * <title>Example launch line</title>
  * |[
@@ -48,6 +67,23 @@
     /* Vitis-AI-Library specific header files */
     #include <vitis/ai/tfssd.hpp>
     #include <vitis/ai/nnpp/tfssd.hpp>
+
+/* Header file for attaching detections as region of interest meta */
+#include <roimeta.hpp>
+
+/* Header file for the runners shared between element instances, leased
+ * through the model swap */
+#include <runnerpool.hpp>
+
+/* Header file for the box and label drawing kernels, in BGR and YUV */
+#include <yuvframe.hpp>
+
+/* Header file for logging the stage split to the vaistats tracer */
+#include <vaistatstracer.hpp>
+
+/* Header file for the dmabuf pool offered upstream */
+#include <dmabufpool.hpp>
+
 using namespace std;
 const string classes[80]= {"person","bicycle","car","motobike","aeroplane","bus","train","truck","boat","traffic light",
 "fire hydrant","stop sign","parking meter","bench","bird","cat","dog","horse","sheep","cow",
@@ -58,7 +94,9 @@ const string classes[80]= {"person","bicycle","car","motobike","aeroplane","bus"
 "diningtable","toilet","tvmonitor","laptop","mouse","remote","keyboard","cell phone","micowave","oven",
 "toaster","sink","refrigerator","book","clock","vase","scissors","teddy bear","hair drier","toothbrush"
 };
-string class_label;
+
+/* Classes that count as fruit on the scale */
+static const int fruit_classes[] = { 46, 47, 49, 50, 51 };
 
 GST_DEBUG_CATEGORY_STATIC (gst_vaitfssd_debug_category);
 #define GST_CAT_DEFAULT gst_vaitfssd_debug_category
@@ -75,28 +113,532 @@ static void gst_vaitfssd_finalize (GObject * object);
 
 static gboolean gst_vaitfssd_start (GstBaseTransform * trans);
 static gboolean gst_vaitfssd_stop (GstBaseTransform * trans);
+static gboolean gst_vaitfssd_propose_allocation (GstBaseTransform * trans,
+    GstQuery * decide_query, GstQuery * query);
 static gboolean gst_vaitfssd_set_info (GstVideoFilter * filter, GstCaps * incaps,
     GstVideoInfo * in_info, GstCaps * outcaps, GstVideoInfo * out_info);
 static GstFlowReturn gst_vaitfssd_transform_frame (GstVideoFilter * filter,
     GstVideoFrame * inframe, GstVideoFrame * outframe);
-static GstFlowReturn gst_vaitfssd_transform_frame_ip (GstVideoFilter * filter,
-    GstVideoFrame * frame);
+static GstFlowReturn gst_vaitfssd_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input);
+static GstFlowReturn gst_vaitfssd_generate_output (GstBaseTransform * trans,
+    GstBuffer ** outbuf);
+static gboolean gst_vaitfssd_sink_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_vaitfssd_src_event (GstBaseTransform * trans,
+    GstEvent * event);
+static gboolean gst_vaitfssd_query (GstBaseTransform * trans,
+    GstPadDirection direction, GstQuery * query);
+static GstFlowReturn gst_vaitfssd_transform_ip (GstBaseTransform * trans,
+    GstBuffer * buf);
 
 enum
 {
-  PROP_0
+  PROP_0,
+  PROP_MODEL,
+  PROP_ASYNC,
+  PROP_NUM_WORKERS,
+  PROP_MAX_IN_FLIGHT,
+  PROP_BATCH_SIZE,
+  PROP_MAX_BATCH_LATENCY,
+  PROP_DRAW,
+  PROP_INFERENCE_INTERVAL,
+  PROP_SCENE_CHANGE_THRESHOLD,
+  PROP_WEIGHING,
+  PROP_VOTE_WINDOW,
+  PROP_VOTE_RATIO,
+  PROP_LEAKY_INFERENCE,
+  PROP_MAX_LATENESS,
+  PROP_STATS_INTERVAL,
+  PROP_LATENCY_P50,
+  PROP_LATENCY_P95,
+  PROP_LATENCY_P99,
+  PROP_THRESHOLD,
+  PROP_CLASSES,
+  PROP_MAX_DETECTIONS,
+  PROP_NMS_THRESHOLD,
+  PROP_NMS_CLASS_AGNOSTIC,
+  PROP_TILING,
+  PROP_TILE_OVERLAP,
+  PROP_TILE_MOTION_THRESHOLD
 };
 
+#define DEFAULT_MODEL "ssd_mobilenet_v1_coco_tf"
+#define DEFAULT_ASYNC FALSE
+#define DEFAULT_NUM_WORKERS 2
+#define DEFAULT_MAX_IN_FLIGHT 4
+#define DEFAULT_BATCH_SIZE 1
+#define DEFAULT_MAX_BATCH_LATENCY (20 * GST_MSECOND)
+#define DEFAULT_DRAW TRUE
+#define DEFAULT_INFERENCE_INTERVAL 1
+#define DEFAULT_SCENE_CHANGE_THRESHOLD 0.1
+#define DEFAULT_WEIGHING FALSE
+#define DEFAULT_VOTE_WINDOW 15
+#define DEFAULT_VOTE_RATIO 0.7
+#define DEFAULT_LEAKY_INFERENCE FALSE
+#define DEFAULT_MAX_LATENESS (100 * GST_MSECOND)
+#define DEFAULT_STATS_INTERVAL 0
+#define DEFAULT_THRESHOLD 0.0
+#define DEFAULT_CLASSES NULL
+#define DEFAULT_MAX_DETECTIONS 0
+#define DEFAULT_NMS_THRESHOLD 0.0
+#define DEFAULT_NMS_CLASS_AGNOSTIC FALSE
+#define DEFAULT_TILING FALSE
+#define DEFAULT_TILE_OVERLAP 0.2
+#define DEFAULT_TILE_MOTION_THRESHOLD 0.02
+
+/* A frame held in the inference queue */
+typedef struct
+{
+  GstVideoFrame frame;
+  gboolean infer;               /* FALSE when the tracker fills in results */
+  GstClockTime start;           /* when the frame entered the element */
+  StageTimer timer;
+} GstVaitfssdJob;
+
 /* pad templates */
 
-/* FIXME: add/remove formats you can handle */
+/* Camera formats are taken as they are, only the model input is converted */
 #define VIDEO_SRC_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ BGR }")
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
 
-/* FIXME: add/remove formats you can handle */
 #define VIDEO_SINK_CAPS \
-    GST_VIDEO_CAPS_MAKE("{ BGR }")
+    GST_VIDEO_CAPS_MAKE("{ BGR, NV12, YUY2, I420 }")
+
+
+/* inference helpers */
+
+/* The model input for a mapped frame.  A BGR frame is wrapped in a Mat
+ * header without copying, with the stride from the frame, since a
+ * buffer's video meta may pad rows beyond the negotiated stride.  A YUV
+ * frame is sampled down to the model input size and only that is
+ * converted to BGR. */
+static cv::Mat
+gst_vaitfssd_frame_mat (GstVaitfssd * vaitfssd, GstVideoFrame * frame)
+{
+  return FrameToBGR(frame, cv::Size(vaitfssd->input_width,
+      vaitfssd->input_height));
+}
+
+/* Lease an ssd detection object of the current model from the pool,
+ * preloaded in start() or when the model was swapped */
+static ModelSwap<vitis::ai::TFSSD>::Lease
+gst_vaitfssd_runner (GstVaitfssd * vaitfssd)
+{
+  return vaitfssd->models->acquire();
+}
+
+static vitis::ai::TFSSDResult
+gst_vaitfssd_run (GstVaitfssd * vaitfssd, const cv::Mat & img)
+{
+  /* Perform ssd detection */
+  return gst_vaitfssd_runner(vaitfssd)->run(img);
+}
+
+/* Run a batch of frames, split into chunks of the model's batch size */
+static std::vector<vitis::ai::TFSSDResult>
+gst_vaitfssd_run_batch (GstVaitfssd * vaitfssd,
+    const std::vector<cv::Mat> & imgs)
+{
+  auto ssd = gst_vaitfssd_runner(vaitfssd);
+  size_t batch = std::max<size_t> (ssd->get_input_batch(), 1);
+  std::vector<vitis::ai::TFSSDResult> results;
+
+  if (imgs.size() == 1) {
+    results.push_back(ssd->run(imgs[0]));
+    return results;
+  }
+
+  for (size_t i = 0; i < imgs.size(); i += batch) {
+    std::vector<cv::Mat> chunk(imgs.begin() + i,
+        imgs.begin() + std::min(i + batch, imgs.size()));
+    auto out = ssd->run(chunk);
+
+    results.insert(results.end(), out.begin(), out.end());
+  }
+
+  return results;
+}
+
+/* Detect on the tiles of a frame that moved since they last went through
+ * the model, as one batch, and merge the boxes of all tiles */
+static vitis::ai::TFSSDResult
+gst_vaitfssd_run_tiles (GstVaitfssd * vaitfssd, GstVideoFrame * frame)
+{
+  FrameTiler<vitis::ai::TFSSDResult::BoundingBox> *tiler = vaitfssd->tiler;
+  double threshold = vaitfssd->tile_motion_threshold;
+  vitis::ai::TFSSDResult results;
+  std::vector<cv::Mat> imgs;
+  std::vector<size_t> moved;
+
+  /* The motion check looks at a thumbnail, so a YUV tile is only
+   * converted in full when it goes to the model */
+  for (size_t i = 0; i < tiler->size (); i++) {
+    const cv::Rect &tile = tiler->tile (i);
+
+    if (tiler->moved (i, FrameRegionToBGR (frame, tile, tiler->thumb_size ()),
+            threshold)) {
+      moved.push_back (i);
+      imgs.push_back (FrameRegionToBGR (frame, tile, tile.size ()));
+    }
+  }
+
+  GST_LOG_OBJECT (vaitfssd, "%" G_GSIZE_FORMAT " of %" G_GSIZE_FORMAT
+      " tiles moved", moved.size (), tiler->size ());
+
+  if (!imgs.empty ()) {
+    auto out = gst_vaitfssd_run_batch (vaitfssd, imgs);
+
+    for (size_t i = 0; i < moved.size () && i < out.size (); i++)
+      tiler->update (moved[i], out[i].bboxes);
+  }
+
+  results.width = vaitfssd->width;
+  results.height = vaitfssd->height;
+  results.bboxes = tiler->merge ();
+
+  return results;
+}
+
+/* Draw into the frame in its own format */
+static void
+gst_vaitfssd_draw (GstVideoFrame * frame, const vitis::ai::TFSSDResult & results)
+{
+  std::vector<cv::Rect> rects;
+  BoxSet set;
+
+  /* Pixel rectangles of all boxes at once, clamped to the frame */
+  set.load(results.bboxes);
+  set.pixels(GST_VIDEO_FRAME_WIDTH(frame), GST_VIDEO_FRAME_HEIGHT(frame),
+      rects);
+
+  /* Draw bounding boxes */
+  for (size_t i = 0; i < rects.size(); i++)
+  {
+    const string &class_label = classes[results.bboxes[i].label];
+    const cv::Rect &rect = rects[i];
+
+    DrawRectFrame(frame, rect.x, rect.y, rect.x + rect.width,
+        rect.y + rect.height, cv::Scalar(0, 255, 0), 2);
+    DrawLabelFrame(frame, class_label, rect.tl(), cv::Scalar(0, 255, 0));
+  }
+}
+
+/* Decide whether the model runs on this frame, see InferGate */
+static gboolean
+gst_vaitfssd_should_infer (GstVaitfssd * vaitfssd, const cv::Mat & img)
+{
+  WeighingEvent *event = vaitfssd->weighing ? vaitfssd->event : NULL;
+  gboolean locked = event && event->locked ();
+
+  if (!vaitfssd->gate->admit (img, vaitfssd->inference_interval,
+          vaitfssd->scene_change_threshold, event))
+    return FALSE;
+
+  if (locked)
+    GST_DEBUG_OBJECT (vaitfssd, "scene changed, weighing event done");
+  GST_LOG_OBJECT (vaitfssd, "inference, scene change score %f",
+      vaitfssd->gate->score ());
+
+  return TRUE;
+}
+
+/* Feed fresh results to the tracker, or take the tracked boxes for a frame
+ * that skipped inference.  Must be called in frame order. */
+static void
+gst_vaitfssd_track (GstVaitfssd * vaitfssd, gboolean infer,
+    vitis::ai::TFSSDResult & results)
+{
+  if (infer)
+    vaitfssd->tracker->update (results.bboxes);
+  else
+    results.bboxes = vaitfssd->tracker->predict ();
+}
+
+/* Vote with the best fruit of a detected frame and announce the weighing
+ * result once it is stable */
+static void
+gst_vaitfssd_weigh (GstVaitfssd * vaitfssd,
+    const vitis::ai::TFSSDResult & results, GstClockTime pts)
+{
+  int label = -1;
+  double score = 0.0;
+
+  for (auto &box : results.bboxes) {
+    if (box.score > score && std::find (std::begin (fruit_classes),
+            std::end (fruit_classes), box.label) != std::end (fruit_classes)) {
+      label = box.label;
+      score = box.score;
+    }
+  }
+
+  if (!vaitfssd->event->feed (label, score))
+    return;
+
+  GST_INFO_OBJECT (vaitfssd, "identified %s (%f) at %" GST_TIME_FORMAT,
+      classes[vaitfssd->event->label ()].c_str (), vaitfssd->event->score (),
+      GST_TIME_ARGS (pts));
+
+  gst_element_post_message (GST_ELEMENT (vaitfssd),
+      gst_message_new_element (GST_OBJECT (vaitfssd),
+          gst_structure_new ("fruit-identified",
+              "label", G_TYPE_STRING,
+              classes[vaitfssd->event->label ()].c_str (),
+              "class-id", G_TYPE_INT, vaitfssd->event->label (),
+              "score", G_TYPE_DOUBLE, vaitfssd->event->score (),
+              "timestamp", G_TYPE_UINT64, (guint64) pts, NULL)));
+}
+
+/* Everything that follows inference.  Must be called in frame order.
+ * Unwanted boxes are dropped first, so neither the tracker nor drawing and
+ * meta see them. */
+static void
+gst_vaitfssd_postprocess (GstVaitfssd * vaitfssd, gboolean infer,
+    vitis::ai::TFSSDResult & results, GstClockTime pts)
+{
+  if (infer)
+    vaitfssd->filter->apply (results.bboxes);
+
+  gst_vaitfssd_track (vaitfssd, infer, results);
+
+  if (vaitfssd->weighing && infer)
+    gst_vaitfssd_weigh (vaitfssd, results, pts);
+}
+
+/* Detect on one frame on the streaming thread, whole or in tiles */
+static vitis::ai::TFSSDResult
+gst_vaitfssd_detect (GstVaitfssd * vaitfssd, GstVideoFrame * frame,
+    const cv::Mat & img, GstClockTime pts, StageTimer & timer)
+{
+  vitis::ai::TFSSDResult results;
+  gboolean infer = !vaitfssd->late &&
+      gst_vaitfssd_should_infer (vaitfssd, img);
+
+  timer.mark (VAI_STAGE_PREPROCESS);
+  if (infer && vaitfssd->tiler)
+    results = gst_vaitfssd_run_tiles (vaitfssd, frame);
+  else if (infer)
+    results = gst_vaitfssd_run (vaitfssd, img);
+  timer.mark (VAI_STAGE_INFER);
+  gst_vaitfssd_postprocess (vaitfssd, infer, results, pts);
+  timer.mark (VAI_STAGE_POSTPROCESS);
+
+  return results;
+}
+
+/* Account the stage split of a finished frame */
+static void
+gst_vaitfssd_account (GstVaitfssd * vaitfssd, const StageTimer & timer,
+    GstClockTime pts)
+{
+  vaitfssd->stats->add (timer);
+  if (vaitfssd->trace)
+    VaiStatsTrace (vaitfssd->trace, GST_ELEMENT (vaitfssd), 0, pts, timer);
+  vaitfssd->stats->post_if_due (GST_ELEMENT (vaitfssd),
+      vaitfssd->stats_interval);
+}
+
+static void
+gst_vaitfssd_reset_tracking (GstVaitfssd * vaitfssd)
+{
+  if (vaitfssd->gate)
+    vaitfssd->gate->reset ();
+  if (vaitfssd->tracker)
+    vaitfssd->tracker->reset ();
+  if (vaitfssd->event)
+    vaitfssd->event->reset ();
+  if (vaitfssd->tiler)
+    vaitfssd->tiler->reset ();
+}
+
+/* Attach the results as region of interest meta, buffer must be writable */
+static void
+gst_vaitfssd_attach (GstVaitfssd * vaitfssd, GstBuffer * buffer,
+    const vitis::ai::TFSSDResult & results)
+{
+  AttachBoxes (buffer, vaitfssd->width, vaitfssd->height, results.bboxes,
+      [] (const auto & box) {
+        return classes[box.label].c_str ();
+      });
+}
+
+/* Finish the oldest in-flight frame: draw its results, unmap it and hand
+ * back the buffer.  Returns NULL when nothing is ready. */
+static GstBuffer *
+gst_vaitfssd_finish_frame (GstVaitfssd * vaitfssd, gboolean wait)
+{
+  vitis::ai::TFSSDResult results;
+  GstVaitfssdJob *job;
+  GstVideoFrame *frame;
+  GstBuffer *buffer;
+  StageTimer timer;
+  gboolean mapped = TRUE;
+  void *tag;
+
+  if (!vaitfssd->queue->pop (&tag, &results, wait))
+    return NULL;
+
+  /* Infer covers the time the frame waited in the queue as well */
+  job = (GstVaitfssdJob *) tag;
+  frame = &job->frame;
+  timer = job->timer;
+  timer.mark (VAI_STAGE_INFER);
+  gst_vaitfssd_postprocess (vaitfssd, job->infer, results,
+      GST_BUFFER_PTS (frame->buffer));
+  timer.mark (VAI_STAGE_POSTPROCESS);
+
+  /* The frame was mapped for reading, map it for writing only when there
+   * is something to draw */
+  buffer = frame->buffer;
+  if (vaitfssd->draw && !results.bboxes.empty ()) {
+    mapped = FrameMapWritable (frame, &GST_VIDEO_FILTER (vaitfssd)->in_info);
+    if (mapped) {
+      gst_vaitfssd_draw (frame, results);
+      timer.mark (VAI_STAGE_DRAW);
+    } else {
+      GST_WARNING_OBJECT (vaitfssd, "Failed to map frame for drawing");
+    }
+  }
+
+  if (mapped)
+    gst_video_frame_unmap (frame);
+  vaitfssd->qos->processed (gst_util_get_timestamp () - job->start);
+  g_slice_free (GstVaitfssdJob, job);
+
+  /* Only our own reference is left now that the frame is unmapped */
+  if (!vaitfssd->draw)
+    gst_vaitfssd_attach (vaitfssd, buffer, results);
+  timer.mark (VAI_STAGE_POSTPROCESS);
+
+  gst_vaitfssd_account (vaitfssd, timer, GST_BUFFER_PTS (buffer));
+
+  return buffer;
+}
+
+/* Push every in-flight frame downstream, keeping the buffer order */
+static void
+gst_vaitfssd_drain (GstVaitfssd * vaitfssd)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (vaitfssd);
+  GstBuffer *buffer;
+
+  while ((buffer = gst_vaitfssd_finish_frame (vaitfssd, TRUE))) {
+    GstFlowReturn ret = gst_pad_push (GST_BASE_TRANSFORM_SRC_PAD (trans),
+        buffer);
+
+    if (ret != GST_FLOW_OK)
+      GST_DEBUG_OBJECT (vaitfssd, "push while draining: %s",
+          gst_flow_get_name (ret));
+  }
+}
+
+/* Drop every in-flight frame */
+static void
+gst_vaitfssd_flush (GstVaitfssd * vaitfssd)
+{
+  GstBuffer *buffer;
+
+  vaitfssd->queue->flush ();
+  while ((buffer = gst_vaitfssd_finish_frame (vaitfssd, TRUE)))
+    gst_buffer_unref (buffer);
+
+  gst_vaitfssd_reset_tracking (vaitfssd);
+}
+
+/* Lay the tiles out for the negotiated frame and the model input size */
+static void
+gst_vaitfssd_configure_tiles (GstVaitfssd * vaitfssd)
+{
+  vaitfssd->tiler->configure (cv::Size (vaitfssd->width, vaitfssd->height),
+      cv::Size (vaitfssd->input_width, vaitfssd->input_height),
+      vaitfssd->tile_overlap);
+
+  GST_DEBUG_OBJECT (vaitfssd, "%" G_GSIZE_FORMAT " tiles of %dx%d",
+      vaitfssd->tiler->size (), vaitfssd->input_width,
+      vaitfssd->input_height);
+}
+
+/* Take the input size of the current model */
+static void
+gst_vaitfssd_update_input_size (GstVaitfssd * vaitfssd)
+{
+  auto ssd = gst_vaitfssd_runner (vaitfssd);
+
+  vaitfssd->input_width = ssd->getInputWidth ();
+  vaitfssd->input_height = ssd->getInputHeight ();
+}
 
+/* Between two frames, switch to a model that finished loading.  Frames in
+ * flight are finished on the old model first, so every frame is detected
+ * by one model or the other and none is dropped.  Tracked boxes and
+ * tiles of the old model are forgotten. */
+static void
+gst_vaitfssd_check_model (GstVaitfssd * vaitfssd)
+{
+  std::string model, previous;
+
+  if (!vaitfssd->models->pending ())
+    return;
+
+  if (vaitfssd->queue)
+    gst_vaitfssd_drain (vaitfssd);
+
+  switch (vaitfssd->models->swap (model, previous)) {
+    case MODEL_SWAP_DONE:
+      break;
+    case MODEL_SWAP_FAILED:
+      GST_ELEMENT_WARNING (vaitfssd, RESOURCE, NOT_FOUND,
+          ("Could not load model \"%s\", keeping \"%s\"", model.c_str (),
+              vaitfssd->models->current ().c_str ()), (NULL));
+      return;
+    default:
+      return;
+  }
+
+  GST_INFO_OBJECT (vaitfssd, "switched from model %s to %s",
+      previous.c_str (), model.c_str ());
+
+  gst_vaitfssd_update_input_size (vaitfssd);
+  gst_vaitfssd_reset_tracking (vaitfssd);
+  if (vaitfssd->tiler && GST_VIDEO_FILTER (vaitfssd)->negotiated)
+    gst_vaitfssd_configure_tiles (vaitfssd);
+
+  gst_element_post_message (GST_ELEMENT (vaitfssd),
+      gst_message_new_element (GST_OBJECT (vaitfssd),
+          gst_structure_new ("vai-model-changed",
+              "model", G_TYPE_STRING, model.c_str (),
+              "previous", G_TYPE_STRING, previous.c_str (), NULL)));
+}
+
+/* Check a new frame against its deadline.  Returns TRUE when the frame is
+ * late and must skip inference; unless leaky-inference is set it is then
+ * dropped, and *input set to NULL. */
+static gboolean
+gst_vaitfssd_check_qos (GstVaitfssd * vaitfssd, GstBuffer ** input)
+{
+  GstBaseTransform *trans = GST_BASE_TRANSFORM (vaitfssd);
+  GstClockTime running_time;
+  GstClockTimeDiff jitter;
+
+  if (!vaitfssd->qos->late (trans, *input, vaitfssd->max_lateness,
+          &running_time, &jitter))
+    return FALSE;
+
+  if (vaitfssd->leaky_inference) {
+    GST_LOG_OBJECT (vaitfssd, "late by %" GST_STIME_FORMAT
+        ", passing through", GST_STIME_ARGS (jitter));
+    return TRUE;
+  }
+
+  GST_DEBUG_OBJECT (vaitfssd, "late by %" GST_STIME_FORMAT ", dropping",
+      GST_STIME_ARGS (jitter));
+  vaitfssd->qos->post_dropped (GST_ELEMENT (vaitfssd), &trans->segment,
+      *input, running_time, jitter);
+  gst_buffer_unref (*input);
+  *input = NULL;
+
+  return TRUE;
+}
 
 /* class initialization */
 
@@ -115,10 +657,10 @@ gst_vaitfssd_class_init (GstVaitfssdClass * klass)
        base_class_init if you intend to subclass this class. */
     gst_element_class_add_pad_template (GST_ELEMENT_CLASS(klass),
         gst_pad_template_new ("src", GST_PAD_SRC, GST_PAD_ALWAYS,
-          gst_caps_from_string (VIDEO_SRC_CAPS ",width = (int) [1, 640], height = (int) [1, 360]")));
+          gst_caps_from_string (VIDEO_SRC_CAPS)));
     gst_element_class_add_pad_template (GST_ELEMENT_CLASS(klass),
         gst_pad_template_new ("sink", GST_PAD_SINK, GST_PAD_ALWAYS,
-          gst_caps_from_string (VIDEO_SINK_CAPS ", width = (int) [1, 640], height = (int) [1, 360]")));
+          gst_caps_from_string (VIDEO_SINK_CAPS)));
 
     gst_element_class_set_static_metadata (GST_ELEMENT_CLASS(klass),
         "ssd detection using the Vitis-AI-Library", 
@@ -130,16 +672,239 @@ gst_vaitfssd_class_init (GstVaitfssdClass * klass)
   gobject_class->get_property = gst_vaitfssd_get_property;
   gobject_class->dispose = gst_vaitfssd_dispose;
   gobject_class->finalize = gst_vaitfssd_finalize;
+
+  g_object_class_install_property (gobject_class, PROP_MODEL,
+      g_param_spec_string ("model", "Model",
+          "Vitis-AI-Library TFSSD model to run; when changed while running, "
+          "the new model loads in the background and takes over once ready",
+          DEFAULT_MODEL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_ASYNC,
+      g_param_spec_boolean ("async", "Async",
+          "Run inference on worker threads and keep several frames in flight",
+          DEFAULT_ASYNC,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_NUM_WORKERS,
+      g_param_spec_uint ("num-workers", "Number of workers",
+          "Inference worker threads in async mode", 1, 16,
+          DEFAULT_NUM_WORKERS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_MAX_IN_FLIGHT,
+      g_param_spec_uint ("max-in-flight", "Maximum frames in flight",
+          "Frames held by the element in async mode before the streaming "
+          "thread blocks", 1, 64, DEFAULT_MAX_IN_FLIGHT,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_BATCH_SIZE,
+      g_param_spec_uint ("batch-size", "Batch size",
+          "Frames collected into one inference call", 1, 64,
+          DEFAULT_BATCH_SIZE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_MAX_BATCH_LATENCY,
+      g_param_spec_uint64 ("max-batch-latency", "Maximum batch latency",
+          "Time in nanoseconds a partial batch may wait for more frames",
+          0, G_MAXUINT64, DEFAULT_MAX_BATCH_LATENCY,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_DRAW,
+      g_param_spec_boolean ("draw", "Draw",
+          "Draw the detections into the frame; when disabled they are "
+          "attached as GstVideoRegionOfInterestMeta and the frame is left "
+          "untouched", DEFAULT_DRAW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_INFERENCE_INTERVAL,
+      g_param_spec_uint ("inference-interval", "Inference interval",
+          "Run the model on every n-th frame and track the boxes in between",
+          1, G_MAXUINT, DEFAULT_INFERENCE_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_SCENE_CHANGE_THRESHOLD,
+      g_param_spec_double ("scene-change-threshold", "Scene change threshold",
+          "Mean pixel difference (0-1) to the last detected frame above "
+          "which the model runs regardless of the inference interval",
+          0.0, 1.0, DEFAULT_SCENE_CHANGE_THRESHOLD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+
+  g_object_class_install_property (gobject_class, PROP_WEIGHING,
+      g_param_spec_boolean ("weighing", "Weighing",
+          "Vote on the fruit over several detected frames, post a "
+          "fruit-identified message once it is stable and pause inference "
+          "until the scene changes", DEFAULT_WEIGHING,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_VOTE_WINDOW,
+      g_param_spec_uint ("vote-window", "Vote window",
+          "Number of detected frames that vote on the fruit", 1, 300,
+          DEFAULT_VOTE_WINDOW,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_VOTE_RATIO,
+      g_param_spec_double ("vote-ratio", "Vote ratio",
+          "Share of the vote window one fruit needs to be identified",
+          0.5, 1.0, DEFAULT_VOTE_RATIO,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+
+  g_object_class_install_property (gobject_class, PROP_LEAKY_INFERENCE,
+      g_param_spec_boolean ("leaky-inference", "Leaky inference",
+          "Pass late frames through with the last known detections instead "
+          "of dropping them", DEFAULT_LEAKY_INFERENCE,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_MAX_LATENESS,
+      g_param_spec_int64 ("max-lateness", "Max lateness",
+          "How far behind the clock a frame from a live source may fall "
+          "before it counts as late (in ns, -1 = only upstream QoS events)",
+          -1, G_MAXINT64, DEFAULT_MAX_LATENESS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+
+  g_object_class_install_property (gobject_class, PROP_STATS_INTERVAL,
+      g_param_spec_uint64 ("stats-interval", "Stats interval",
+          "Post a vai-stats element message with the latency percentiles "
+          "of every stage this often (in ns, 0 = never)", 0, G_MAXUINT64,
+          DEFAULT_STATS_INTERVAL,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P50,
+      g_param_spec_boxed ("latency-p50", "Latency p50",
+          "Median time spent in each stage over the last frames (in ns)",
+          GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P95,
+      g_param_spec_boxed ("latency-p95", "Latency p95",
+          "95th percentile of the time spent in each stage over the last "
+          "frames (in ns)", GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+  g_object_class_install_property (gobject_class, PROP_LATENCY_P99,
+      g_param_spec_boxed ("latency-p99", "Latency p99",
+          "99th percentile of the time spent in each stage over the last "
+          "frames (in ns)", GST_TYPE_STRUCTURE,
+          (GParamFlags) (G_PARAM_READABLE | G_PARAM_STATIC_STRINGS)));
+
+  g_object_class_install_property (gobject_class, PROP_THRESHOLD,
+      g_param_spec_double ("threshold", "Threshold",
+          "Minimum confidence (0-1) of a detection to be kept",
+          0.0, 1.0, DEFAULT_THRESHOLD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_CLASSES,
+      g_param_spec_string ("classes", "Classes",
+          "Comma separated COCO class names or ids to keep, e.g. "
+          "\"banana,apple,orange\" (NULL = all)", DEFAULT_CLASSES,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_MAX_DETECTIONS,
+      g_param_spec_uint ("max-detections", "Max detections",
+          "Keep only this many of the highest scoring detections "
+          "(0 = all)", 0, G_MAXUINT, DEFAULT_MAX_DETECTIONS,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_NMS_THRESHOLD,
+      g_param_spec_double ("nms-threshold", "NMS threshold",
+          "IoU (0-1) above which a detection is dropped for a better one, "
+          "on top of the model's own suppression (0 = off)",
+          0.0, 1.0, DEFAULT_NMS_THRESHOLD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+  g_object_class_install_property (gobject_class, PROP_NMS_CLASS_AGNOSTIC,
+      g_param_spec_boolean ("nms-class-agnostic", "NMS class agnostic",
+          "Suppress overlapping detections of different classes as well, "
+          "e.g. an orange also found as an apple", DEFAULT_NMS_CLASS_AGNOSTIC,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+
+  g_object_class_install_property (gobject_class, PROP_TILING,
+      g_param_spec_boolean ("tiling", "Tiling",
+          "Detect in overlapping model sized tiles at the frame's own "
+          "resolution instead of on the scaled down frame; the tiles of a "
+          "frame run as one batch on the streaming thread", DEFAULT_TILING,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_TILE_OVERLAP,
+      g_param_spec_double ("tile-overlap", "Tile overlap",
+          "Minimum overlap of neighbouring tiles, as a fraction of a tile",
+          0.0, 0.9, DEFAULT_TILE_OVERLAP,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_READY)));
+  g_object_class_install_property (gobject_class, PROP_TILE_MOTION_THRESHOLD,
+      g_param_spec_double ("tile-motion-threshold", "Tile motion threshold",
+          "Mean pixel difference (0-1) of a tile to when it was last "
+          "detected below which it keeps its boxes instead of running "
+          "again (0 = run every tile)",
+          0.0, 1.0, DEFAULT_TILE_MOTION_THRESHOLD,
+          (GParamFlags) (G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS |
+              GST_PARAM_MUTABLE_PLAYING)));
+
   base_transform_class->start = GST_DEBUG_FUNCPTR (gst_vaitfssd_start);
   base_transform_class->stop = GST_DEBUG_FUNCPTR (gst_vaitfssd_stop);
+  base_transform_class->propose_allocation =
+      GST_DEBUG_FUNCPTR (gst_vaitfssd_propose_allocation);
+  base_transform_class->submit_input_buffer =
+      GST_DEBUG_FUNCPTR (gst_vaitfssd_submit_input_buffer);
+  base_transform_class->generate_output =
+      GST_DEBUG_FUNCPTR (gst_vaitfssd_generate_output);
+  base_transform_class->sink_event = GST_DEBUG_FUNCPTR (gst_vaitfssd_sink_event);
+  base_transform_class->src_event = GST_DEBUG_FUNCPTR (gst_vaitfssd_src_event);
+  base_transform_class->query = GST_DEBUG_FUNCPTR (gst_vaitfssd_query);
+  base_transform_class->transform_ip =
+      GST_DEBUG_FUNCPTR (gst_vaitfssd_transform_ip);
   video_filter_class->set_info = GST_DEBUG_FUNCPTR (gst_vaitfssd_set_info);
-  video_filter_class->transform_frame_ip = GST_DEBUG_FUNCPTR (gst_vaitfssd_transform_frame_ip);
 
 }
 
 static void
 gst_vaitfssd_init (GstVaitfssd *vaitfssd)
 {
+  vaitfssd->model = g_strdup (DEFAULT_MODEL);
+  vaitfssd->models = NULL;
+  vaitfssd->async = DEFAULT_ASYNC;
+  vaitfssd->num_workers = DEFAULT_NUM_WORKERS;
+  vaitfssd->max_in_flight = DEFAULT_MAX_IN_FLIGHT;
+  vaitfssd->batch_size = DEFAULT_BATCH_SIZE;
+  vaitfssd->max_batch_latency = DEFAULT_MAX_BATCH_LATENCY;
+  vaitfssd->draw = DEFAULT_DRAW;
+  vaitfssd->inference_interval = DEFAULT_INFERENCE_INTERVAL;
+  vaitfssd->scene_change_threshold = DEFAULT_SCENE_CHANGE_THRESHOLD;
+  vaitfssd->input_width = 0;
+  vaitfssd->input_height = 0;
+  vaitfssd->gate = NULL;
+  vaitfssd->tracker = NULL;
+  vaitfssd->weighing = DEFAULT_WEIGHING;
+  vaitfssd->vote_window = DEFAULT_VOTE_WINDOW;
+  vaitfssd->vote_ratio = DEFAULT_VOTE_RATIO;
+  vaitfssd->event = NULL;
+  vaitfssd->leaky_inference = DEFAULT_LEAKY_INFERENCE;
+  vaitfssd->max_lateness = DEFAULT_MAX_LATENESS;
+  vaitfssd->qos = NULL;
+  vaitfssd->late = FALSE;
+  vaitfssd->stats_interval = DEFAULT_STATS_INTERVAL;
+  vaitfssd->stats = new StageStats ();
+  vaitfssd->trace = NULL;
+  vaitfssd->dmabuf = FALSE;
+  vaitfssd->threshold = DEFAULT_THRESHOLD;
+  vaitfssd->classes = g_strdup (DEFAULT_CLASSES);
+  vaitfssd->max_detections = DEFAULT_MAX_DETECTIONS;
+  vaitfssd->nms_threshold = DEFAULT_NMS_THRESHOLD;
+  vaitfssd->nms_class_agnostic = DEFAULT_NMS_CLASS_AGNOSTIC;
+  vaitfssd->filter = new DetectFilter ();
+  vaitfssd->tiling = DEFAULT_TILING;
+  vaitfssd->tile_overlap = DEFAULT_TILE_OVERLAP;
+  vaitfssd->tile_motion_threshold = DEFAULT_TILE_MOTION_THRESHOLD;
+  vaitfssd->tiler = NULL;
+  vaitfssd->queue = NULL;
+
+  /* DetectQos decides which late frames to drop; the base class would
+   * drop them too, leaky-inference or not */
+  gst_base_transform_set_qos_enabled (GST_BASE_TRANSFORM (vaitfssd), FALSE);
 }
 
 void
@@ -151,6 +916,96 @@ gst_vaitfssd_set_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (vaitfssd, "set_property");
 
   switch (property_id) {
+    case PROP_MODEL:
+      GST_OBJECT_LOCK (vaitfssd);
+      g_free (vaitfssd->model);
+      vaitfssd->model = g_value_dup_string (value);
+      if (vaitfssd->models && vaitfssd->model)
+        vaitfssd->models->request (vaitfssd->model);
+      GST_OBJECT_UNLOCK (vaitfssd);
+      break;
+    case PROP_ASYNC:
+      vaitfssd->async = g_value_get_boolean (value);
+      break;
+    case PROP_NUM_WORKERS:
+      vaitfssd->num_workers = g_value_get_uint (value);
+      break;
+    case PROP_MAX_IN_FLIGHT:
+      vaitfssd->max_in_flight = g_value_get_uint (value);
+      break;
+    case PROP_BATCH_SIZE:
+      vaitfssd->batch_size = g_value_get_uint (value);
+      break;
+    case PROP_MAX_BATCH_LATENCY:
+      vaitfssd->max_batch_latency = g_value_get_uint64 (value);
+      break;
+    case PROP_DRAW:
+      vaitfssd->draw = g_value_get_boolean (value);
+      break;
+    case PROP_INFERENCE_INTERVAL:
+      vaitfssd->inference_interval = g_value_get_uint (value);
+      break;
+    case PROP_SCENE_CHANGE_THRESHOLD:
+      vaitfssd->scene_change_threshold = g_value_get_double (value);
+      break;
+    case PROP_WEIGHING:
+      vaitfssd->weighing = g_value_get_boolean (value);
+      break;
+    case PROP_VOTE_WINDOW:
+      vaitfssd->vote_window = g_value_get_uint (value);
+      break;
+    case PROP_VOTE_RATIO:
+      vaitfssd->vote_ratio = g_value_get_double (value);
+      break;
+    case PROP_LEAKY_INFERENCE:
+      vaitfssd->leaky_inference = g_value_get_boolean (value);
+      break;
+    case PROP_MAX_LATENESS:
+      vaitfssd->max_lateness = g_value_get_int64 (value);
+      break;
+    case PROP_STATS_INTERVAL:
+      vaitfssd->stats_interval = g_value_get_uint64 (value);
+      break;
+    case PROP_THRESHOLD:
+      vaitfssd->threshold = g_value_get_double (value);
+      vaitfssd->filter->set_threshold (vaitfssd->threshold);
+      break;
+    case PROP_CLASSES:
+    {
+      std::string unknown;
+
+      g_free (vaitfssd->classes);
+      vaitfssd->classes = g_value_dup_string (value);
+      unknown = vaitfssd->filter->set_classes (vaitfssd->classes, classes,
+          G_N_ELEMENTS (classes));
+      if (!unknown.empty ())
+        GST_WARNING_OBJECT (vaitfssd, "unknown classes ignored: %s",
+            unknown.c_str ());
+      break;
+    }
+    case PROP_MAX_DETECTIONS:
+      vaitfssd->max_detections = g_value_get_uint (value);
+      vaitfssd->filter->set_max_detections (vaitfssd->max_detections);
+      break;
+    case PROP_NMS_THRESHOLD:
+      vaitfssd->nms_threshold = g_value_get_double (value);
+      vaitfssd->filter->set_nms (vaitfssd->nms_threshold,
+          vaitfssd->nms_class_agnostic);
+      break;
+    case PROP_NMS_CLASS_AGNOSTIC:
+      vaitfssd->nms_class_agnostic = g_value_get_boolean (value);
+      vaitfssd->filter->set_nms (vaitfssd->nms_threshold,
+          vaitfssd->nms_class_agnostic);
+      break;
+    case PROP_TILING:
+      vaitfssd->tiling = g_value_get_boolean (value);
+      break;
+    case PROP_TILE_OVERLAP:
+      vaitfssd->tile_overlap = g_value_get_double (value);
+      break;
+    case PROP_TILE_MOTION_THRESHOLD:
+      vaitfssd->tile_motion_threshold = g_value_get_double (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -166,6 +1021,86 @@ gst_vaitfssd_get_property (GObject * object, guint property_id,
   GST_DEBUG_OBJECT (vaitfssd, "get_property");
 
   switch (property_id) {
+    case PROP_MODEL:
+      GST_OBJECT_LOCK (vaitfssd);
+      g_value_set_string (value, vaitfssd->model);
+      GST_OBJECT_UNLOCK (vaitfssd);
+      break;
+    case PROP_ASYNC:
+      g_value_set_boolean (value, vaitfssd->async);
+      break;
+    case PROP_NUM_WORKERS:
+      g_value_set_uint (value, vaitfssd->num_workers);
+      break;
+    case PROP_MAX_IN_FLIGHT:
+      g_value_set_uint (value, vaitfssd->max_in_flight);
+      break;
+    case PROP_BATCH_SIZE:
+      g_value_set_uint (value, vaitfssd->batch_size);
+      break;
+    case PROP_MAX_BATCH_LATENCY:
+      g_value_set_uint64 (value, vaitfssd->max_batch_latency);
+      break;
+    case PROP_DRAW:
+      g_value_set_boolean (value, vaitfssd->draw);
+      break;
+    case PROP_INFERENCE_INTERVAL:
+      g_value_set_uint (value, vaitfssd->inference_interval);
+      break;
+    case PROP_SCENE_CHANGE_THRESHOLD:
+      g_value_set_double (value, vaitfssd->scene_change_threshold);
+      break;
+    case PROP_WEIGHING:
+      g_value_set_boolean (value, vaitfssd->weighing);
+      break;
+    case PROP_VOTE_WINDOW:
+      g_value_set_uint (value, vaitfssd->vote_window);
+      break;
+    case PROP_VOTE_RATIO:
+      g_value_set_double (value, vaitfssd->vote_ratio);
+      break;
+    case PROP_LEAKY_INFERENCE:
+      g_value_set_boolean (value, vaitfssd->leaky_inference);
+      break;
+    case PROP_MAX_LATENESS:
+      g_value_set_int64 (value, vaitfssd->max_lateness);
+      break;
+    case PROP_STATS_INTERVAL:
+      g_value_set_uint64 (value, vaitfssd->stats_interval);
+      break;
+    case PROP_LATENCY_P50:
+      g_value_take_boxed (value, vaitfssd->stats->latency (0.50));
+      break;
+    case PROP_LATENCY_P95:
+      g_value_take_boxed (value, vaitfssd->stats->latency (0.95));
+      break;
+    case PROP_LATENCY_P99:
+      g_value_take_boxed (value, vaitfssd->stats->latency (0.99));
+      break;
+    case PROP_THRESHOLD:
+      g_value_set_double (value, vaitfssd->threshold);
+      break;
+    case PROP_CLASSES:
+      g_value_set_string (value, vaitfssd->classes);
+      break;
+    case PROP_MAX_DETECTIONS:
+      g_value_set_uint (value, vaitfssd->max_detections);
+      break;
+    case PROP_NMS_THRESHOLD:
+      g_value_set_double (value, vaitfssd->nms_threshold);
+      break;
+    case PROP_NMS_CLASS_AGNOSTIC:
+      g_value_set_boolean (value, vaitfssd->nms_class_agnostic);
+      break;
+    case PROP_TILING:
+      g_value_set_boolean (value, vaitfssd->tiling);
+      break;
+    case PROP_TILE_OVERLAP:
+      g_value_set_double (value, vaitfssd->tile_overlap);
+      break;
+    case PROP_TILE_MOTION_THRESHOLD:
+      g_value_set_double (value, vaitfssd->tile_motion_threshold);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, property_id, pspec);
       break;
@@ -192,6 +1127,10 @@ gst_vaitfssd_finalize (GObject * object)
   GST_DEBUG_OBJECT (vaitfssd, "finalize");
 
   /* clean up object here */
+  delete vaitfssd->stats;
+  delete vaitfssd->filter;
+  g_free (vaitfssd->classes);
+  g_free (vaitfssd->model);
 
   G_OBJECT_CLASS (gst_vaitfssd_parent_class)->finalize (object);
 }
@@ -200,9 +1139,70 @@ static gboolean
 gst_vaitfssd_start (GstBaseTransform * trans)
 {
   GstVaitfssd *vaitfssd = GST_VAITFSSD (trans);
+  ModelSwap<vitis::ai::TFSSD> *models;
+  gchar *model;
 
   GST_DEBUG_OBJECT (vaitfssd, "start");
 
+  /* Load the model now rather than on the first frame, one runner for
+   * each thread that runs it; models swapped in later get as many */
+  GST_OBJECT_LOCK (vaitfssd);
+  model = g_strdup (vaitfssd->model);
+  GST_OBJECT_UNLOCK (vaitfssd);
+
+  models = new ModelSwap<vitis::ai::TFSSD> (vaitfssd->async ?
+      vaitfssd->num_workers : 1);
+  if (!model || !models->open (model)) {
+    GST_ELEMENT_ERROR (vaitfssd, RESOURCE, NOT_FOUND,
+        ("Could not load model \"%s\"", GST_STR_NULL (model)), (NULL));
+    delete models;
+    g_free (model);
+    return FALSE;
+  }
+
+  /* A model set while the first one loaded is swapped in like any later
+   * change */
+  GST_OBJECT_LOCK (vaitfssd);
+  vaitfssd->models = models;
+  if (vaitfssd->model && g_strcmp0 (vaitfssd->model, model) != 0)
+    models->request (vaitfssd->model);
+  GST_OBJECT_UNLOCK (vaitfssd);
+  g_free (model);
+
+  gst_vaitfssd_update_input_size (vaitfssd);
+
+  vaitfssd->gate = new InferGate ();
+  vaitfssd->tracker = new BoxTracker<vitis::ai::TFSSDResult::BoundingBox> ();
+  vaitfssd->event = new WeighingEvent (vaitfssd->vote_window,
+      vaitfssd->vote_ratio);
+  GST_OBJECT_LOCK (vaitfssd);
+  vaitfssd->qos = new DetectQos ();
+  GST_OBJECT_UNLOCK (vaitfssd);
+  vaitfssd->late = FALSE;
+  vaitfssd->stats->reset ();
+  vaitfssd->trace = VaiStatsTracerRecord ();
+  gst_vaitfssd_reset_tracking (vaitfssd);
+
+  /* Tiling batches the tiles of each frame on the streaming thread, which
+   * takes the place of async and frame batching */
+  if (vaitfssd->tiling) {
+    vaitfssd->tiler = new FrameTiler<vitis::ai::TFSSDResult::BoundingBox> ();
+    if (vaitfssd->async || vaitfssd->batch_size > 1)
+      GST_WARNING_OBJECT (vaitfssd, "tiling, async and batch-size ignored");
+  }
+
+  /* Batching needs frames held back as well, so it goes through the
+   * queue with a single worker when async is off */
+  if (!vaitfssd->tiler && (vaitfssd->async || vaitfssd->batch_size > 1)) {
+    vaitfssd->queue = new InferQueue<vitis::ai::TFSSDResult> ();
+    vaitfssd->queue->start (vaitfssd->async ? vaitfssd->num_workers : 1,
+        vaitfssd->max_in_flight, vaitfssd->batch_size,
+        std::chrono::microseconds (vaitfssd->max_batch_latency / GST_USECOND),
+        [vaitfssd] (const std::vector<cv::Mat> & imgs) {
+          return gst_vaitfssd_run_batch (vaitfssd, imgs);
+        });
+  }
+
   return TRUE;
 }
 
@@ -210,9 +1210,37 @@ static gboolean
 gst_vaitfssd_stop (GstBaseTransform * trans)
 {
   GstVaitfssd *vaitfssd = GST_VAITFSSD (trans);
+  ModelSwap<vitis::ai::TFSSD> *models;
 
   GST_DEBUG_OBJECT (vaitfssd, "stop");
 
+  if (vaitfssd->queue) {
+    vaitfssd->queue->stop ();
+    gst_vaitfssd_flush (vaitfssd);
+    delete vaitfssd->queue;
+    vaitfssd->queue = NULL;
+  }
+
+  /* Waits for a model still loading, then unloads */
+  GST_OBJECT_LOCK (vaitfssd);
+  models = vaitfssd->models;
+  vaitfssd->models = NULL;
+  GST_OBJECT_UNLOCK (vaitfssd);
+  delete models;
+
+  delete vaitfssd->gate;
+  vaitfssd->gate = NULL;
+  delete vaitfssd->tracker;
+  vaitfssd->tracker = NULL;
+  delete vaitfssd->event;
+  vaitfssd->event = NULL;
+  delete vaitfssd->tiler;
+  vaitfssd->tiler = NULL;
+  GST_OBJECT_LOCK (vaitfssd);
+  delete vaitfssd->qos;
+  vaitfssd->qos = NULL;
+  GST_OBJECT_UNLOCK (vaitfssd);
+
   return TRUE;
 }
 
@@ -224,6 +1252,20 @@ gst_vaitfssd_set_info (GstVideoFilter * filter, GstCaps * incaps,
 
   GST_DEBUG_OBJECT (vaitfssd, "set_info");
 
+  /* Frames of any size are handed to the runner as they are; it resizes
+   * and normalizes straight into the model's input tensor, so no
+   * videoscale is needed upstream.  Neither is videoconvert, YUV frames
+   * are converted at the model input size. */
+  vaitfssd->width = GST_VIDEO_INFO_WIDTH (in_info);
+  vaitfssd->height = GST_VIDEO_INFO_HEIGHT (in_info);
+  vaitfssd->stride = GST_VIDEO_INFO_PLANE_STRIDE (in_info, 0);
+
+  GST_DEBUG_OBJECT (vaitfssd, "%dx%d, stride %d", vaitfssd->width,
+      vaitfssd->height, vaitfssd->stride);
+
+  if (vaitfssd->tiler)
+    gst_vaitfssd_configure_tiles (vaitfssd);
+
   return TRUE;
 }
 
@@ -239,42 +1281,246 @@ gst_vaitfssd_transform_frame (GstVideoFilter * filter, GstVideoFrame * inframe,
   return GST_FLOW_OK;
 }
 
-    static GstFlowReturn
-    gst_vaitfssd_transform_frame_ip (GstVideoFilter * filter, GstVideoFrame * frame)
-    {
-      GstVaitfssd *vaitfssd = GST_VAITFSSD (filter);
+/* Offer our dmabuf pool upstream, ahead of whatever downstream proposes.
+ * The element always works in place, so basetransform never passes a
+ * decide query and GstVideoFilter forwards the query downstream after us.
+ * In passthrough the buffers are not read, so no pool is offered. */
+static gboolean
+gst_vaitfssd_propose_allocation (GstBaseTransform * trans,
+    GstQuery * decide_query, GstQuery * query)
+{
+  if (!gst_base_transform_is_passthrough (trans))
+    VaiDmabufProposeAllocation (query);
 
-      /* Create ssd detection object */
-      thread_local auto ssd = vitis::ai::TFSSD::create("ssd_mobilenet_v1_coco_tf");
+  return GST_BASE_TRANSFORM_CLASS (gst_vaitfssd_parent_class)->
+      propose_allocation (trans, decide_query, query);
+}
 
-      /* Setup an OpenCV Mat with the frame data */
-      cv::Mat img(360, 640, CV_8UC3, GST_VIDEO_FRAME_PLANE_DATA(frame, 0));
+/* Note which memory the frames come in when that changes */
+static void
+gst_vaitfssd_check_memory (GstVaitfssd * vaitfssd, GstBuffer * buf)
+{
+  if (FrameIsDmabuf (buf) == !!vaitfssd->dmabuf)
+    return;
+
+  vaitfssd->dmabuf = !vaitfssd->dmabuf;
+  GST_INFO_OBJECT (vaitfssd, "input in %s",
+      vaitfssd->dmabuf ? "dmabuf memory" : "system memory");
+}
 
-      /* Perform ssd detection */
-      auto results = ssd->run(img);
+/* The frame is mapped here rather than by GstVideoFilter so every stage is
+ * timed.  Inference only reads it, so it is mapped for writing only when
+ * there are boxes to draw; with draw disabled the results go into meta.
+ * The buffer memory is never copied to make it writable for nothing. */
+static GstFlowReturn
+gst_vaitfssd_transform_ip (GstBaseTransform * trans, GstBuffer * buf)
+{
+  GstVaitfssd *vaitfssd = GST_VAITFSSD (trans);
+  GstVideoFilter *filter = GST_VIDEO_FILTER (trans);
+  gboolean draw = vaitfssd->draw;
+  StageTimer timer;
+  GstVideoFrame frame;
 
-      /* Draw bounding boxes */
-      for (auto &box : results.bboxes)
-      {
-	class_label = classes[box.label];
-        int xmin = box.x * img.cols;
-        int ymin = box.y * img.rows;
-        int xmax = xmin + (box.width * img.cols);
-        int ymax = ymin + (box.height * img.rows);
+  if (!filter->negotiated)
+    return GST_FLOW_NOT_NEGOTIATED;
 
-        xmin = std::min(std::max(xmin, 0), img.cols);
-        xmax = std::min(std::max(xmax, 0), img.cols);
-        ymin = std::min(std::max(ymin, 0), img.rows);
-        ymax = std::min(std::max(ymax, 0), img.rows);
+  gst_vaitfssd_check_memory (vaitfssd, buf);
+  if (!gst_video_frame_map (&frame, &filter->in_info, buf, GST_MAP_READ)) {
+    GST_ELEMENT_ERROR (vaitfssd, CORE, FAILED, (NULL),
+        ("Failed to map input buffer"));
+    return GST_FLOW_ERROR;
+  }
+  timer.mark (VAI_STAGE_MAP);
 
-        cv::rectangle(img, cv::Point(xmin, ymin), cv::Point(xmax, ymax),cv::Scalar(0, 255, 0), 2, 1, 0);
-	cv::putText(img, class_label,cvPoint(xmin,ymin),cv::FONT_HERSHEY_SIMPLEX,1.0,cv::Scalar(0, 255, 0),1.0);
-      }
+  /* Setup an OpenCV Mat with the frame data */
+  cv::Mat img = gst_vaitfssd_frame_mat (vaitfssd, &frame);
 
-      GST_DEBUG_OBJECT (vaitfssd, "transform_frame_ip");
+  /* Perform ssd detection, or track the last detections */
+  auto results = gst_vaitfssd_detect (vaitfssd, &frame, img,
+      GST_BUFFER_PTS (buf), timer);
 
-      return GST_FLOW_OK;
+  /* Draw bounding boxes */
+  if (draw && !results.bboxes.empty ()) {
+    if (!FrameMapWritable (&frame, &filter->in_info)) {
+      GST_ELEMENT_ERROR (vaitfssd, CORE, FAILED, (NULL),
+          ("Failed to map input buffer for drawing"));
+      return GST_FLOW_ERROR;
     }
+    gst_vaitfssd_draw (&frame, results);
+    timer.mark (VAI_STAGE_DRAW);
+  }
+  gst_video_frame_unmap (&frame);
+
+  if (!draw)
+    gst_vaitfssd_attach (vaitfssd, buf, results);
+  timer.mark (VAI_STAGE_POSTPROCESS);
+
+  gst_vaitfssd_account (vaitfssd, timer, GST_BUFFER_PTS (buf));
+
+  return GST_FLOW_OK;
+}
+
+/* In async mode the input buffer is mapped here and queued for the
+ * inference workers; the streaming thread returns straight away and only
+ * blocks once max-in-flight frames are held. */
+static GstFlowReturn
+gst_vaitfssd_submit_input_buffer (GstBaseTransform * trans,
+    gboolean is_discont, GstBuffer * input)
+{
+  GstVaitfssd *vaitfssd = GST_VAITFSSD (trans);
+  GstVideoFilter *filter = GST_VIDEO_FILTER (trans);
+  GstVaitfssdJob *job;
+  gboolean late;
+
+  /* Every frame passes here, queued or not, before it is looked at */
+  gst_vaitfssd_check_model (vaitfssd);
+
+  late = gst_vaitfssd_check_qos (vaitfssd, &input);
+  if (!input)
+    return GST_BASE_TRANSFORM_FLOW_DROPPED;
+
+  if (!vaitfssd->queue) {
+    vaitfssd->late = late;
+    return GST_BASE_TRANSFORM_CLASS (gst_vaitfssd_parent_class)->
+        submit_input_buffer (trans, is_discont, input);
+  }
+
+  if (!filter->negotiated) {
+    gst_buffer_unref (input);
+    return GST_FLOW_NOT_NEGOTIATED;
+  }
+
+  /* The frame mapping holds its own reference, so our reference is handed
+   * downstream in generate_output() once the frame is unmapped again */
+  input = gst_buffer_make_writable (input);
+  job = g_slice_new (GstVaitfssdJob);
+  job->start = gst_util_get_timestamp ();
+  job->timer = StageTimer ();
+  gst_vaitfssd_check_memory (vaitfssd, input);
+  if (!gst_video_frame_map (&job->frame, &filter->in_info, input,
+          GST_MAP_READ)) {
+    g_slice_free (GstVaitfssdJob, job);
+    gst_buffer_unref (input);
+    GST_ELEMENT_ERROR (vaitfssd, CORE, FAILED, (NULL),
+        ("Failed to map input buffer"));
+    return GST_FLOW_ERROR;
+  }
+  job->timer.mark (VAI_STAGE_MAP);
+
+  /* Frames that skip inference, by interval or for being late, still go
+   * through the queue, so the tracker sees them in order behind the frames
+   * that are being detected */
+  cv::Mat img = gst_vaitfssd_frame_mat (vaitfssd, &job->frame);
+  job->infer = !late && gst_vaitfssd_should_infer (vaitfssd, img);
+  job->timer.mark (VAI_STAGE_PREPROCESS);
+  vaitfssd->queue->push (job, img, job->infer);
+
+  return GST_FLOW_OK;
+}
+
+/* Called after every submitted buffer until it returns no buffer; hands out
+ * finished frames in the order they came in, which is PTS order for raw
+ * video */
+static GstFlowReturn
+gst_vaitfssd_generate_output (GstBaseTransform * trans, GstBuffer ** outbuf)
+{
+  GstVaitfssd *vaitfssd = GST_VAITFSSD (trans);
+
+  if (!vaitfssd->queue) {
+    GstClockTime start = gst_util_get_timestamp ();
+    GstFlowReturn ret = GST_BASE_TRANSFORM_CLASS (gst_vaitfssd_parent_class)->
+        generate_output (trans, outbuf);
+
+    if (*outbuf && !vaitfssd->late)
+      vaitfssd->qos->processed (gst_util_get_timestamp () - start);
+    return ret;
+  }
+
+  *outbuf = gst_vaitfssd_finish_frame (vaitfssd, FALSE);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+gst_vaitfssd_sink_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstVaitfssd *vaitfssd = GST_VAITFSSD (trans);
+
+  if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP && vaitfssd->qos)
+    vaitfssd->qos->reset ();
+
+  if (vaitfssd->queue) {
+    /* Serialized events (EOS, caps, segment, ...) must stay behind the
+     * frames that are still being processed */
+    if (GST_EVENT_TYPE (event) == GST_EVENT_FLUSH_STOP)
+      gst_vaitfssd_flush (vaitfssd);
+    else if (GST_EVENT_IS_SERIALIZED (event))
+      gst_vaitfssd_drain (vaitfssd);
+  }
+
+  return GST_BASE_TRANSFORM_CLASS (gst_vaitfssd_parent_class)->sink_event (trans,
+      event);
+}
+
+static gboolean
+gst_vaitfssd_src_event (GstBaseTransform * trans, GstEvent * event)
+{
+  GstVaitfssd *vaitfssd = GST_VAITFSSD (trans);
+
+  /* QoS events come from the streaming threads downstream, before start()
+   * or after stop() there is nothing to throttle */
+  GST_OBJECT_LOCK (vaitfssd);
+  if (vaitfssd->qos)
+    vaitfssd->qos->handle_event (event);
+  GST_OBJECT_UNLOCK (vaitfssd);
+
+  return GST_BASE_TRANSFORM_CLASS (gst_vaitfssd_parent_class)->src_event (trans,
+      event);
+}
+
+/* Frames held in the queue only go out once later frames come in, and a
+ * partial batch may wait on top of that, so add both to the latency */
+static gboolean
+gst_vaitfssd_query (GstBaseTransform * trans, GstPadDirection direction,
+    GstQuery * query)
+{
+  GstVaitfssd *vaitfssd = GST_VAITFSSD (trans);
+  GstVideoInfo *info = &GST_VIDEO_FILTER (trans)->in_info;
+  GstClockTime min, max, latency;
+  guint held;
+  gboolean live, queued;
+
+  if (!GST_BASE_TRANSFORM_CLASS (gst_vaitfssd_parent_class)->query (trans,
+          direction, query))
+    return FALSE;
+
+  if (direction != GST_PAD_SRC || GST_QUERY_TYPE (query) != GST_QUERY_LATENCY
+      || GST_VIDEO_INFO_FPS_N (info) <= 0)
+    return TRUE;
+
+  /* Same condition as the queue in start(); the properties involved only
+   * change in READY */
+  queued = !vaitfssd->tiling && (vaitfssd->async || vaitfssd->batch_size > 1);
+  held = MAX (vaitfssd->max_in_flight, vaitfssd->batch_size);
+  latency = vaitfssd->batch_size > 1 ? vaitfssd->max_batch_latency : 0;
+
+  if (!queued)
+    return TRUE;
+
+  latency += gst_util_uint64_scale_int (held * GST_SECOND,
+      GST_VIDEO_INFO_FPS_D (info), GST_VIDEO_INFO_FPS_N (info));
+
+  GST_DEBUG_OBJECT (vaitfssd, "adding latency %" GST_TIME_FORMAT,
+      GST_TIME_ARGS (latency));
+
+  gst_query_parse_latency (query, &live, &min, &max);
+  min += latency;
+  if (GST_CLOCK_TIME_IS_VALID (max))
+    max += latency;
+  gst_query_set_latency (query, live, min, max);
+
+  return TRUE;
+}
 
 static gboolean
 plugin_init (GstPlugin * plugin)
@@ -282,7 +1528,8 @@ plugin_init (GstPlugin * plugin)
 
   /* FIXME Remember to set the rank if it's an element that is meant
      to be autoplugged by decodebin. */
-  return gst_element_register (plugin, "vaitfssd", GST_RANK_NONE,
+  return VaiStatsTracerRegister (plugin) &&
+      gst_element_register (plugin, "vaitfssd", GST_RANK_NONE,
       GST_TYPE_VAITFSSD);
 }
 
@@ -23,6 +23,19 @@
 #include <gst/video/video.h>
 #include <gst/video/gstvideofilter.h>
 
+/* Vitis-AI-Library types, the model swap, the asynchronous job queue,
+ * tracking, QoS, stage statistics, result filtering and tiling */
+#include <vitis/ai/tfssd.hpp>
+#include <vitis/ai/nnpp/tfssd.hpp>
+#include <modelswap.hpp>
+#include <inferqueue.hpp>
+#include <tracker.hpp>
+#include <detectqos.hpp>
+#include <stagestats.hpp>
+#include <detectfilter.hpp>
+#include <tiler.hpp>
+#include "weighing.hpp"
+
 G_BEGIN_DECLS
 
 #define GST_TYPE_VAITFSSD   (gst_vaitfssd_get_type())
@@ -38,6 +51,72 @@ struct _GstVaitfssd
 {
   GstVideoFilter base_vaitfssd;
 
+  /* properties */
+  gchar *model;
+  gboolean async;
+  guint num_workers;
+  guint max_in_flight;
+  guint batch_size;
+  GstClockTime max_batch_latency;
+  gboolean draw;
+  guint inference_interval;
+  gdouble scene_change_threshold;
+  gboolean weighing;
+  guint vote_window;
+  gdouble vote_ratio;
+  gboolean leaky_inference;
+  GstClockTimeDiff max_lateness;
+  GstClockTime stats_interval;
+  gdouble threshold;
+  gchar *classes;
+  guint max_detections;
+  gdouble nms_threshold;
+  gboolean nms_class_agnostic;
+  gboolean tiling;
+  gdouble tile_overlap;
+  gdouble tile_motion_threshold;
+
+  /* the model being run, and the next one while it loads */
+  ModelSwap<vitis::ai::TFSSD> *models;
+
+  /* negotiated frame layout */
+  gint width;
+  gint height;
+  gint stride;
+
+  /* model input size, YUV frames are sampled down to it */
+  gint input_width;
+  gint input_height;
+
+  /* threshold, class allow-list, NMS and max-detections, applied to every
+   * inference result */
+  DetectFilter *filter;
+
+  /* frame skipping */
+  InferGate *gate;
+  BoxTracker<vitis::ai::TFSSDResult::BoundingBox> *tracker;
+
+  /* model sized tiles over the frame when tiling, NULL otherwise */
+  FrameTiler<vitis::ai::TFSSDResult::BoundingBox> *tiler;
+
+  /* weighing event of the fruit currently on the scale */
+  WeighingEvent *event;
+
+  /* QoS state, and whether the frame in transform is late */
+  DetectQos *qos;
+  gboolean late;
+
+  /* rolling stage latencies, and the vaistats tracer record when that
+   * tracer is active */
+  StageStats *stats;
+  GstTracerRecord *trace;
+
+  /* whether the last frame came in dmabuf memory */
+  gboolean dmabuf;
+
+  /* in-flight frames when running asynchronously or batched, NULL
+   * otherwise */
+  InferQueue<vitis::ai::TFSSDResult> *queue;
 };
 
 struct _GstVaitfssdClass
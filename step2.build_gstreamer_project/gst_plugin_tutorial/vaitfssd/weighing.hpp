@@ -0,0 +1,151 @@
+/* GStreamer
+ * Copyright (C) 2020 FIXME <fixme@example.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/*
+ * WeighingEvent - debounced fruit classification for one weighing
+ *
+ *  Every detected frame casts one vote: the fruit class with the best
+ *  score, or -1 when no fruit is on the scale.  Once the sliding window is
+ *  full and one fruit holds at least 'ratio' of the votes, the result is
+ *  locked and stays locked until reset(), which the element calls when
+ *  the scene changes.
+ *
+ * InferGate - which frames go through the model
+ *
+ *  With an inference interval only every n-th frame does, and while a
+ *  weighing result is locked none does.  A frame whose scene changed since
+ *  the last inferred frame always does, and ends the locked weighing.
+ *  Every inferred frame becomes the new scene reference, so a lock is
+ *  compared with the frames that voted for it.
+ */
+
+#ifndef __WEIGHING_HPP__
+#define __WEIGHING_HPP__
+
+#include <algorithm>
+#include <deque>
+#include <map>
+#include <utility>
+#include <opencv2/core.hpp>
+#include <tracker.hpp>
+
+class WeighingEvent
+{
+public:
+  WeighingEvent (unsigned window, double ratio)
+      : window_ (std::max (window, 1u)), ratio_ (ratio), label_ (-1),
+      score_ (0.0), locked_ (false) {}
+
+  /* Add one frame's vote.  Returns true when this vote locked a result. */
+  bool feed (int label, double score)
+  {
+    if (locked_)
+      return false;
+
+    votes_.push_back (std::make_pair (label, score));
+    if (votes_.size () > window_)
+      votes_.pop_front ();
+    if (votes_.size () < window_)
+      return false;
+
+    std::map<int, std::pair<unsigned, double>> tally;
+    for (auto &vote : votes_) {
+      tally[vote.first].first++;
+      tally[vote.first].second += vote.second;
+    }
+
+    for (auto &entry : tally) {
+      if (entry.first < 0 || entry.second.first < ratio_ * window_)
+        continue;
+
+      label_ = entry.first;
+      score_ = entry.second.second / entry.second.first;
+      locked_ = true;
+      return true;
+    }
+
+    return false;
+  }
+
+  void reset ()
+  {
+    votes_.clear ();
+    label_ = -1;
+    score_ = 0.0;
+    locked_ = false;
+  }
+
+  bool locked () const { return locked_; }
+  int label () const { return label_; }
+  double score () const { return score_; }
+
+private:
+  std::deque<std::pair<int, double>> votes_;
+  unsigned window_;
+  double ratio_;
+  int label_;
+  double score_;
+  bool locked_;
+};
+
+class InferGate
+{
+public:
+  InferGate () : skipped_ (0), score_ (0.0) {}
+
+  /* Whether the model runs on img.  'event' is the weighing event, or
+   * NULL when weighing is off. */
+  bool admit (const cv::Mat & img, unsigned interval, double threshold,
+      WeighingEvent * event)
+  {
+    bool locked = event && event->locked ();
+
+    if (interval <= 1 && !event)
+      return true;
+
+    score_ = scene_.score (img);
+    if (score_ > threshold) {
+      if (locked)
+        event->reset ();
+    } else if (locked || ++skipped_ < interval) {
+      return false;
+    }
+
+    scene_.update ();
+    skipped_ = 0;
+    return true;
+  }
+
+  /* Scene change score of the last admitted frame */
+  double score () const { return score_; }
+
+  void reset ()
+  {
+    scene_.reset ();
+    skipped_ = 0;
+    score_ = 0.0;
+  }
+
+private:
+  SceneChange scene_;
+  unsigned skipped_;            /* frames since the last inferred one */
+  double score_;
+};
+
+#endif /* __WEIGHING_HPP__ */